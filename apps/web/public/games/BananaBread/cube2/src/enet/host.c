@@ -102,6 +102,13 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     host -> compressor.decompress = NULL;
     host -> compressor.destroy = NULL;
 
+    host -> datagramBatchSize = 0;
+    host -> receivedDatagrams = NULL;
+    host -> receivedDatagramCount = 0;
+    host -> receivedDatagramIndex = 0;
+    host -> outgoingDatagrams = NULL;
+    host -> outgoingDatagramCount = 0;
+
     enet_list_clear (& host -> dispatchQueue);
 
     for (currentPeer = host -> peers;
@@ -146,6 +153,9 @@ enet_host_destroy (ENetHost * host)
     if (host -> compressor.context != NULL && host -> compressor.destroy)
       (* host -> compressor.destroy) (host -> compressor.context);
 
+    if (host -> receivedDatagrams != NULL)
+      enet_free (host -> receivedDatagrams);
+
     enet_free (host -> peers);
     enet_free (host);
 }
@@ -313,6 +323,65 @@ enet_host_bandwidth_limit (ENetHost * host, enet_uint32 incomingBandwidth, enet_
     host -> recalculateBandwidthLimits = 1;
 }
 
+/** Sets up batched datagram I/O on a host.
+    @param host host to adjust
+    @param batchSize maximum number of datagrams moved by one socket call, clamped to
+    ENET_HOST_DATAGRAM_BATCH_MAXIMUM; 0 or 1 restores one socket call per datagram
+    @retval 0 on success
+    @retval < 0 on failure, in which case the previous setting is kept
+    @remarks With batching, enet_host_service() reads up to batchSize datagrams per
+    receive call into a ring on the host and handles them one by one, and the datagrams
+    produced by one pass over the peers are sent together at the end of the pass. Where
+    the platform has recvmmsg/sendmmsg, each batch is a single system call; elsewhere the
+    batch is moved one datagram at a time. Datagrams received but not yet handled are
+    dropped when the batch size changes.
+*/
+int
+enet_host_batch_datagrams (ENetHost * host, size_t batchSize)
+{
+    ENetDatagram * datagrams = NULL;
+    size_t datagramIndex;
+
+    if (batchSize > ENET_HOST_DATAGRAM_BATCH_MAXIMUM)
+      batchSize = ENET_HOST_DATAGRAM_BATCH_MAXIMUM;
+    else
+    if (batchSize < 2)
+      batchSize = 0;
+
+    if (batchSize == host -> datagramBatchSize)
+      return 0;
+
+    if (batchSize > 0)
+    {
+       enet_uint8 * data;
+
+       datagrams = (ENetDatagram *) enet_malloc (2 * batchSize * (sizeof (ENetDatagram) + ENET_PROTOCOL_MAXIMUM_MTU));
+       if (datagrams == NULL)
+         return -1;
+
+       data = (enet_uint8 *) & datagrams [2 * batchSize];
+       for (datagramIndex = 0; datagramIndex < 2 * batchSize; ++ datagramIndex)
+       {
+          datagrams [datagramIndex].address.host = ENET_HOST_ANY;
+          datagrams [datagramIndex].address.port = 0;
+          datagrams [datagramIndex].buffer.data = & data [datagramIndex * ENET_PROTOCOL_MAXIMUM_MTU];
+          datagrams [datagramIndex].buffer.dataLength = ENET_PROTOCOL_MAXIMUM_MTU;
+       }
+    }
+
+    if (host -> receivedDatagrams != NULL)
+      enet_free (host -> receivedDatagrams);
+
+    host -> datagramBatchSize = batchSize;
+    host -> receivedDatagrams = datagrams;
+    host -> receivedDatagramCount = 0;
+    host -> receivedDatagramIndex = 0;
+    host -> outgoingDatagrams = datagrams != NULL ? & datagrams [batchSize] : NULL;
+    host -> outgoingDatagramCount = 0;
+
+    return 0;
+}
+
 void
 enet_host_bandwidth_throttle (ENetHost * host)
 {
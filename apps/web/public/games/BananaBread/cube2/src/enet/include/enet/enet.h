@@ -79,6 +79,22 @@ typedef struct _ENetAddress
    enet_uint16 port;
 } ENetAddress;
 
+/**
+ * A datagram handed to or returned from a batched socket call.
+ *
+ * When sending, address is the destination. When receiving, address is the
+ * source and buffer.dataLength holds the capacity of buffer.data on entry
+ * and the received length on return.
+
+   @sa enet_socket_send_datagrams()
+   @sa enet_socket_receive_datagrams()
+ */
+typedef struct _ENetDatagram
+{
+   ENetAddress address;
+   ENetBuffer  buffer;
+} ENetDatagram;
+
 /**
  * Packet flag bit constants.
  *
@@ -193,6 +209,7 @@ enum
    ENET_HOST_SEND_BUFFER_SIZE             = 256 * 1024,
    ENET_HOST_BANDWIDTH_THROTTLE_INTERVAL  = 1000,
    ENET_HOST_DEFAULT_MTU                  = 1400,
+   ENET_HOST_DATAGRAM_BATCH_MAXIMUM       = 64,
 
    ENET_PEER_DEFAULT_ROUND_TRIP_TIME      = 500,
    ENET_PEER_DEFAULT_PACKET_THROTTLE      = 32,
@@ -324,6 +341,7 @@ typedef enet_uint32 (ENET_CALLBACK * ENetChecksumCallback) (const ENetBuffer * b
     @sa enet_host_channel_limit()
     @sa enet_host_bandwidth_limit()
     @sa enet_host_bandwidth_throttle()
+    @sa enet_host_batch_datagrams()
   */
 typedef struct _ENetHost
 {
@@ -357,6 +375,12 @@ typedef struct _ENetHost
    enet_uint32          totalSentPackets;            /**< total UDP packets sent, user should reset to 0 as needed to prevent overflow */
    enet_uint32          totalReceivedData;           /**< total data received, user should reset to 0 as needed to prevent overflow */
    enet_uint32          totalReceivedPackets;        /**< total UDP packets received, user should reset to 0 as needed to prevent overflow */
+   size_t               datagramBatchSize;           /**< datagrams per batched socket call, 0 if batching is disabled */
+   ENetDatagram *       receivedDatagrams;           /**< ring of datagrams read by the last batched receive */
+   size_t               receivedDatagramCount;
+   size_t               receivedDatagramIndex;
+   ENetDatagram *       outgoingDatagrams;           /**< datagrams queued during one pass over the peers */
+   size_t               outgoingDatagramCount;
 } ENetHost;
 
 /**
@@ -454,6 +478,8 @@ ENET_API ENetSocket enet_socket_accept (ENetSocket, ENetAddress *);
 ENET_API int        enet_socket_connect (ENetSocket, const ENetAddress *);
 ENET_API int        enet_socket_send (ENetSocket, const ENetAddress *, const ENetBuffer *, size_t);
 ENET_API int        enet_socket_receive (ENetSocket, ENetAddress *, ENetBuffer *, size_t);
+ENET_API int        enet_socket_send_datagrams (ENetSocket, const ENetDatagram *, size_t);
+ENET_API int        enet_socket_receive_datagrams (ENetSocket, ENetDatagram *, size_t);
 ENET_API int        enet_socket_wait (ENetSocket, enet_uint32 *, enet_uint32);
 ENET_API int        enet_socket_set_option (ENetSocket, ENetSocketOption, int);
 ENET_API void       enet_socket_destroy (ENetSocket);
@@ -512,6 +538,7 @@ ENET_API void       enet_host_compress (ENetHost *, const ENetCompressor *);
 ENET_API int        enet_host_compress_with_range_coder (ENetHost * host);
 ENET_API void       enet_host_channel_limit (ENetHost *, size_t);
 ENET_API void       enet_host_bandwidth_limit (ENetHost *, enet_uint32, enet_uint32);
+ENET_API int        enet_host_batch_datagrams (ENetHost *, size_t);
 extern   void       enet_host_bandwidth_throttle (ENetHost *);
 
 ENET_API int                 enet_peer_send (ENetPeer *, enet_uint8, ENetPacket *);
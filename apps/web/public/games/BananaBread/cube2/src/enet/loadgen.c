@@ -0,0 +1,270 @@
+/**
+ @file  loadgen.c
+ @brief ENet server load generator
+*/
+/*
+   Measures how many datagrams per second a single ENet server host can move,
+   with and without batched socket I/O (enet_host_batch_datagrams).
+
+   One thread runs the server host, which echoes every packet it receives back
+   to the sender as an unreliable packet. Another thread runs the client hosts,
+   each sending unreliable packets at a fixed rate and flushing after every
+   packet so each one is its own datagram. The server's datagram counters and
+   the CPU time of the server thread are reported, so runs can be compared as
+   datagrams per CPU second as well as raw throughput.
+
+   usage: loadgen [-c clients] [-r packets/sec per client] [-s packet size]
+                  [-t seconds] [-b batch size] [-p port]
+
+   Compare e.g. "loadgen -c 64 -r 500 -b 0" against "loadgen -c 64 -r 500 -b 32".
+*/
+#ifndef WIN32
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "enet/enet.h"
+
+typedef struct _LoadOptions
+{
+   int clients;
+   int rate;
+   int size;
+   int seconds;
+   int batch;
+   int port;
+} LoadOptions;
+
+typedef struct _LoadServer
+{
+   ENetHost * host;
+   volatile int running;
+   enet_uint32 packetsReceived;
+   enet_uint32 datagramsReceived;
+   enet_uint32 datagramsSent;
+   double cpuSeconds;
+} LoadServer;
+
+static double
+thread_cpu_seconds (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_THREAD_CPUTIME_ID, & ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double
+wall_seconds (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, & ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *
+server_thread (void * data)
+{
+    LoadServer * server = (LoadServer *) data;
+    ENetEvent event;
+    double cpuStart = thread_cpu_seconds ();
+
+    server -> host -> totalReceivedPackets = 0;
+    server -> host -> totalSentPackets = 0;
+
+    while (server -> running)
+    {
+       int result = enet_host_service (server -> host, & event, 1);
+
+       for (; result > 0; result = enet_host_check_events (server -> host, & event))
+       {
+          if (event.type == ENET_EVENT_TYPE_RECEIVE)
+          {
+             ENetPacket * echo = enet_packet_create (event.packet -> data, event.packet -> dataLength, 0);
+
+             ++ server -> packetsReceived;
+             enet_peer_send (event.peer, 0, echo);
+             enet_packet_destroy (event.packet);
+          }
+       }
+
+       if (result < 0)
+         break;
+
+       enet_host_flush (server -> host);
+    }
+
+    server -> cpuSeconds = thread_cpu_seconds () - cpuStart;
+    server -> datagramsReceived = server -> host -> totalReceivedPackets;
+    server -> datagramsSent = server -> host -> totalSentPackets;
+
+    return NULL;
+}
+
+static int
+connect_clients (const LoadOptions * options, ENetHost ** clients)
+{
+    ENetAddress address;
+    ENetEvent event;
+    int clientIndex, connected = 0;
+    double deadline = wall_seconds () + 5;
+
+    enet_address_set_host (& address, "127.0.0.1");
+    address.port = options -> port;
+
+    for (clientIndex = 0; clientIndex < options -> clients; ++ clientIndex)
+    {
+       clients [clientIndex] = enet_host_create (NULL, 1, 1, 0, 0);
+       if (clients [clientIndex] == NULL ||
+           enet_host_connect (clients [clientIndex], & address, 1, 0) == NULL)
+         return -1;
+    }
+
+    while (connected < options -> clients && wall_seconds () < deadline)
+    {
+       for (clientIndex = 0; clientIndex < options -> clients; ++ clientIndex)
+         while (enet_host_service (clients [clientIndex], & event, 0) > 0)
+           if (event.type == ENET_EVENT_TYPE_CONNECT)
+             ++ connected;
+
+       usleep (1000);
+    }
+
+    return connected == options -> clients ? 0 : -1;
+}
+
+static enet_uint32
+drive_clients (const LoadOptions * options, ENetHost ** clients)
+{
+    ENetEvent event;
+    enet_uint8 * payload = (enet_uint8 *) calloc (1, options -> size);
+    double start = wall_seconds (), now;
+    enet_uint32 sent = 0, echoed = 0;
+
+    while ((now = wall_seconds ()) < start + options -> seconds)
+    {
+       enet_uint32 due = (enet_uint32) ((now - start) * options -> rate);
+       int clientIndex;
+
+       for (clientIndex = 0; clientIndex < options -> clients; ++ clientIndex)
+       {
+          ENetHost * client = clients [clientIndex];
+
+          while (enet_host_service (client, & event, 0) > 0)
+            if (event.type == ENET_EVENT_TYPE_RECEIVE)
+            {
+               ++ echoed;
+               enet_packet_destroy (event.packet);
+            }
+       }
+
+       for (; sent < due; ++ sent)
+       {
+          for (clientIndex = 0; clientIndex < options -> clients; ++ clientIndex)
+          {
+             enet_peer_send (clients [clientIndex] -> peers, 0, enet_packet_create (payload, options -> size, 0));
+             enet_host_flush (clients [clientIndex]);
+          }
+       }
+
+       usleep (500);
+    }
+
+    free (payload);
+
+    return echoed;
+}
+
+int
+main (int argc, char ** argv)
+{
+    LoadOptions options = { 32, 250, 64, 10, 0, 29999 };
+    LoadServer server;
+    ENetAddress address;
+    ENetHost ** clients;
+    pthread_t thread;
+    enet_uint32 echoed;
+    int opt, clientIndex;
+
+    while ((opt = getopt (argc, argv, "c:r:s:t:b:p:")) != -1)
+    {
+       switch (opt)
+       {
+       case 'c': options.clients = atoi (optarg); break;
+       case 'r': options.rate = atoi (optarg); break;
+       case 's': options.size = atoi (optarg); break;
+       case 't': options.seconds = atoi (optarg); break;
+       case 'b': options.batch = atoi (optarg); break;
+       case 'p': options.port = atoi (optarg); break;
+       default:
+          fprintf (stderr, "usage: %s [-c clients] [-r packets/sec per client] [-s packet size] [-t seconds] [-b batch size] [-p port]\n", argv [0]);
+          return 2;
+       }
+    }
+
+    if (options.clients <= 0 || options.rate <= 0 || options.size <= 0 || options.seconds <= 0)
+    {
+       fprintf (stderr, "clients, rate, size and seconds must be positive\n");
+       return 2;
+    }
+
+    if (enet_initialize () != 0)
+    {
+       fprintf (stderr, "enet_initialize failed\n");
+       return 1;
+    }
+
+    memset (& server, 0, sizeof (LoadServer));
+
+    address.host = ENET_HOST_ANY;
+    address.port = options.port;
+    server.host = enet_host_create (& address, options.clients, 1, 0, 0);
+    if (server.host == NULL || enet_host_batch_datagrams (server.host, options.batch) < 0)
+    {
+       fprintf (stderr, "could not create server host on port %d\n", options.port);
+       return 1;
+    }
+
+    server.running = 1;
+    pthread_create (& thread, NULL, server_thread, & server);
+
+    clients = (ENetHost **) calloc (options.clients, sizeof (ENetHost *));
+    if (connect_clients (& options, clients) < 0)
+    {
+       fprintf (stderr, "clients failed to connect\n");
+       return 1;
+    }
+
+    echoed = drive_clients (& options, clients);
+
+    server.running = 0;
+    pthread_join (thread, NULL);
+
+    printf ("clients %d, %d packets/sec each, %d bytes, batch %d, %d seconds\n",
+            options.clients, options.rate, options.size, (int) server.host -> datagramBatchSize, options.seconds);
+    printf ("server: %u packets, %.0f datagrams/sec in, %.0f datagrams/sec out, %.2f cpu seconds, %.0f datagrams per cpu second\n",
+            server.packetsReceived,
+            server.datagramsReceived / (double) options.seconds,
+            server.datagramsSent / (double) options.seconds,
+            server.cpuSeconds,
+            server.cpuSeconds > 0 ? (server.datagramsReceived + server.datagramsSent) / server.cpuSeconds : 0.0);
+    printf ("clients: %u echoes received\n", echoed);
+
+    for (clientIndex = 0; clientIndex < options.clients; ++ clientIndex)
+      enet_host_destroy (clients [clientIndex]);
+    free (clients);
+
+    enet_host_destroy (server.host);
+    enet_deinitialize ();
+
+    return 0;
+}
+
+#endif
@@ -1158,6 +1158,40 @@ commandError:
     return 0;
 }
  
+static int
+enet_protocol_receive_batched_datagram (ENetHost * host)
+{
+    ENetDatagram * datagram;
+
+    if (host -> receivedDatagramIndex >= host -> receivedDatagramCount)
+    {
+       size_t datagramIndex;
+       int receivedCount;
+
+       for (datagramIndex = 0; datagramIndex < host -> receivedDatagramCount; ++ datagramIndex)
+         host -> receivedDatagrams [datagramIndex].buffer.dataLength = ENET_PROTOCOL_MAXIMUM_MTU;
+
+       host -> receivedDatagramCount = 0;
+       host -> receivedDatagramIndex = 0;
+
+       receivedCount = enet_socket_receive_datagrams (host -> socket,
+                                                      host -> receivedDatagrams,
+                                                      host -> datagramBatchSize);
+
+       if (receivedCount <= 0)
+         return receivedCount;
+
+       host -> receivedDatagramCount = receivedCount;
+    }
+
+    datagram = & host -> receivedDatagrams [host -> receivedDatagramIndex ++];
+
+    host -> receivedAddress = datagram -> address;
+    host -> receivedData = (enet_uint8 *) datagram -> buffer.data;
+
+    return (int) datagram -> buffer.dataLength;
+}
+
 static int
 enet_protocol_receive_incoming_commands (ENetHost * host, ENetEvent * event)
 {
@@ -1166,13 +1200,20 @@ enet_protocol_receive_incoming_commands (ENetHost * host, ENetEvent * event)
        int receivedLength;
        ENetBuffer buffer;
 
-       buffer.data = host -> packetData [0];
-       buffer.dataLength = sizeof (host -> packetData [0]);
+       if (host -> receivedDatagrams != NULL)
+         receivedLength = enet_protocol_receive_batched_datagram (host);
+       else
+       {
+          buffer.data = host -> packetData [0];
+          buffer.dataLength = sizeof (host -> packetData [0]);
+
+          receivedLength = enet_socket_receive (host -> socket,
+                                                & host -> receivedAddress,
+                                                & buffer,
+                                                1);
 
-       receivedLength = enet_socket_receive (host -> socket,
-                                             & host -> receivedAddress,
-                                             & buffer,
-                                             1);
+          host -> receivedData = host -> packetData [0];
+       }
 
        if (receivedLength < 0)
          return -1;
@@ -1180,7 +1221,6 @@ enet_protocol_receive_incoming_commands (ENetHost * host, ENetEvent * event)
        if (receivedLength == 0)
          return 0;
 
-       host -> receivedData = host -> packetData [0];
        host -> receivedDataLength = receivedLength;
       
        host -> totalReceivedData += receivedLength;
@@ -1529,6 +1569,51 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
     return canPing;
 }
 
+static int
+enet_protocol_flush_datagrams (ENetHost * host)
+{
+    int sentCount;
+
+    if (host -> outgoingDatagramCount == 0)
+      return 0;
+
+    sentCount = enet_socket_send_datagrams (host -> socket,
+                                            host -> outgoingDatagrams,
+                                            host -> outgoingDatagramCount);
+
+    host -> outgoingDatagramCount = 0;
+
+    return sentCount < 0 ? -1 : 0;
+}
+
+/* The buffers reference command and packet memory that is reused or freed as soon as
+   the next peer is serviced, so the datagram is copied into the outgoing ring. */
+static int
+enet_protocol_queue_datagram (ENetHost * host, const ENetAddress * address)
+{
+    ENetDatagram * datagram;
+    enet_uint8 * data;
+    size_t bufferIndex;
+
+    if (host -> outgoingDatagramCount >= host -> datagramBatchSize &&
+        enet_protocol_flush_datagrams (host) < 0)
+      return -1;
+
+    datagram = & host -> outgoingDatagrams [host -> outgoingDatagramCount ++];
+    datagram -> address = * address;
+
+    data = (enet_uint8 *) datagram -> buffer.data;
+    for (bufferIndex = 0; bufferIndex < host -> bufferCount; ++ bufferIndex)
+    {
+       memcpy (data, host -> buffers [bufferIndex].data, host -> buffers [bufferIndex].dataLength);
+       data += host -> buffers [bufferIndex].dataLength;
+    }
+
+    datagram -> buffer.dataLength = data - (enet_uint8 *) datagram -> buffer.data;
+
+    return (int) datagram -> buffer.dataLength;
+}
+
 static int
 enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int checkForTimeouts)
 {
@@ -1564,7 +1649,7 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
             enet_protocol_check_timeouts (host, currentPeer, event) == 1)
         {
             if (event != NULL && event -> type != ENET_EVENT_TYPE_NONE)
-              return 1;
+              return enet_protocol_flush_datagrams (host) < 0 ? -1 : 1;
             else
               continue;
         }
@@ -1674,7 +1759,10 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
 
         currentPeer -> lastSendTime = host -> serviceTime;
 
-        sentLength = enet_socket_send (host -> socket, & currentPeer -> address, host -> buffers, host -> bufferCount);
+        if (host -> outgoingDatagrams != NULL)
+          sentLength = enet_protocol_queue_datagram (host, & currentPeer -> address);
+        else
+          sentLength = enet_socket_send (host -> socket, & currentPeer -> address, host -> buffers, host -> bufferCount);
 
         enet_protocol_remove_sent_unreliable_commands (currentPeer);
 
@@ -1685,7 +1773,7 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
         host -> totalSentPackets ++;
     }
    
-    return 0;
+    return enet_protocol_flush_datagrams (host);
 }
 
 /** Sends any queued packets on the host specified to its designated peers.
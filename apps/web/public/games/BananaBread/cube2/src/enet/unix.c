@@ -4,6 +4,10 @@
 */
 #ifndef WIN32
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
@@ -38,6 +42,10 @@ typedef int socklen_t;
 #define MSG_NOSIGNAL 0
 #endif
 
+#if (defined(linux) || defined(__linux) || defined(__linux__)) && defined(MSG_WAITFORONE) && ! defined(__EMSCRIPTEN__)
+#define HAS_MMSG 1
+#endif
+
 static enet_uint32 timeBase = 0;
 
 int
@@ -361,6 +369,147 @@ enet_socket_receive (ENetSocket socket,
     return recvLength;
 }
 
+int
+enet_socket_send_datagrams (ENetSocket socket,
+                            const ENetDatagram * datagrams,
+                            size_t datagramCount)
+{
+#ifdef HAS_MMSG
+    struct mmsghdr msgHdrs [ENET_HOST_DATAGRAM_BATCH_MAXIMUM];
+    struct sockaddr_in sins [ENET_HOST_DATAGRAM_BATCH_MAXIMUM];
+    size_t sentCount = 0;
+
+    while (sentCount < datagramCount)
+    {
+       size_t batchCount = datagramCount - sentCount,
+              datagramIndex;
+       int result;
+
+       if (batchCount > ENET_HOST_DATAGRAM_BATCH_MAXIMUM)
+         batchCount = ENET_HOST_DATAGRAM_BATCH_MAXIMUM;
+
+       memset (msgHdrs, 0, batchCount * sizeof (struct mmsghdr));
+
+       for (datagramIndex = 0; datagramIndex < batchCount; ++ datagramIndex)
+       {
+          const ENetDatagram * datagram = & datagrams [sentCount + datagramIndex];
+          struct sockaddr_in * sin = & sins [datagramIndex];
+          struct msghdr * msgHdr = & msgHdrs [datagramIndex].msg_hdr;
+
+          memset (sin, 0, sizeof (struct sockaddr_in));
+
+          sin -> sin_family = AF_INET;
+          sin -> sin_port = ENET_HOST_TO_NET_16 (datagram -> address.port);
+          sin -> sin_addr.s_addr = datagram -> address.host;
+
+          msgHdr -> msg_name = sin;
+          msgHdr -> msg_namelen = sizeof (struct sockaddr_in);
+          msgHdr -> msg_iov = (struct iovec *) & datagram -> buffer;
+          msgHdr -> msg_iovlen = 1;
+       }
+
+       result = sendmmsg (socket, msgHdrs, batchCount, MSG_NOSIGNAL);
+
+       if (result == -1)
+       {
+          /* like enet_socket_send, a full send buffer drops what is left */
+          if (errno == EWOULDBLOCK)
+            break;
+
+          return -1;
+       }
+
+       sentCount += result;
+    }
+
+    return (int) sentCount;
+#else
+    size_t sentCount;
+
+    for (sentCount = 0; sentCount < datagramCount; ++ sentCount)
+    {
+       int sentLength = enet_socket_send (socket, & datagrams [sentCount].address, & datagrams [sentCount].buffer, 1);
+
+       if (sentLength < 0)
+         return -1;
+
+       if (sentLength == 0)
+         break;
+    }
+
+    return (int) sentCount;
+#endif
+}
+
+int
+enet_socket_receive_datagrams (ENetSocket socket,
+                               ENetDatagram * datagrams,
+                               size_t datagramCount)
+{
+#ifdef HAS_MMSG
+    struct mmsghdr msgHdrs [ENET_HOST_DATAGRAM_BATCH_MAXIMUM];
+    struct sockaddr_in sins [ENET_HOST_DATAGRAM_BATCH_MAXIMUM];
+    int recvCount, datagramIndex;
+
+    if (datagramCount > ENET_HOST_DATAGRAM_BATCH_MAXIMUM)
+      datagramCount = ENET_HOST_DATAGRAM_BATCH_MAXIMUM;
+
+    memset (msgHdrs, 0, datagramCount * sizeof (struct mmsghdr));
+
+    for (datagramIndex = 0; datagramIndex < (int) datagramCount; ++ datagramIndex)
+    {
+       struct msghdr * msgHdr = & msgHdrs [datagramIndex].msg_hdr;
+
+       msgHdr -> msg_name = & sins [datagramIndex];
+       msgHdr -> msg_namelen = sizeof (struct sockaddr_in);
+       msgHdr -> msg_iov = (struct iovec *) & datagrams [datagramIndex].buffer;
+       msgHdr -> msg_iovlen = 1;
+    }
+
+    /* the socket is non-blocking, so this returns once the queue is empty */
+    recvCount = recvmmsg (socket, msgHdrs, datagramCount, MSG_NOSIGNAL, NULL);
+
+    if (recvCount == -1)
+    {
+       if (errno == EWOULDBLOCK)
+         return 0;
+
+       return -1;
+    }
+
+    for (datagramIndex = 0; datagramIndex < recvCount; ++ datagramIndex)
+    {
+       ENetDatagram * datagram = & datagrams [datagramIndex];
+
+       if (msgHdrs [datagramIndex].msg_hdr.msg_flags & MSG_TRUNC)
+         return -1;
+
+       datagram -> address.host = (enet_uint32) sins [datagramIndex].sin_addr.s_addr;
+       datagram -> address.port = ENET_NET_TO_HOST_16 (sins [datagramIndex].sin_port);
+       datagram -> buffer.dataLength = msgHdrs [datagramIndex].msg_len;
+    }
+
+    return recvCount;
+#else
+    size_t recvCount;
+
+    for (recvCount = 0; recvCount < datagramCount; ++ recvCount)
+    {
+       int recvLength = enet_socket_receive (socket, & datagrams [recvCount].address, & datagrams [recvCount].buffer, 1);
+
+       if (recvLength < 0)
+         return -1;
+
+       if (recvLength == 0)
+         break;
+
+       datagrams [recvCount].buffer.dataLength = recvLength;
+    }
+
+    return (int) recvCount;
+#endif
+}
+
 int
 enet_socketset_select (ENetSocket maxSocket, ENetSocketSet * readSet, ENetSocketSet * writeSet, enet_uint32 timeout)
 {
@@ -303,6 +303,52 @@ enet_socket_receive (ENetSocket socket,
     return (int) recvLength;
 }
 
+/* Winsock has no batched datagram calls, so batches are moved one datagram at a time */
+
+int
+enet_socket_send_datagrams (ENetSocket socket,
+                            const ENetDatagram * datagrams,
+                            size_t datagramCount)
+{
+    size_t sentCount;
+
+    for (sentCount = 0; sentCount < datagramCount; ++ sentCount)
+    {
+       int sentLength = enet_socket_send (socket, & datagrams [sentCount].address, & datagrams [sentCount].buffer, 1);
+
+       if (sentLength < 0)
+         return -1;
+
+       if (sentLength == 0)
+         break;
+    }
+
+    return (int) sentCount;
+}
+
+int
+enet_socket_receive_datagrams (ENetSocket socket,
+                               ENetDatagram * datagrams,
+                               size_t datagramCount)
+{
+    size_t recvCount;
+
+    for (recvCount = 0; recvCount < datagramCount; ++ recvCount)
+    {
+       int recvLength = enet_socket_receive (socket, & datagrams [recvCount].address, & datagrams [recvCount].buffer, 1);
+
+       if (recvLength < 0)
+         return -1;
+
+       if (recvLength == 0)
+         break;
+
+       datagrams [recvCount].buffer.dataLength = recvLength;
+    }
+
+    return (int) recvCount;
+}
+
 int
 enet_socketset_select (ENetSocket maxSocket, ENetSocketSet * readSet, ENetSocketSet * writeSet, enet_uint32 timeout)
 {
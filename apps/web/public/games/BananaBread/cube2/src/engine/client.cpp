@@ -5,6 +5,7 @@
 ENetHost *clienthost = NULL;
 ENetPeer *curpeer = NULL, *connpeer = NULL;
 int connmillis = 0, connattempts = 0, discmillis = 0;
+bool servernetmodel = false; // the server accepted our payload model, so we may compress what we send
 
 bool multiplayer(bool msg)
 {
@@ -117,7 +118,8 @@ void connectserv(const char *servername, int serverport, const char *serverpassw
 
     if(clienthost)
     {
-        connpeer = enet_host_connect(clienthost, &address, server::numchannels(), 0); 
+        servernetmodel = false;
+        connpeer = enet_host_connect(clienthost, &address, server::numchannels(), netmodelcrc); 
         enet_host_flush(clienthost);
         connmillis = totalmillis;
         connattempts = 0;
@@ -190,7 +192,12 @@ ICOMMAND(localdisconnect, "", (), { if(haslocalclients()) localdisconnect(); });
 
 void sendclientpacket(ENetPacket *packet, int chan)
 {
-    if(curpeer) enet_peer_send(curpeer, chan, packet);
+    if(curpeer)
+    {
+        ENetPacket *compressed = servernetmodel && netcompress&(1<<chan) ? compresspacket(packet, chan) : packet;
+        enet_peer_send(curpeer, chan, compressed);
+        sentcompressed(compressed, packet);
+    }
     else localclienttoserver(chan, packet);
 }
 
@@ -244,10 +251,20 @@ void gets2c()           // get updates from the server
             break;
          
         case ENET_EVENT_TYPE_RECEIVE:
+        {
+            ENetPacket *raw = discmillis ? event.packet : decompresspacket(event.packet, event.channelID);
             if(discmillis) conoutf("attempting to disconnect...");
+            else if(!raw) neterr("compressed packet");
+            else if(raw != event.packet)
+            {
+                servernetmodel = true;
+                if(raw->dataLength) localservertoclient(event.channelID, raw);
+                enet_packet_destroy(raw);
+            }
             else localservertoclient(event.channelID, event.packet);
             enet_packet_destroy(event.packet);
             break;
+        }
 
         case ENET_EVENT_TYPE_DISCONNECT:
             extern const char *disc_reasons[];
@@ -1106,7 +1106,7 @@ int main(int argc, char **argv)
     }
 
     logoutf("init: net");
-    if(enet_initialize()<0) fatal("Unable to initialise network module");
+    if(initpacketpools()<0) fatal("Unable to initialise network module");
     atexit(enet_deinitialize);
     enet_time_set(0);
 
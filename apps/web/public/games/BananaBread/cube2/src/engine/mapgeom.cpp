@@ -0,0 +1,476 @@
+// mapgeom.cpp: headless collision geometry of a map for server side physics queries
+
+// The dedicated server never builds the octree the client renders from, so this reads only the
+// shape of every cube out of the map file and keeps it as a flat array of nodes: a node is empty,
+// solid, a group of 8 children or a reference to a leaf holding the bounding box and clip planes
+// of a partial cube, as genclipplanes() makes them. Render data is skipped while reading.
+// Geometry is read only once per map and shared by every server instance playing it.
+
+#include "engine.h"
+
+#ifdef INSTANCETHREADS
+#include <pthread.h>
+#endif
+
+enum
+{
+    GEOM_EMPTY = 0,
+    GEOM_SOLID,
+    GEOM_CHILDREN,
+    GEOM_LEAF
+};
+
+// low 2 bits are the kind, the rest is the index of the children or leaf, or for empty and solid nodes the material
+#define GEOMNODE(kind, val) (((val)<<2)|(kind))
+#define geomkind(n) ((n)&3)
+#define geomval(n) ((n)>>2)
+
+#define GEOM_FACEEMPTY 0
+#define GEOM_FACESOLID 0x80808080U
+
+struct geomleaf
+{
+    vec o, r;       // bounding box of the cube's corners
+    int planes;     // first of the cube's planes in mapgeom::planes
+    uchar numplanes, material;
+};
+
+struct mapgeom
+{
+    string name;
+    uint crc;
+    int refs;
+    int worldsize, worldscale;
+    vector<uint> nodes;         // groups of 8 octants, the first group is the world root
+    vector<geomleaf> leaves;
+    vector<plane> planes;
+
+    mapgeom() : crc(0), refs(0), worldsize(0), worldscale(0) { name[0] = '\0'; }
+
+    int memory() const { return nodes.length()*sizeof(uint) + leaves.length()*sizeof(geomleaf) + planes.length()*sizeof(plane); }
+};
+
+static inline int geomstep(int x, int y, int z, int scale)
+{
+    return (((z>>scale)&1)<<2) | (((y>>scale)&1)<<1) | ((x>>scale)&1);
+}
+
+// corners in the order of cubecoords, and the corners of each face orientation as in fv
+static const uchar geomcorners[8][3] = { { 1, 1, 0 }, { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 0, 1 }, { 0, 0, 1 }, { 0, 0, 0 }, { 1, 0, 0 } };
+static const uchar geomfaceverts[6][4] = { { 2, 1, 6, 5 }, { 3, 4, 7, 0 }, { 4, 5, 6, 7 }, { 1, 2, 3, 0 }, { 6, 1, 0, 7 }, { 5, 4, 3, 2 } };
+
+#define geomedge(edges, d, x, y) ((edges)[((d)<<2)+((y)<<1)+(x)])
+#define geomedgeget(edge, coord) ((coord) ? (edge)>>4 : (edge)&0xF)
+
+static uint addgeomleaf(mapgeom &g, const uchar *edges, const uint *faces, const ivec &co, int size, int material)
+{
+    ivec iv[8];
+    vec v[8];
+    loopi(8)
+    {
+        int x = geomcorners[i][0], y = geomcorners[i][1], z = geomcorners[i][2];
+        iv[i] = ivec(geomedgeget(geomedge(edges, 0, y, z), x), geomedgeget(geomedge(edges, 1, z, x), y), geomedgeget(geomedge(edges, 2, x, y), z));
+        v[i] = iv[i].tovec().mul(size/8.0f).add(co.tovec());
+    }
+    geomleaf &l = g.leaves.add();
+    vec mx = v[0], mn = v[0];
+    for(int i = 1; i < 8; i++) { mx.max(v[i]); mn.min(v[i]); }
+    l.r = mx.sub(mn).mul(0.5f);
+    l.o = mn.add(l.r);
+    l.planes = g.planes.length();
+    l.numplanes = 0;
+    l.material = material;
+    // faces flat against an axis are covered by the bounding box, the others get a plane per triangle;
+    // all faces are kept since the server has no neighbours to cull them against
+    loopi(6)
+    {
+        uint face = faces[i>>1];
+        if(i&1) face >>= 4;
+        if((face&0x0F0F0F0F) == 0x01010101*(face&0x0F)) continue;
+        ivec fv[4], e1, e2, e3, n;
+        loopk(4) fv[k] = iv[geomfaceverts[i][k]];
+        n.cross((e1 = fv[1]).sub(fv[0]), (e2 = fv[2]).sub(fv[0]));
+        int convex = (e3 = fv[0]).sub(fv[3]).dot(n), vis = 3;
+        if(!convex)
+        {
+            if(ivec().cross(e3, e2).iszero()) { if(!n.iszero()) vis = 1; }
+            else if(n.iszero()) vis = 2;
+        }
+        int order = convex < 0 ? 1 : 0;
+        const vec &v0 = v[geomfaceverts[i][order]], &v1 = v[geomfaceverts[i][order+1]], &v2 = v[geomfaceverts[i][order+2]], &v3 = v[geomfaceverts[i][(order+3)&3]];
+        plane p;
+        if(vis&1 && p.toplane(v0, v1, v2)) { g.planes.add(p); l.numplanes++; }
+        if(vis&2 && (!(vis&1) || convex) && p.toplane(v0, v2, v3)) { g.planes.add(p); l.numplanes++; }
+    }
+    return GEOMNODE(GEOM_LEAF, g.leaves.length()-1);
+}
+
+static uint loadgeomchildren(stream *f, mapgeom &g, const ivec &co, int size, bool &failed);
+
+// reads a cube as loadc() does, keeping only its shape and material
+static uint loadgeomc(stream *f, mapgeom &g, const ivec &co, int size, bool &failed)
+{
+    bool haschildren = false;
+    uchar edges[12];
+    int octsav = f->getchar();
+    switch(octsav&0x7)
+    {
+        case 0: return loadgeomchildren(f, g, co, size>>1, failed); // OCTSAV_CHILDREN
+        case 1: memset(edges, 0, sizeof(edges)); break; // OCTSAV_EMPTY
+        case 2: memset(edges, 0x80, sizeof(edges)); break; // OCTSAV_SOLID
+        case 3: f->read(edges, 12); break; // OCTSAV_NORMAL
+        case 4: haschildren = true; break; // OCTSAV_LODCUBE
+        default: failed = true; return GEOMNODE(GEOM_EMPTY, 0);
+    }
+    f->seek(6*sizeof(ushort), SEEK_CUR);
+    int material = octsav&0x40 ? f->getchar() : MAT_AIR;
+    if(octsav&0x80) f->getchar();
+    if(octsav&0x20)
+    {
+        int surfmask = f->getchar();
+        f->getchar();
+        loopi(6) if(surfmask&(1<<i))
+        {
+            uchar surf[4]; // lmid[2], verts, numverts of surfaceinfo
+            f->read(surf, sizeof(surf));
+            int vertmask = surf[2], layerverts = surf[3]&15, dup = surf[3]&0x80, skip = 0;
+            if(!layerverts) continue;
+            bool hasxyz = (vertmask&0x04)!=0, hasuv = (vertmask&0x40)!=0, hasnorm = (vertmask&0x80)!=0;
+            if(layerverts == 4)
+            {
+                if(hasxyz && vertmask&0x01) { skip += 4; hasxyz = false; }
+                if(hasuv && vertmask&0x02) { skip += dup ? 8 : 4; hasuv = false; }
+            }
+            if(hasnorm && vertmask&0x08) { skip++; hasnorm = false; }
+            skip += layerverts*((hasxyz ? 2 : 0) + (hasuv ? 2 : 0) + (hasnorm ? 1 : 0));
+            if(dup && hasuv) skip += layerverts*2;
+            f->seek(skip*sizeof(ushort), SEEK_CUR);
+        }
+    }
+    if(haschildren) return loadgeomchildren(f, g, co, size>>1, failed);
+
+    uint faces[3];
+    memcpy(faces, edges, sizeof(faces));
+    bool empty = faces[0]==GEOM_FACEEMPTY;
+    // drop cubes validatec() would, the client does the same after loading
+    if(!empty) loopi(3)
+    {
+        uint e0 = faces[i]&0x0F0F0F0FU, e1 = (faces[i]>>4)&0x0F0F0F0FU;
+        if(e0 == e1 || ((e1+0x07070707U)|(e1-e0))&0xF0F0F0F0U) { empty = true; break; }
+    }
+    if(empty) return GEOMNODE(GEOM_EMPTY, material);
+    if(faces[0]==GEOM_FACESOLID && faces[1]==GEOM_FACESOLID && faces[2]==GEOM_FACESOLID) return GEOMNODE(GEOM_SOLID, material);
+    return addgeomleaf(g, edges, faces, co, size, material);
+}
+
+static uint loadgeomchildren(stream *f, mapgeom &g, const ivec &co, int size, bool &failed)
+{
+    int first = g.nodes.length();
+    g.nodes.reserve(8);
+    loopi(8) g.nodes.add(GEOMNODE(GEOM_EMPTY, 0));
+    loopi(8)
+    {
+        uint n = loadgeomc(f, g, ivec(i, co.x, co.y, co.z, size), size, failed);
+        g.nodes[first+i] = n;
+        if(failed) break;
+    }
+    uint n = g.nodes[first];
+    // as validatec() does, children too small to hold anything make a solid cube
+    if(!size) n = GEOMNODE(GEOM_SOLID, MAT_AIR);
+    else
+    {
+        // 8 empty or solid octants of the same material merge into one node
+        if(geomkind(n) >= GEOM_CHILDREN) return GEOMNODE(GEOM_CHILDREN, first);
+        for(int i = 1; i < 8; i++) if(g.nodes[first+i] != n) return GEOMNODE(GEOM_CHILDREN, first);
+    }
+    g.nodes.setsize(first);
+    return n;
+}
+
+static void skipgeomvslots(stream *f, int numvslots)
+{
+    // sizes of the values of VSLOT_SCALE to VSLOT_COLOR
+    static const int vslotsizes[8] = { 0, 4, 4, 8, 8, 4, 8, 12 };
+    while(numvslots > 0)
+    {
+        int changed = f->getlil<int>();
+        if(changed < 0) { numvslots += changed; continue; }
+        f->getlil<int>();
+        if(changed&1)
+        {
+            int numparams = f->getlil<ushort>();
+            loopi(numparams)
+            {
+                int nlen = f->getlil<ushort>();
+                f->seek(nlen + 4*sizeof(float), SEEK_CUR);
+            }
+        }
+        for(int i = 1; i < 8; i++) if(changed&(1<<i)) f->seek(vslotsizes[i], SEEK_CUR);
+        numvslots--;
+    }
+}
+
+extern stream *openmapfile(const char *fname, octaheader &hdr, char *gametype, int &eif);
+
+static mapgeom *readmapgeom(const char *mname)
+{
+    octaheader hdr;
+    string gametype;
+    int eif = 0;
+    stream *f = openmapfile(mname, hdr, gametype, eif);
+    if(!f) return NULL;
+    // older maps store cubes in the compatibility format that only the client converts
+    if(hdr.version <= 31) { conoutf(CON_ERROR, "map %s is too old to load its geometry (version %d)", mname, hdr.version); delete f; return NULL; }
+    int worldscale = 0;
+    while(1<<worldscale < hdr.worldsize) worldscale++;
+    if(1<<worldscale != hdr.worldsize || worldscale >= 20) { conoutf(CON_ERROR, "map %s has an invalid world size", mname); delete f; return NULL; }
+    f->seek(hdr.numents*(sizeof(entity) + eif), SEEK_CUR);
+    skipgeomvslots(f, hdr.numvslots);
+
+    // parse into a local and only allocate the geometry once the octree read cleanly
+    mapgeom parsed;
+    bool failed = false;
+    uint root = loadgeomchildren(f, parsed, ivec(0, 0, 0), hdr.worldsize>>1, failed);
+    if(failed) { conoutf(CON_ERROR, "garbage in map %s", mname); delete f; return NULL; }
+    // keep the root a group of 8 even if the whole world merged into one node
+    if(geomkind(root) != GEOM_CHILDREN) loopi(8) parsed.nodes.add(root);
+    f->seek(0, SEEK_END);
+    mapgeom *g = new mapgeom;
+    copystring(g->name, mname);
+    g->crc = f->getcrc();
+    g->worldsize = hdr.worldsize;
+    g->worldscale = worldscale;
+    g->nodes.move(parsed.nodes);
+    g->leaves.move(parsed.leaves);
+    g->planes.move(parsed.planes);
+    delete f;
+    return g;
+}
+
+static vector<mapgeom *> mapgeoms;
+#ifdef INSTANCETHREADS
+static pthread_mutex_t mapgeomlock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCKMAPGEOMS pthread_mutex_lock(&mapgeomlock)
+#define UNLOCKMAPGEOMS pthread_mutex_unlock(&mapgeomlock)
+#else
+#define LOCKMAPGEOMS
+#define UNLOCKMAPGEOMS
+#endif
+
+// returns the geometry of a map, reading it only if no instance holds it yet; a nonzero crc
+// that differs from the held geometry's means the map file changed and is read again
+mapgeom *loadmapgeom(const char *mname, uint crc, bool *cached)
+{
+    LOCKMAPGEOMS;
+    mapgeom *g = NULL;
+    loopv(mapgeoms) if(!strcmp(mapgeoms[i]->name, mname) && (!crc || mapgeoms[i]->crc == crc)) { g = mapgeoms[i]; break; }
+    if(cached) *cached = g != NULL;
+    if(!g)
+    {
+        g = readmapgeom(mname);
+        if(g) mapgeoms.add(g);
+    }
+    if(g) g->refs++;
+    UNLOCKMAPGEOMS;
+    return g;
+}
+
+void freemapgeom(mapgeom *g)
+{
+    if(!g) return;
+    LOCKMAPGEOMS;
+    if(--g->refs <= 0)
+    {
+        mapgeoms.removeobj(g);
+        delete g;
+    }
+    UNLOCKMAPGEOMS;
+}
+
+int mapgeomsize(const mapgeom *g) { return g->worldsize; }
+
+void mapgeomstats(const mapgeom *g, int &nodes, int &leaves, int &planes, int &memory)
+{
+    nodes = g->nodes.length();
+    leaves = g->leaves.length();
+    planes = g->planes.length();
+    memory = g->memory();
+}
+
+// a ray walk over the node array with the steps of raycube()
+float geomraycast(const mapgeom *g, const vec &o, const vec &ray, float radius, int mode)
+{
+    if(ray.iszero()) return 0;
+
+    const int worldsize = g->worldsize;
+    float dist = 0;
+    vec v(o), invray(ray.x ? 1/ray.x : 1e16f, ray.y ? 1/ray.y : 1e16f, ray.z ? 1/ray.z : 1e16f);
+    int levels[20];
+    levels[g->worldscale] = 0;
+    int lshift = g->worldscale;
+    ivec lsizemask(invray.x>0 ? 1 : 0, invray.y>0 ? 1 : 0, invray.z>0 ? 1 : 0);
+
+    if(v.x<0 || v.y<0 || v.z<0 || v.x>=worldsize || v.y>=worldsize || v.z>=worldsize)
+    {
+        float disttoworld = 0, exitworld = 1e16f;
+        loopi(3)
+        {
+            float c = v[i];
+            if(c<0 || c>=worldsize)
+            {
+                float d = ((invray[i]>0?0:worldsize)-c)*invray[i];
+                if(d<0) return (radius>0?radius:-1);
+                disttoworld = max(disttoworld, 0.1f + d);
+            }
+            float e = ((invray[i]>0?worldsize:0)-c)*invray[i];
+            exitworld = min(exitworld, e);
+        }
+        if(disttoworld > exitworld) return (radius>0?radius:-1);
+        v.add(vec(ray).mul(disttoworld));
+        dist += disttoworld;
+    }
+
+    int x = int(v.x), y = int(v.y), z = int(v.z);
+    for(;;)
+    {
+        int lc = levels[lshift];
+        uint n;
+        for(;;)
+        {
+            lshift--;
+            n = g->nodes[lc + geomstep(x, y, z, lshift)];
+            if(geomkind(n) != GEOM_CHILDREN) break;
+            lc = geomval(n);
+            levels[lshift] = lc;
+        }
+
+        switch(geomkind(n))
+        {
+            case GEOM_SOLID: return dist;
+            case GEOM_EMPTY:
+                if(mode&RAY_CLIPMAT && isclipped(geomval(n)&MATF_VOLUME)) return dist;
+                break;
+            case GEOM_LEAF:
+            {
+                const geomleaf &l = g->leaves[geomval(n)];
+                if(mode&RAY_CLIPMAT && isclipped(l.material&MATF_VOLUME)) return dist;
+                float enterdist = -1e16f, exitdist = 1e16f;
+                const plane *p = &g->planes[l.planes];
+                loopi(l.numplanes)
+                {
+                    float pdist = p[i].dist(v), facing = ray.dot(p[i]);
+                    if(facing < 0)
+                    {
+                        pdist /= -facing;
+                        if(pdist > enterdist) { if(pdist > exitdist) goto nextcube; enterdist = pdist; }
+                    }
+                    else if(facing > 0)
+                    {
+                        pdist /= -facing;
+                        if(pdist < exitdist) { if(pdist < enterdist) goto nextcube; exitdist = pdist; }
+                    }
+                    else if(pdist > 0) goto nextcube;
+                }
+                loopi(3)
+                {
+                    if(ray[i])
+                    {
+                        float prad = fabs(l.r[i] * invray[i]), pdist = (l.o[i] - v[i]) * invray[i], pmin = pdist - prad, pmax = pdist + prad;
+                        if(pmin > enterdist) { if(pmin > exitdist) goto nextcube; enterdist = pmin; }
+                        if(pmax < exitdist) { if(pmax < enterdist) goto nextcube; exitdist = pmax; }
+                    }
+                    else if(v[i] < l.o[i]-l.r[i] || v[i] > l.o[i]+l.r[i]) goto nextcube;
+                }
+                if(exitdist >= 0) return dist + max(enterdist+0.1f, 0.0f);
+                break;
+            }
+        }
+
+    nextcube:
+        ivec lo(x&(~0<<lshift), y&(~0<<lshift), z&(~0<<lshift));
+        float dx = (lo.x+(lsizemask.x<<lshift)-v.x)*invray.x,
+              dy = (lo.y+(lsizemask.y<<lshift)-v.y)*invray.y,
+              dz = (lo.z+(lsizemask.z<<lshift)-v.z)*invray.z;
+        float disttonext = min(dx, min(dy, dz)) + 0.1f;
+        v.add(vec(ray).mul(disttonext));
+        dist += disttonext;
+
+        if(radius>0 && dist>=radius) return dist;
+
+        x = int(v.x);
+        y = int(v.y);
+        z = int(v.z);
+        uint diff = uint(lo.x^x)|uint(lo.y^y)|uint(lo.z^z);
+        if(diff >= uint(worldsize)) return radius>0 ? radius : dist;
+        diff >>= lshift;
+        if(!diff) return radius>0 ? radius : dist;
+        do
+        {
+            lshift++;
+            diff >>= 1;
+        } while(diff);
+    }
+}
+
+// as raycubelos(), though without mapmodels, which only the client has
+bool geomlos(const mapgeom *g, const vec &o, const vec &dest, vec &hitpos)
+{
+    vec ray(dest);
+    ray.sub(o);
+    float mag = ray.magnitude();
+    if(mag <= 0) { hitpos = o; return true; }
+    ray.mul(1/mag);
+    float dist = geomraycast(g, o, ray, mag, RAY_CLIPMAT);
+    hitpos = vec(ray).mul(min(dist, mag)).add(o);
+    return dist >= mag;
+}
+
+// whether the box overlaps the cube: the box is outside if it is past the cube's bounding box
+// or entirely in front of one of its planes
+static inline bool geomoverlap(const mapgeom &g, const geomleaf &l, const vec &bo, const vec &br)
+{
+    if(fabs(bo.x - l.o.x) > br.x + l.r.x || fabs(bo.y - l.o.y) > br.y + l.r.y || fabs(bo.z - l.o.z) > br.z + l.r.z) return false;
+    const plane *p = &g.planes[l.planes];
+    loopi(l.numplanes) if(p[i].dist(bo) > fabs(p[i].x*br.x) + fabs(p[i].y*br.y) + fabs(p[i].z*br.z)) return false;
+    return true;
+}
+
+static bool geomcollide(const mapgeom &g, int first, const ivec &co, int size, const vec &bo, const vec &br, bool gameclip)
+{
+    loopi(8)
+    {
+        ivec o(i, co.x, co.y, co.z, size);
+        if(bo.x + br.x < o.x || bo.x - br.x > o.x + size ||
+           bo.y + br.y < o.y || bo.y - br.y > o.y + size ||
+           bo.z + br.z < o.z || bo.z - br.z > o.z + size)
+            continue;
+        uint n = g.nodes[first+i];
+        if(geomkind(n) == GEOM_CHILDREN)
+        {
+            if(!geomcollide(g, geomval(n), o, size>>1, bo, br, gameclip)) return false;
+            continue;
+        }
+        int material = geomkind(n) == GEOM_LEAF ? g.leaves[geomval(n)].material : geomval(n);
+        switch(material&MATF_CLIP)
+        {
+            case MAT_NOCLIP: continue;
+            case MAT_GAMECLIP: if(gameclip) return false; break;
+            case MAT_CLIP: return false;
+        }
+        switch(geomkind(n))
+        {
+            case GEOM_SOLID: return false;
+            case GEOM_LEAF: if(geomoverlap(g, g.leaves[geomval(n)], bo, br)) return false; break;
+        }
+    }
+    return true;
+}
+
+// as collide() for a player box with its eyes at o, against the world only: false if the box is stuck
+// in geometry or clip, gameclip included if asked; outside the world is free as far as this goes
+bool geomcollide(const mapgeom *g, const vec &o, float radius, float eyeheight, float aboveeye, bool gameclip)
+{
+    vec br(radius, radius, (eyeheight + aboveeye)/2),
+        bo(o.x, o.y, o.z + (aboveeye - eyeheight)/2);
+    return geomcollide(*g, 0, ivec(0, 0, 0), g->worldsize>>1, bo, br, gameclip);
+}
@@ -2,6 +2,14 @@
 #include <signal.h>
 #include <enet/time.h>
 
+// linux gets an edge-triggered epoll loop, which also lifts select's FD_SETSIZE cap on clients
+#ifdef __linux__
+#define MASTER_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <errno.h>
+#endif
+
 #define INPUT_LIMIT 4096
 #define OUTPUT_LIMIT (64*1024)
 #define CLIENT_TIME (3*60*1000)
@@ -111,6 +119,7 @@ struct gameserver
     string ip;
     int port, numpings;
     enet_uint32 lastping, lastpong;
+    int listpos, listlen;
 };
 vector<gameserver *> gameservers;
 
@@ -143,6 +152,7 @@ struct messagebuf
     }
 };
 vector<messagebuf *> gameserverlists, gbanlists;
+vector<char> serverlist; // an addserver line for every server that answered a ping, patched as servers come and go
 bool updateserverlist = true;
 
 struct client
@@ -159,11 +169,28 @@ struct client
     vector<authreq> authreqs;
     bool shouldpurge;
     bool registeredserver;
+    int index;
+    bool queued, canread;
 
-    client() : message(NULL), inputpos(0), outputpos(0), servport(-1), lastauth(0), shouldpurge(false), registeredserver(false) {}
+    client() : message(NULL), inputpos(0), outputpos(0), servport(-1), lastauth(0), shouldpurge(false), registeredserver(false), index(-1), queued(false), canread(false) {}
 };
 vector<client *> clients;
 
+#ifdef MASTER_EPOLL
+int epollfd = -1;
+vector<client *> activeclients;
+
+// queues a client to have its pending output written and its input read on the next pass
+void wakeclient(client &c)
+{
+    if(c.queued) return;
+    c.queued = true;
+    activeclients.add(&c);
+}
+#else
+static inline void wakeclient(client &c) {}
+#endif
+
 ENetSocket serversocket = ENET_SOCKET_NULL;
 
 time_t starttime;
@@ -206,14 +233,19 @@ void purgeclient(int n)
     client &c = *clients[n];
     if(c.message) c.message->purge();
     enet_socket_destroy(c.socket);
+#ifdef MASTER_EPOLL
+    if(c.queued) activeclients.removeobj(&c);
+#endif
     delete clients[n];
-    clients.remove(n);
+    clients.removeunordered(n);
+    if(clients.inrange(n)) clients[n]->index = n;
 }
 
 void output(client &c, const char *msg, int len = 0)
 {
     if(!len) len = strlen(msg);
     c.output.put(msg, len);
+    wakeclient(c);
 }
 
 void outputf(client &c, const char *fmt, ...)
@@ -260,6 +292,16 @@ void setupserver(int port, const char *ip = NULL)
         fatal("failed to make server socket non-blocking");
     if(!setuppingsocket(&address))
         fatal("failed to create ping socket");
+#ifdef MASTER_EPOLL
+    epollfd = epoll_create1(0);
+    if(epollfd < 0) fatal("failed to create epoll instance");
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &serversocket;
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, serversocket, &ev) < 0) fatal("failed to watch server socket");
+    ev.data.ptr = &pingsocket;
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, pingsocket, &ev) < 0) fatal("failed to watch ping socket");
+#endif
 
     enet_time_set(0);
 
@@ -275,18 +317,37 @@ void genserverlist()
     while(gameserverlists.length() && gameserverlists.last()->refs<=0)
         delete gameserverlists.pop();
     messagebuf *l = new messagebuf(gameserverlists);
-    loopv(gameservers)
-    {
-        gameserver &s = *gameservers[i];
-        if(!s.lastpong) continue;
-        defformatstring(cmd)("addserver %s %d\n", s.ip, s.port);
-        l->buf.put(cmd, strlen(cmd));
-    }
+    l->buf.put(serverlist.getbuf(), serverlist.length());
     l->buf.add('\0');
     gameserverlists.add(l);
     updateserverlist = false;
 }
 
+void listgameserver(gameserver &s)
+{
+    if(s.listpos >= 0) return;
+    defformatstring(cmd)("addserver %s %d\n", s.ip, s.port);
+    s.listpos = serverlist.length();
+    s.listlen = strlen(cmd);
+    serverlist.put(cmd, s.listlen);
+    updateserverlist = true;
+}
+
+void unlistgameserver(gameserver &s)
+{
+    if(s.listpos < 0) return;
+    serverlist.remove(s.listpos, s.listlen);
+    loopv(gameservers) if(gameservers[i]->listpos > s.listpos) gameservers[i]->listpos -= s.listlen;
+    s.listpos = -1;
+    updateserverlist = true;
+}
+
+void removegameserver(int n)
+{
+    unlistgameserver(*gameservers[n]);
+    delete gameservers.remove(n);
+}
+
 void gengbanlist()
 {
     messagebuf *l = new messagebuf(gbanlists);
@@ -320,6 +381,7 @@ void gengbanlist()
         {
             c.message = l;
             c.message->refs++;
+            wakeclient(c);
         }
     }
 }
@@ -350,6 +412,8 @@ void addgameserver(client &c)
     s.port = c.servport;
     s.numpings = 0;
     s.lastping = s.lastpong = 0;
+    s.listpos = -1;
+    s.listlen = 0;
 }
 
 client *findclient(gameserver &s)
@@ -396,10 +460,11 @@ void checkserverpongs()
                         {
                             c->message = gbanlists.last();
                             c->message->refs++;
+                            wakeclient(*c);
                         }
                     }
                 }
-                if(!s.lastpong) updateserverlist = true;
+                if(!s.lastpong) listgameserver(s);
                 s.lastpong = servtime ? servtime : 1;
                 break;
             }
@@ -409,11 +474,7 @@ void checkserverpongs()
 
 void bangameservers()
 {
-    loopvrev(gameservers) if(checkban(servbans, gameservers[i]->address.host))
-    {
-        delete gameservers.remove(i);
-        updateserverlist = true;
-    }
+    loopvrev(gameservers) if(checkban(servbans, gameservers[i]->address.host)) removegameserver(i);
 }
 
 void checkgameservers()
@@ -424,19 +485,14 @@ void checkgameservers()
         gameserver &s = *gameservers[i];
         if(s.lastping && s.lastpong && ENET_TIME_LESS_EQUAL(s.lastping, s.lastpong))
         {
-            if(ENET_TIME_DIFFERENCE(servtime, s.lastpong) > KEEPALIVE_TIME)
-            {
-                delete gameservers.remove(i--);
-                updateserverlist = true;
-            }
+            if(ENET_TIME_DIFFERENCE(servtime, s.lastpong) > KEEPALIVE_TIME) removegameserver(i--);
         }
         else if(!s.lastping || ENET_TIME_DIFFERENCE(servtime, s.lastping) > PING_TIME)
         {
             if(s.numpings >= PING_RETRY)
             {
                 servermessage(s, "failreg failed pinging server\n");
-                delete gameservers.remove(i--);
-                updateserverlist = true;
+                removegameserver(i--);
             }
             else
             {
@@ -568,6 +624,7 @@ bool checkclientinput(client &c)
             c.output.setsize(0);
             c.outputpos = 0;
             c.shouldpurge = true;
+            wakeclient(c);
             return true;
         }
         else if(sscanf(c.input, "regserv %d", &port) == 1)
@@ -596,8 +653,149 @@ bool checkclientinput(client &c)
     return c.inputpos<(int)sizeof(c.input);
 }
 
-ENetSocketSet readset, writeset;
+void acceptclients()
+{
+    for(;;)
+    {
+        ENetAddress address;
+        ENetSocket clientsocket = enet_socket_accept(serversocket, &address);
+        if(clientsocket==ENET_SOCKET_NULL) break;
+        if(clients.length()>=CLIENT_LIMIT || checkban(bans, address.host)) { enet_socket_destroy(clientsocket); continue; }
+
+        int dups = 0, oldest = -1;
+        loopv(clients) if(clients[i]->address.host == address.host)
+        {
+            dups++;
+            if(oldest<0 || clients[i]->connecttime < clients[oldest]->connecttime) oldest = i;
+        }
+        if(dups >= DUP_LIMIT) purgeclient(oldest);
+
+        client *c = new client;
+        c->address = address;
+        c->socket = clientsocket;
+        c->connecttime = servtime;
+        c->lastinput = servtime;
+        c->index = clients.length();
+        clients.add(c);
+
+#ifdef MASTER_EPOLL
+        epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = c;
+        if(enet_socket_set_option(clientsocket, ENET_SOCKOPT_NONBLOCK, 1) < 0 || epoll_ctl(epollfd, EPOLL_CTL_ADD, clientsocket, &ev) < 0)
+            purgeclient(c->index);
+#endif
+    }
+}
+
+// sends pending output, returns -1 on error, 0 while some is left, 1 once all is sent
+// with epoll the socket is non-blocking and takes as much as it can; the select() path has a
+// blocking socket that is only known to take one send, a second could stall the whole master
+int flushclient(client &c)
+{
+    while(c.message || c.output.length())
+    {
+        const char *data = c.output.length() ? c.output.getbuf() : c.message->getbuf();
+        int len = c.output.length() ? c.output.length() : c.message->length();
+        ENetBuffer buf;
+        buf.data = (void *)&data[c.outputpos];
+        buf.dataLength = len-c.outputpos;
+        int res = enet_socket_send(c.socket, NULL, &buf, 1);
+        if(res<0) return -1;
+        if(!res) return 0;
+        c.outputpos += res;
+        if(c.outputpos>=len)
+        {
+            if(c.output.length()) c.output.setsize(0);
+            else
+            {
+                c.message->purge();
+                c.message = NULL;
+            }
+            c.outputpos = 0;
+        }
+#ifndef MASTER_EPOLL
+        break;
+#endif
+    }
+    return c.message || c.output.length() ? 0 : 1;
+}
+
+#ifdef MASTER_EPOLL
+// output is drained before any more input is read, so a client that does not read its replies stops being heard
+bool serviceclient(client &c)
+{
+    for(;;)
+    {
+        if(c.message || c.output.length())
+        {
+            int res = flushclient(c);
+            if(res<0) return false;
+            if(!res) return true;
+            if(c.shouldpurge) return false;
+        }
+        if(!c.canread) return true;
+        int res = recv(c.socket, &c.input[c.inputpos], sizeof(c.input) - c.inputpos, 0);
+        if(res<0)
+        {
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            c.canread = false;
+            return true;
+        }
+        if(!res) return false;
+        c.inputpos += res;
+        c.input[min(c.inputpos, (int)sizeof(c.input)-1)] = '\0';
+        if(!checkclientinput(c) || c.output.length() > OUTPUT_LIMIT) return false;
+    }
+}
+
+void serviceclients()
+{
+    while(activeclients.length())
+    {
+        client &c = *activeclients.pop();
+        c.queued = false;
+        if(!serviceclient(c)) purgeclient(c.index);
+    }
+}
+
+void checkclients()
+{
+    static enet_uint32 lastsweep = 0;
+    if(ENET_TIME_DIFFERENCE(servtime, lastsweep) >= 1000)
+    {
+        loopv(clients)
+        {
+            client &c = *clients[i];
+            if(c.authreqs.length()) purgeauths(c);
+            if(ENET_TIME_DIFFERENCE(servtime, c.lastinput) >= (c.registeredserver ? KEEPALIVE_TIME : CLIENT_TIME)) purgeclient(i--);
+        }
+        lastsweep = servtime;
+    }
+    serviceclients();
 
+    // nothing is purged until every event of the batch has been looked at, so none of them can refer to a freed client
+    static epoll_event events[256];
+    int numevents = epoll_wait(epollfd, events, sizeof(events)/sizeof(events[0]), 1000);
+    bool accepting = false, pinged = false;
+    loopi(numevents)
+    {
+        void *ptr = events[i].data.ptr;
+        if(ptr == &serversocket) accepting = true;
+        else if(ptr == &pingsocket) pinged = true;
+        else
+        {
+            client &c = *(client *)ptr;
+            if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) c.canread = true;
+            wakeclient(c);
+        }
+    }
+    serviceclients();
+    if(accepting) acceptclients();
+    if(pinged) checkserverpongs();
+}
+#else
 void checkclients()
 {
     ENetSocketSet readset, writeset;
@@ -617,61 +815,15 @@ void checkclients()
     if(enet_socketset_select(maxsock, &readset, &writeset, 1000)<=0) return;
 
     if(ENET_SOCKETSET_CHECK(readset, pingsocket)) checkserverpongs();
-    if(ENET_SOCKETSET_CHECK(readset, serversocket))
-    {
-        ENetAddress address;
-        ENetSocket clientsocket = enet_socket_accept(serversocket, &address);
-        if(clients.length()>=CLIENT_LIMIT || checkban(bans, address.host)) enet_socket_destroy(clientsocket);
-        else if(clientsocket!=ENET_SOCKET_NULL)
-        {
-            int dups = 0, oldest = -1;
-            loopv(clients) if(clients[i]->address.host == address.host)
-            {
-                dups++;
-                if(oldest<0 || clients[i]->connecttime < clients[oldest]->connecttime) oldest = i;
-            }
-            if(dups >= DUP_LIMIT) purgeclient(oldest);
-
-            client *c = new client;
-            c->address = address;
-            c->socket = clientsocket;
-            c->connecttime = servtime;
-            c->lastinput = servtime;
-            clients.add(c);
-        }
-    }
+    if(ENET_SOCKETSET_CHECK(readset, serversocket)) acceptclients();
 
     loopv(clients)
     {
         client &c = *clients[i];
         if((c.message || c.output.length()) && ENET_SOCKETSET_CHECK(writeset, c.socket))
         {
-            const char *data = c.output.length() ? c.output.getbuf() : c.message->getbuf();
-            int len = c.output.length() ? c.output.length() : c.message->length();
-            ENetBuffer buf;
-            buf.data = (void *)&data[c.outputpos];
-            buf.dataLength = len-c.outputpos;
-            int res = enet_socket_send(c.socket, NULL, &buf, 1);
-            if(res>=0)
-            {
-                c.outputpos += res;
-                if(c.outputpos>=len)
-                {
-                    if(c.output.length()) c.output.setsize(0);
-                    else
-                    { 
-                        c.message->purge();
-                        c.message = NULL; 
-                    }
-                    c.outputpos = 0;
-                    if(!c.message && c.output.empty() && c.shouldpurge)
-                    {
-                        purgeclient(i--);
-                        continue;
-                    }
-                }
-            }
-            else { purgeclient(i--); continue; }
+            int res = flushclient(c);
+            if(res<0 || (res>0 && c.shouldpurge)) { purgeclient(i--); continue; }
         }
         if(ENET_SOCKETSET_CHECK(readset, c.socket))
         {
@@ -691,6 +843,7 @@ void checkclients()
         if(ENET_TIME_DIFFERENCE(servtime, c.lastinput) >= (c.registeredserver ? KEEPALIVE_TIME : CLIENT_TIME)) { purgeclient(i--); continue; }
     }
 }
+#endif
 
 void banclients()
 {
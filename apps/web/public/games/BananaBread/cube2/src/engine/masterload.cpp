@@ -0,0 +1,360 @@
+// load generator for sauer_master
+//
+// Registers a number of fake game servers with the master, each from its own loopback address
+// (127.2.x.y) and answering the master's pings on its info port like a real server, then runs
+// rounds of "list" requests: all of a round's connections are opened at once, each from its
+// own address again (127.1.x.y, since the master drops all but DUP_LIMIT connections per host),
+// and each is timed from connect() until the master has sent the list and closed it.
+//
+// Every round reports the lists per second, the p50/p99/max latency, and how many lists came
+// back complete (an addserver line for every registered server), short or failed.
+//
+// usage: sauer_masterload [-hhost] [-pport] [-sservers] [-nlists] [-rrounds] [-ttimeout]
+//
+// Needs the whole of 127/8 on the loopback device (Linux has it) and file descriptors for every
+// server and list connection. The master itself takes at most CLIENT_LIMIT connections, and
+// without epoll at most FD_SETSIZE (usually 1024) sockets.
+
+#include "cube.h"
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#define MASTERLOAD_SERVERPORT 20000    // every fake server uses it, on its own address
+
+FILE *logfile = stdout;
+
+void fatal(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
+
+void conoutfv(int type, const char *fmt, va_list args)
+{
+    vfprintf(logfile, fmt, args);
+    fputc('\n', logfile);
+}
+
+void conoutf(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    conoutfv(CON_INFO, fmt, args);
+    va_end(args);
+}
+
+void conoutf(int type, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    conoutfv(type, fmt, args);
+    va_end(args);
+}
+
+int port = 28787, numservers = 100, numlists = 1000, rounds = 3, timeout = 30;
+string hostname = "127.0.0.1";
+sockaddr_in masteraddr;
+
+long long microseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000LL + ts.tv_nsec/1000;
+}
+
+// n-th address of the 127.net.x.y block, skipping .0 and .255
+void loopbackaddr(sockaddr_in &addr, int net, int n, int port)
+{
+    defformatstring(ip)("127.%d.%d.%d", net, n/250, n%250 + 1);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+}
+
+// non-blocking socket bound to addr, connecting to the master if it is a stream
+int opensocket(int type, const sockaddr_in &addr)
+{
+    int fd = socket(AF_INET, type, 0);
+    if(fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if(bind(fd, (const sockaddr *)&addr, sizeof(addr)) < 0 ||
+       (type == SOCK_STREAM && connect(fd, (const sockaddr *)&masteraddr, sizeof(masteraddr)) < 0 && errno != EINPROGRESS))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool connected(int fd)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    return !getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) && !err;
+}
+
+struct fakeserver
+{
+    enum { CONNECTING = 0, REGISTERING, REGISTERED, FAILED };
+
+    int tcp, udp, state;
+    vector<char> input;
+
+    fakeserver() : tcp(-1), udp(-1), state(CONNECTING) {}
+    ~fakeserver()
+    {
+        if(tcp >= 0) close(tcp);
+        if(udp >= 0) close(udp);
+    }
+
+    void fail() { state = FAILED; }
+
+    // the master's pings come to the info port, a pong is anything sent back from there
+    void answerpings()
+    {
+        uchar buf[MAXTRANS];
+        sockaddr_in from;
+        socklen_t fromlen;
+        for(;;)
+        {
+            fromlen = sizeof(from);
+            ssize_t len = recvfrom(udp, buf, sizeof(buf), 0, (sockaddr *)&from, &fromlen);
+            if(len < 0) break;
+            sendto(udp, buf, len, 0, (const sockaddr *)&from, fromlen);
+        }
+    }
+
+    void service(short revents)
+    {
+        if(state == CONNECTING && revents & (POLLOUT | POLLERR | POLLHUP))
+        {
+            defformatstring(msg)("regserv %d\n", MASTERLOAD_SERVERPORT);
+            if(!connected(tcp) || send(tcp, msg, strlen(msg), 0) != (ssize_t)strlen(msg)) { fail(); return; }
+            state = REGISTERING;
+        }
+        else if(state == REGISTERING && revents & (POLLIN | POLLERR | POLLHUP))
+        {
+            char buf[1024];
+            ssize_t len = recv(tcp, buf, sizeof(buf), 0);
+            if(len <= 0) { if(len == 0 || errno != EAGAIN) fail(); return; }
+            input.put(buf, len);
+            input.add('\0');
+            if(strstr(input.getbuf(), "succreg")) state = REGISTERED;
+            else if(strstr(input.getbuf(), "failreg")) fail();
+            input.pop();
+        }
+    }
+};
+
+struct lister
+{
+    int fd;
+    long long start, end;
+    bool sent, failed;
+    vector<char> reply;
+
+    lister() : fd(-1), start(0), end(0), sent(false), failed(false) {}
+    ~lister() { finish(true); }
+
+    bool done() const { return fd < 0; }
+
+    void finish(bool error)
+    {
+        if(fd < 0) return;
+        close(fd);
+        fd = -1;
+        end = microseconds();
+        failed = error;
+    }
+
+    int servers()
+    {
+        int n = 0;
+        reply.add('\0');
+        for(const char *s = reply.getbuf(); (s = strstr(s, "addserver ")); s++) n++;
+        reply.pop();
+        return n;
+    }
+
+    void service(short revents)
+    {
+        if(!sent)
+        {
+            if(!(revents & (POLLOUT | POLLERR | POLLHUP))) return;
+            if(!connected(fd) || send(fd, "list\n", 5, 0) != 5) { finish(true); return; }
+            sent = true;
+        }
+        if(!(revents & (POLLIN | POLLERR | POLLHUP))) return;
+        for(;;)
+        {
+            char buf[4096];
+            ssize_t len = recv(fd, buf, sizeof(buf), 0);
+            if(len > 0) { reply.put(buf, len); continue; }
+            if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            finish(len < 0);
+            return;
+        }
+    }
+};
+
+vector<fakeserver *> servers;
+vector<pollfd> pollfds;
+
+void pollservers(int ms, vector<lister *> *lists = NULL)
+{
+    pollfds.setsize(0);
+    loopv(servers)
+    {
+        fakeserver &s = *servers[i];
+        pollfd &u = pollfds.add();
+        u.fd = s.udp;
+        u.events = POLLIN;
+        pollfd &t = pollfds.add();
+        t.fd = s.state == fakeserver::CONNECTING || s.state == fakeserver::REGISTERING ? s.tcp : -1;
+        t.events = s.state == fakeserver::CONNECTING ? POLLOUT : POLLIN;
+    }
+    if(lists) loopv(*lists)
+    {
+        lister &l = *(*lists)[i];
+        pollfd &p = pollfds.add();
+        p.fd = l.fd;
+        p.events = l.sent ? POLLIN : POLLOUT;
+    }
+    if(poll(pollfds.getbuf(), pollfds.length(), ms) <= 0) return;
+    loopv(servers)
+    {
+        if(pollfds[2*i].revents) servers[i]->answerpings();
+        if(pollfds[2*i+1].revents) servers[i]->service(pollfds[2*i+1].revents);
+    }
+    if(lists) loopv(*lists)
+    {
+        short revents = pollfds[2*servers.length() + i].revents;
+        if(revents) (*lists)[i]->service(revents);
+    }
+}
+
+int registerservers()
+{
+    loopi(numservers)
+    {
+        fakeserver *s = servers.add(new fakeserver);
+        sockaddr_in addr;
+        loopbackaddr(addr, 2, i, MASTERLOAD_SERVERPORT+1);
+        s->udp = opensocket(SOCK_DGRAM, addr);
+        addr.sin_port = 0;
+        s->tcp = opensocket(SOCK_STREAM, addr);
+        if(s->udp < 0 || s->tcp < 0) s->fail();
+    }
+    long long deadline = microseconds() + timeout*1000000LL;
+    for(;;)
+    {
+        int pending = 0;
+        loopv(servers) if(servers[i]->state < fakeserver::REGISTERED) pending++;
+        if(!pending || microseconds() >= deadline) break;
+        pollservers(10);
+    }
+    int registered = 0;
+    loopv(servers) if(servers[i]->state == fakeserver::REGISTERED) registered++;
+    return registered;
+}
+
+void runround(int round, int registered)
+{
+    vector<lister *> lists;
+    long long start = microseconds();
+    loopi(numlists)
+    {
+        lister *l = lists.add(new lister);
+        sockaddr_in addr;
+        loopbackaddr(addr, 1, i, 0);
+        l->start = microseconds();
+        l->fd = opensocket(SOCK_STREAM, addr);
+        if(l->fd < 0) l->finish(true);
+    }
+    long long deadline = start + timeout*1000000LL;
+    for(;;)
+    {
+        int pending = 0;
+        loopv(lists) if(!lists[i]->done()) pending++;
+        if(!pending || microseconds() >= deadline) break;
+        pollservers(10, &lists);
+    }
+    long long end = microseconds();
+
+    vector<int> latencies;
+    int complete = 0, incomplete = 0, failed = 0;
+    loopv(lists)
+    {
+        lister &l = *lists[i];
+        if(!l.done() || l.failed) { failed++; continue; }
+        latencies.add(int(l.end - l.start));
+        if(l.servers() == registered) complete++;
+        else incomplete++;
+    }
+    latencies.sort();
+    #define PERCENTILE(frac) (latencies.empty() ? 0.0f : latencies[min(int(latencies.length()*(frac)), latencies.length()-1)]/1000.0f)
+    float secs = max(end - start, 1LL)/1e6f;
+    conoutf("round %d: %d lists in %.3fs (%.0f/sec), %d complete, %d short, %d failed, latency %.1f/%.1f/%.1f ms (p50/p99/max)",
+        round, numlists, secs, latencies.length()/secs, complete, incomplete, failed,
+        PERCENTILE(0.5f), PERCENTILE(0.99f), latencies.empty() ? 0.0f : latencies.last()/1000.0f);
+    #undef PERCENTILE
+    lists.deletecontents();
+}
+
+bool option(const char *opt)
+{
+    if(opt[0] != '-') return false;
+    switch(opt[1])
+    {
+        case 'h': copystring(hostname, opt+2); return true;
+        case 'p': port = atoi(opt+2); return true;
+        case 's': numservers = clamp(atoi(opt+2), 0, 250*250); return true;
+        case 'n': numlists = clamp(atoi(opt+2), 1, 250*250); return true;
+        case 'r': rounds = max(atoi(opt+2), 1); return true;
+        case 't': timeout = max(atoi(opt+2), 1); return true;
+        default: return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(logfile, NULL, _IOLBF, BUFSIZ);
+    for(int i = 1; i < argc; i++) if(!option(argv[i])) fatal("unknown option %s", argv[i]);
+
+    memset(&masteraddr, 0, sizeof(masteraddr));
+    masteraddr.sin_family = AF_INET;
+    masteraddr.sin_port = htons(port);
+    if(inet_pton(AF_INET, hostname, &masteraddr.sin_addr) != 1) fatal("%s is not an IPv4 address", hostname);
+
+    // two sockets per server and one per list connection
+    rlimit limit;
+    if(!getrlimit(RLIMIT_NOFILE, &limit))
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        if(limit.rlim_cur < rlim_t(2*numservers + numlists + 16))
+            fatal("need %d file descriptors, only %d allowed", 2*numservers + numlists + 16, int(limit.rlim_cur));
+    }
+
+    int registered = registerservers();
+    conoutf("registered %d of %d servers with %s:%d", registered, numservers, hostname, port);
+    loopi(rounds) runround(i+1, registered);
+    servers.deletecontents();
+    return EXIT_SUCCESS;
+}
+#endif
@@ -7,6 +7,11 @@
 
 static FILE *logfile = NULL;
 
+#ifdef STANDALONE
+extern int serverinstances;
+#endif
+INSTANCELOCAL int serverinstance = 0; // index of the instance run by this thread, its ports follow those of the previous one
+
 void closelogfile()
 {
     if(logfile)
@@ -37,9 +42,13 @@ void logoutf(const char *fmt, ...)
 
 static void writelog(FILE *file, const char *fmt, va_list args)
 {
-    static char buf[LOGSTRLEN];
-    static uchar ubuf[512];
-    vformatstring(buf, fmt, args, sizeof(buf));
+    static INSTANCELOCAL char buf[LOGSTRLEN];
+    static INSTANCELOCAL uchar ubuf[512];
+    int prefix = 0;
+#ifdef STANDALONE
+    if(serverinstances > 1) { formatstring(buf)("[%d] ", serverinstance); prefix = strlen(buf); }
+#endif
+    vformatstring(&buf[prefix], fmt, args, sizeof(buf)-prefix);
     int len = strlen(buf), carry = 0;
     while(carry < len)
     {
@@ -90,107 +99,6 @@ void conoutf(int type, const char *fmt, ...)
 }
 #endif
 
-// all network traffic is in 32bit ints, which are then compressed using the following simple scheme (assumes that most values are small).
-
-template<class T>
-static inline void putint_(T &p, int n)
-{
-    if(n<128 && n>-127) p.put(n);
-    else if(n<0x8000 && n>=-0x8000) { p.put(0x80); p.put(n); p.put(n>>8); }
-    else { p.put(0x81); p.put(n); p.put(n>>8); p.put(n>>16); p.put(n>>24); }
-}
-void putint(ucharbuf &p, int n) { putint_(p, n); }
-void putint(packetbuf &p, int n) { putint_(p, n); }
-void putint(vector<uchar> &p, int n) { putint_(p, n); }
-
-int getint(ucharbuf &p)
-{
-    int c = (char)p.get();
-    if(c==-128) { int n = p.get(); n |= char(p.get())<<8; return n; }
-    else if(c==-127) { int n = p.get(); n |= p.get()<<8; n |= p.get()<<16; return n|(p.get()<<24); } 
-    else return c;
-}
-
-// much smaller encoding for unsigned integers up to 28 bits, but can handle signed
-template<class T>
-static inline void putuint_(T &p, int n)
-{
-    if(n < 0 || n >= (1<<21))
-    {
-        p.put(0x80 | (n & 0x7F));
-        p.put(0x80 | ((n >> 7) & 0x7F));
-        p.put(0x80 | ((n >> 14) & 0x7F));
-        p.put(n >> 21);
-    }
-    else if(n < (1<<7)) p.put(n);
-    else if(n < (1<<14))
-    {
-        p.put(0x80 | (n & 0x7F));
-        p.put(n >> 7);
-    }
-    else 
-    { 
-        p.put(0x80 | (n & 0x7F)); 
-        p.put(0x80 | ((n >> 7) & 0x7F));
-        p.put(n >> 14); 
-    }
-}
-void putuint(ucharbuf &p, int n) { putuint_(p, n); }
-void putuint(packetbuf &p, int n) { putuint_(p, n); }
-void putuint(vector<uchar> &p, int n) { putuint_(p, n); }
-
-int getuint(ucharbuf &p)
-{
-    int n = p.get();
-    if(n & 0x80)
-    {
-        n += (p.get() << 7) - 0x80;
-        if(n & (1<<14)) n += (p.get() << 14) - (1<<14);
-        if(n & (1<<21)) n += (p.get() << 21) - (1<<21);
-        if(n & (1<<28)) n |= -1<<28;
-    }
-    return n;
-}
-
-template<class T>
-static inline void putfloat_(T &p, float f)
-{
-    lilswap(&f, 1);
-    p.put((uchar *)&f, sizeof(float));
-}
-void putfloat(ucharbuf &p, float f) { putfloat_(p, f); }
-void putfloat(packetbuf &p, float f) { putfloat_(p, f); }
-void putfloat(vector<uchar> &p, float f) { putfloat_(p, f); }
-
-float getfloat(ucharbuf &p)
-{
-    float f;
-    p.get((uchar *)&f, sizeof(float));
-    return lilswap(f);
-}
-
-template<class T>
-static inline void sendstring_(const char *t, T &p)
-{
-    while(*t) putint(p, *t++);
-    putint(p, 0);
-}
-void sendstring(const char *t, ucharbuf &p) { sendstring_(t, p); }
-void sendstring(const char *t, packetbuf &p) { sendstring_(t, p); }
-void sendstring(const char *t, vector<uchar> &p) { sendstring_(t, p); }
-
-void getstring(char *text, ucharbuf &p, int len)
-{
-    char *t = text;
-    do
-    {
-        if(t>=&text[len]) { text[len-1] = 0; return; }
-        if(!p.remaining()) { *t = 0; return; } 
-        *t = getint(p);
-    }
-    while(*t++);
-}
-
 void filtertext(char *dst, const char *src, bool whitespace, int len)
 {
     for(int c = uchar(*src); c; c = uchar(*++src))
@@ -218,15 +126,16 @@ struct client                   // server side version of "dynent" type
     ENetPeer *peer;
     string hostname;
     void *info;
+    bool netmodel;              // offered the same payload model as ours when connecting
 };
 
-vector<client *> clients;
+INSTANCELOCAL vector<client *> clients;
 
-ENetHost *serverhost = NULL;
-int laststatus = 0; 
-ENetSocket pongsock = ENET_SOCKET_NULL, lansock = ENET_SOCKET_NULL;
+INSTANCELOCAL ENetHost *serverhost = NULL;
+INSTANCELOCAL int laststatus = 0; 
+INSTANCELOCAL ENetSocket pongsock = ENET_SOCKET_NULL, lansock = ENET_SOCKET_NULL;
 
-int localclients = 0, nonlocalclients = 0;
+INSTANCELOCAL int localclients = 0, nonlocalclients = 0;
 
 bool hasnonlocalclients() { return nonlocalclients!=0; }
 bool haslocalclients() { return localclients!=0; }
@@ -247,6 +156,7 @@ client &addclient(int type)
     }
     c->info = server::newclientinfo();
     c->type = type;
+    c->netmodel = false;
     switch(type)
     {
         case ST_TCPIP: nonlocalclients++; break;
@@ -291,19 +201,279 @@ ENetPeer *getclientpeer(int i) { return clients.inrange(i) && clients[i]->type==
 int getnumclients()        { return clients.length(); }
 uint getclientip(int n)    { return clients.inrange(n) && clients[n]->type==ST_TCPIP ? clients[n]->peer->address.host : 0; }
 
+// payload compression: a static order-1 range coder model, one table of byte frequencies per channel
+// and preceding byte, trained offline from demos; a client offers the crc of its model when connecting
+// and both ends then compress the channels in netcompress with it, packets that would not shrink are sent plain
+#define NETMODEL_MAGIC "NETMODEL"
+#define NETMODEL_VERSION 1
+#define NETMODEL_CHANNELS 2
+#define NETMODEL_TOTALBITS 15
+#define NETMODEL_TOP (1<<24)
+#define NETMODEL_BOTTOM (1<<16)
+#define NETMODEL_MARK 0x81          // never starts a plain packet, whose first int is always a small message type
+#define NETMODEL_MAXLEN 0xFFFF
+
+struct netmodeltable
+{
+    ushort cum[256][257];           // cumulative frequencies of each byte following the byte indexing the row
+};
+
+static netmodeltable *netmodel = NULL; // shared by every instance, only changed while loading the configuration
+uint netmodelcrc = 0;
+static uint *netsamples = NULL;     // byte pair counts of the training data for each channel
+
+VAR(netcompress, 0, 0, (1<<NETMODEL_CHANNELS)-1); // bit mask of the channels whose packets are compressed when sent
+
+static int netencode(int chan, const uchar *src, int len, uchar *dst, int maxlen)
+{
+    const netmodeltable &t = netmodel[chan];
+    uchar *out = dst, *end = dst + maxlen;
+    uint low = 0, range = ~0U;
+    int prev = 0;
+    loopi(len)
+    {
+        const ushort *cum = t.cum[prev];
+        int c = src[i];
+        range >>= NETMODEL_TOTALBITS;
+        low += cum[c]*range;
+        range *= cum[c+1] - cum[c];
+        for(;;)
+        {
+            if((low ^ (low + range)) >= NETMODEL_TOP)
+            {
+                if(range >= NETMODEL_BOTTOM) break;
+                range = -low & (NETMODEL_BOTTOM - 1);
+            }
+            if(out >= end) return 0;
+            *out++ = low >> 24;
+            range <<= 8;
+            low <<= 8;
+        }
+        prev = c;
+    }
+    while(low)
+    {
+        if(out >= end) return 0;
+        *out++ = low >> 24;
+        low <<= 8;
+    }
+    return int(out - dst);
+}
+
+static bool netdecode(int chan, const uchar *src, int len, uchar *dst, int rawlen)
+{
+    const netmodeltable &t = netmodel[chan];
+    const uchar *in = src, *end = src + len;
+    uint low = 0, range = ~0U, code = 0;
+    loopi(4) code = (code << 8) | (in < end ? *in++ : 0);
+    int prev = 0;
+    loopi(rawlen)
+    {
+        const ushort *cum = t.cum[prev];
+        range >>= NETMODEL_TOTALBITS;
+        uint target = (code - low) / range;
+        if(target >= 1<<NETMODEL_TOTALBITS) return false;
+        int c = 0, hi = 256;
+        while(hi - c > 1)
+        {
+            int mid = (c + hi)/2;
+            if(cum[mid] <= target) c = mid;
+            else hi = mid;
+        }
+        low += cum[c]*range;
+        range *= cum[c+1] - cum[c];
+        for(;;)
+        {
+            if((low ^ (low + range)) >= NETMODEL_TOP)
+            {
+                if(range >= NETMODEL_BOTTOM) break;
+                range = -low & (NETMODEL_BOTTOM - 1);
+            }
+            code = (code << 8) | (in < end ? *in++ : 0);
+            range <<= 8;
+            low <<= 8;
+        }
+        dst[i] = c;
+        prev = c;
+    }
+    return true;
+}
+
+// a compressed copy keeps the packet it was made from referenced while it is in flight,
+// so callers watching that packet's reference count or free callback see no difference
+static void freecompressed(ENetPacket *packet)
+{
+    uchar *buf = packet->data - sizeof(ENetPacket *);
+    ENetPacket *original;
+    memcpy(&original, buf, sizeof(original));
+    delete[] buf;
+    if(original && !--original->referenceCount) enet_packet_destroy(original);
+}
+
+// returns the packet itself if the channel has no model or the model does not make it smaller
+ENetPacket *compresspacket(ENetPacket *packet, int chan)
+{
+    int len = (int)packet->dataLength;
+    if(!netmodel || chan < 0 || chan >= NETMODEL_CHANNELS || len < 8 || len > NETMODEL_MAXLEN) return packet;
+    uchar *buf = new uchar[sizeof(ENetPacket *) + len];
+    ucharbuf p(buf + sizeof(ENetPacket *), len);
+    p.put(NETMODEL_MARK);
+    putuint(p, len);
+    int clen = netencode(chan, packet->data, len, &p.buf[p.len], p.remaining());
+    if(clen <= 0) { delete[] buf; return packet; }
+    memcpy(buf, &packet, sizeof(packet));
+    ENetPacket *compressed = enet_packet_create(p.buf, p.len + clen, packet->flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+    compressed->freeCallback = freecompressed;
+    return compressed;
+}
+
+// called once the compressed copy has been handed to every peer it was for
+void sentcompressed(ENetPacket *compressed, ENetPacket *packet)
+{
+    if(compressed == packet) return;
+    if(compressed->referenceCount) { packet->referenceCount++; return; }
+    memset(compressed->data - sizeof(ENetPacket *), 0, sizeof(ENetPacket *));
+    enet_packet_destroy(compressed);
+}
+
+// returns the packet itself if it was not compressed, or NULL if it can not be decompressed
+ENetPacket *decompresspacket(ENetPacket *packet, int chan)
+{
+    if(!packet->dataLength || packet->data[0] != NETMODEL_MARK) return packet;
+    if(!netmodel || chan < 0 || chan >= NETMODEL_CHANNELS) return NULL;
+    ucharbuf p(packet->data, (int)packet->dataLength);
+    p.get();
+    int len = getuint(p);
+    if(p.overread() || len < 0 || len > NETMODEL_MAXLEN) return NULL;
+    ENetPacket *raw = enet_packet_create(NULL, len, packet->flags & ~ENET_PACKET_FLAG_NO_ALLOCATE);
+    if(!netdecode(chan, &p.buf[p.len], p.remaining(), raw->data, len)) { enet_packet_destroy(raw); return NULL; }
+    return raw;
+}
+
+// an empty compressed packet tells a client that offered our model that it may compress its own packets
+static void acceptnetmodel(ENetPeer *peer)
+{
+    packetbuf p(8, ENET_PACKET_FLAG_RELIABLE);
+    p.put(NETMODEL_MARK);
+    putuint(p, 0);
+    enet_peer_send(peer, 1, p.finalize());
+}
+
+void addnetsample(int chan, const uchar *data, int len)
+{
+    if(chan < 0 || chan >= NETMODEL_CHANNELS) return;
+    if(!netsamples)
+    {
+        netsamples = new uint[NETMODEL_CHANNELS*256*256];
+        memset(netsamples, 0, NETMODEL_CHANNELS*256*256*sizeof(uint));
+    }
+    uint *counts = &netsamples[chan*256*256];
+    int prev = 0;
+    loopi(len) { counts[prev*256 + data[i]]++; prev = data[i]; }
+}
+
+// scales the counts of one row to frequencies summing to the coder's total, keeping every byte codable
+static void scalenetsamples(const uint *counts, ushort *freqs)
+{
+    const int total = 1<<NETMODEL_TOTALBITS;
+    double sum = 0;
+    loopi(256) sum += counts[i];
+    int used = 0, best = 0;
+    loopi(256)
+    {
+        freqs[i] = 1 + (sum > 0 ? int(counts[i]*(total - 256)/sum) : (total - 256)/256);
+        used += freqs[i];
+        if(counts[i] > counts[best]) best = i;
+    }
+    freqs[best] += total - used;
+}
+
+bool savenetmodel(const char *name)
+{
+    if(!netsamples) { conoutf(CON_ERROR, "no net model samples to save"); return false; }
+    stream *f = opengzfile(name, "wb");
+    if(!f) { conoutf(CON_ERROR, "could not write net model \"%s\"", name); return false; }
+    f->write(NETMODEL_MAGIC, strlen(NETMODEL_MAGIC));
+    f->putlil<int>(NETMODEL_VERSION);
+    f->putlil<int>(NETMODEL_CHANNELS);
+    ushort freqs[256];
+    loopi(NETMODEL_CHANNELS*256)
+    {
+        scalenetsamples(&netsamples[i*256], freqs);
+        loopj(256) f->putlil<ushort>(freqs[j]);
+    }
+    delete f;
+    DELETEA(netsamples);
+    conoutf("saved net model \"%s\"", name);
+    return true;
+}
+COMMAND(savenetmodel, "s");
+
+bool loadnetmodel(const char *name)
+{
+    DELETEA(netmodel);
+    netmodelcrc = 0;
+    if(!name[0]) return true;
+    stream *f = opengzfile(name, "rb");
+    if(!f) { conoutf(CON_ERROR, "could not read net model \"%s\"", name); return false; }
+    char magic[sizeof(NETMODEL_MAGIC)-1];
+    bool valid = f->read(magic, sizeof(magic)) == sizeof(magic) && !memcmp(magic, NETMODEL_MAGIC, sizeof(magic)) &&
+                 f->getlil<int>() == NETMODEL_VERSION && f->getlil<int>() == NETMODEL_CHANNELS;
+    netmodeltable *t = new netmodeltable[NETMODEL_CHANNELS];
+    uint crc = crc32(0, NULL, 0);
+    ushort freqs[256];
+    for(int i = 0; valid && i < NETMODEL_CHANNELS*256; i++)
+    {
+        if(f->read(freqs, sizeof(freqs)) != sizeof(freqs)) { valid = false; break; }
+        crc = crc32(crc, (const Bytef *)freqs, sizeof(freqs));
+        lilswap(freqs, 256);
+        ushort *cum = t[i/256].cum[i%256];
+        cum[0] = 0;
+        loopj(256)
+        {
+            if(!freqs[j] || cum[j] + freqs[j] > 1<<NETMODEL_TOTALBITS) { valid = false; break; }
+            cum[j+1] = cum[j] + freqs[j];
+        }
+        if(cum[256] != 1<<NETMODEL_TOTALBITS) valid = false;
+    }
+    delete f;
+    if(!valid)
+    {
+        delete[] t;
+        conoutf(CON_ERROR, "invalid net model \"%s\"", name);
+        return false;
+    }
+    netmodel = t;
+    netmodelcrc = crc ? crc : 1;
+    return true;
+}
+ICOMMAND(netmodel, "s", (char *name), loadnetmodel(name));
+
 void sendpacket(int n, int chan, ENetPacket *packet, int exclude)
 {
     if(n<0)
     {
         server::recordpacket(chan, packet->data, packet->dataLength);
-        loopv(clients) if(i!=exclude && server::allowbroadcast(i)) sendpacket(i, chan, packet);
+        ENetPacket *compressed = NULL;
+        loopv(clients) if(i!=exclude && server::allowbroadcast(i))
+        {
+            if(clients[i]->type==ST_TCPIP && clients[i]->netmodel && netcompress&(1<<chan))
+            {
+                if(!compressed) compressed = compresspacket(packet, chan);
+                enet_peer_send(clients[i]->peer, chan, compressed);
+            }
+            else sendpacket(i, chan, packet);
+        }
+        if(compressed) sentcompressed(compressed, packet);
         return;
     }
     switch(clients[n]->type)
     {
         case ST_TCPIP:
         {
-            enet_peer_send(clients[n]->peer, chan, packet);
+            ENetPacket *compressed = clients[n]->netmodel && netcompress&(1<<chan) ? compresspacket(packet, chan) : packet;
+            enet_peer_send(clients[n]->peer, chan, compressed);
+            sentcompressed(compressed, packet);
             break;
         }
 
@@ -423,9 +593,13 @@ void kicknonlocalclients(int reason)
 
 void process(ENetPacket *packet, int sender, int chan)   // sender may be -1
 {
-    packetbuf p(packet);
+    ENetPacket *raw = decompresspacket(packet, chan);
+    if(!raw) { disconnect_client(sender, DISC_EOP); return; }
+    packetbuf p(raw);
     server::parsepacket(sender, chan, p);
-    if(p.overread()) { disconnect_client(sender, DISC_EOP); return; }
+    bool overread = p.overread();
+    if(raw != packet && !raw->referenceCount) enet_packet_destroy(raw);
+    if(overread) { disconnect_client(sender, DISC_EOP); return; }
 }
 
 void localclienttoserver(int chan, ENetPacket *packet)
@@ -449,11 +623,11 @@ int connectwithtimeout(ENetSocket sock, const char *hostname, const ENetAddress
 }
 #endif
 
-ENetSocket mastersock = ENET_SOCKET_NULL;
-ENetAddress masteraddress = { ENET_HOST_ANY, ENET_PORT_ANY }, serveraddress = { ENET_HOST_ANY, ENET_PORT_ANY };
-int lastupdatemaster = 0;
-vector<char> masterout, masterin;
-int masteroutpos = 0, masterinpos = 0;
+INSTANCELOCAL ENetSocket mastersock = ENET_SOCKET_NULL;
+INSTANCELOCAL ENetAddress masteraddress = { ENET_HOST_ANY, ENET_PORT_ANY }, serveraddress = { ENET_HOST_ANY, ENET_PORT_ANY };
+INSTANCELOCAL int lastupdatemaster = 0;
+INSTANCELOCAL vector<char> masterout, masterin;
+INSTANCELOCAL int masteroutpos = 0, masterinpos = 0;
 VARN(updatemaster, allowupdatemaster, 0, 1, 1);
 
 void disconnectmaster()
@@ -594,7 +768,7 @@ void flushmasterinput()
     else disconnectmaster();
 }
 
-static ENetAddress pongaddr;
+static INSTANCELOCAL ENetAddress pongaddr;
 
 void sendserverinforeply(ucharbuf &p)
 {
@@ -604,38 +778,158 @@ void sendserverinforeply(ucharbuf &p)
     enet_socket_send(pongsock, &pongaddr, &buf, 1);
 }
 
-void checkserversockets()        // reply all server info requests
+// Server info queries are answered from a snapshot of the game's state that the tick takes every
+// serverinfointerval ms, so they can be answered on a thread of their own without touching live
+// state. The snapshot is double buffered without locks: the tick writes the buffer that is not
+// published and then publishes it, a reply pins the published buffer while it reads it, and the
+// tick skips a snapshot rather than write over a buffer that is still pinned.
+#ifdef INSTANCETHREADS
+#define INFOLOAD(x) __atomic_load_n(&(x), __ATOMIC_SEQ_CST)
+#define INFOSTORE(x, val) __atomic_store_n(&(x), val, __ATOMIC_SEQ_CST)
+#define INFOADD(x, val) __atomic_fetch_add(&(x), val, __ATOMIC_SEQ_CST)
+#else
+#define INFOLOAD(x) (x)
+#define INFOSTORE(x, val) ((x) = (val))
+#define INFOADD(x, val) ((x) += (val))
+#endif
+
+struct serverinfobuffers
 {
-    static ENetSocketSet sockset;
-    ENET_SOCKETSET_EMPTY(sockset);
-    ENetSocket maxsock = pongsock;
-    ENET_SOCKETSET_ADD(sockset, pongsock);
-    if(mastersock != ENET_SOCKET_NULL)
+    vector<uchar> buf[2];
+    int cur, pins[2];
+    ENetSocket pongsock, lansock;   // the sockets the info thread answers on
+
+    serverinfobuffers() : cur(0), pongsock(ENET_SOCKET_NULL), lansock(ENET_SOCKET_NULL) { pins[0] = pins[1] = 0; }
+
+    int pin()
     {
-        maxsock = max(maxsock, mastersock);
-        ENET_SOCKETSET_ADD(sockset, mastersock);
+        for(;;)
+        {
+            int i = INFOLOAD(cur);
+            INFOADD(pins[i], 1);
+            if(INFOLOAD(cur) == i) return i;
+            INFOADD(pins[i], -1);
+        }
     }
-    if(lansock != ENET_SOCKET_NULL)
+
+    void unpin(int i) { INFOADD(pins[i], -1); }
+
+    bool publish()
     {
-        maxsock = max(maxsock, lansock);
-        ENET_SOCKETSET_ADD(sockset, lansock);
+        int back = 1 - cur;
+        if(INFOLOAD(pins[back])) return false;
+        buf[back].setsize(0);
+        server::serverinfosnapshot(buf[back]);
+        INFOSTORE(cur, back);
+        return true;
     }
-    if(enet_socketset_select(maxsock, &sockset, NULL, 0) <= 0) return;
+};
+
+static INSTANCELOCAL serverinfobuffers *serverinfo = NULL;
+static INSTANCELOCAL int lastserverinfo = 0;
+
+VAR(serverinfointerval, 0, 100, 1000);
+
+void updateserverinfo()
+{
+    if(!serverinfo) serverinfo = new serverinfobuffers;
+    if(lastserverinfo && totalmillis - lastserverinfo < serverinfointerval) return;
+    if(serverinfo->publish()) lastserverinfo = totalmillis ? totalmillis : 1;
+}
 
+static bool replyserverinfo(ENetSocket sock, serverinfobuffers &info)
+{
     ENetBuffer buf;
     uchar pong[MAXTRANS];
-    loopi(2)
+    buf.data = pong;
+    buf.dataLength = sizeof(pong);
+    int len = enet_socket_receive(sock, &pongaddr, &buf, 1);
+    if(len <= 0) return false;
+    int i = info.pin();
+    ucharbuf req(pong, len), p(pong, sizeof(pong)), snapshot(info.buf[i].getbuf(), info.buf[i].length());
+    p.len += len;
+    server::serverinforeply(req, p, snapshot);
+    info.unpin(i);
+    return true;
+}
+
+#ifdef INSTANCETHREADS
+#include <pthread.h>
+
+VAR(serverinfothread, 0, 1, 1);     // answer server info queries on a thread of their own, read when the server starts
+
+static INSTANCELOCAL bool infothreadrunning = false;
+
+// takes over the instance's info sockets and answers every query as it arrives,
+// so a flood of them costs this thread time instead of the tick's
+static void *serverinfoloop(void *data)
+{
+    serverinfobuffers &info = *(serverinfobuffers *)data;
+    pongsock = info.pongsock;
+    lansock = info.lansock;
+    for(;;)
+    {
+        ENetSocketSet sockset;
+        ENET_SOCKETSET_EMPTY(sockset);
+        ENET_SOCKETSET_ADD(sockset, pongsock);
+        if(lansock != ENET_SOCKET_NULL) ENET_SOCKETSET_ADD(sockset, lansock);
+        int ready = enet_socketset_select(max(pongsock, lansock), &sockset, NULL, 1000);
+        if(ready < 0) break;
+        if(!ready) continue;
+        loopi(2)
+        {
+            ENetSocket sock = i ? lansock : pongsock;
+            if(sock == ENET_SOCKET_NULL || !ENET_SOCKETSET_CHECK(sockset, sock)) continue;
+            while(replyserverinfo(sock, info));
+        }
+    }
+    return NULL;
+}
+
+static void startserverinfothread()
+{
+    if(!serverinfothread || infothreadrunning || pongsock == ENET_SOCKET_NULL) return;
+    if(!serverinfo) serverinfo = new serverinfobuffers;
+    serverinfo->pongsock = pongsock;
+    serverinfo->lansock = lansock;
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, serverinfoloop, serverinfo)) { conoutf(CON_WARN, "WARNING: could not start server info thread"); return; }
+    pthread_detach(thread);
+    infothreadrunning = true;
+}
+#endif
+
+void checkserversockets()        // reply all server info requests
+{
+    static INSTANCELOCAL ENetSocketSet sockset;
+    ENET_SOCKETSET_EMPTY(sockset);
+    ENetSocket maxsock = ENET_SOCKET_NULL;
+    bool polling = true;
+#ifdef INSTANCETHREADS
+    if(infothreadrunning) polling = false;
+#endif
+    if(polling)
+    {
+        maxsock = pongsock;
+        ENET_SOCKETSET_ADD(sockset, pongsock);
+        if(lansock != ENET_SOCKET_NULL)
+        {
+            maxsock = max(maxsock, lansock);
+            ENET_SOCKETSET_ADD(sockset, lansock);
+        }
+    }
+    if(mastersock != ENET_SOCKET_NULL)
+    {
+        maxsock = maxsock == ENET_SOCKET_NULL ? mastersock : max(maxsock, mastersock);
+        ENET_SOCKETSET_ADD(sockset, mastersock);
+    }
+    if(maxsock == ENET_SOCKET_NULL || enet_socketset_select(maxsock, &sockset, NULL, 0) <= 0) return;
+
+    if(polling) loopi(2)
     {
         ENetSocket sock = i ? lansock : pongsock;
         if(sock == ENET_SOCKET_NULL || !ENET_SOCKETSET_CHECK(sockset, sock)) continue;
-
-        buf.data = pong;
-        buf.dataLength = sizeof(pong);
-        int len = enet_socket_receive(sock, &pongaddr, &buf, 1);
-        if(len < 0) return;
-        ucharbuf req(pong, len), p(pong, sizeof(pong));
-        p.len += len;
-        server::serverinforeply(req, p);
+        replyserverinfo(sock, *serverinfo);
     }
 
     if(mastersock != ENET_SOCKET_NULL && ENET_SOCKETSET_CHECK(sockset, mastersock)) flushmasterinput();
@@ -645,26 +939,33 @@ void checkserversockets()        // reply all server info requests
 
 VARF(maxclients, 0, DEFAULTCLIENTS, MAXCLIENTS, { if(!maxclients) maxclients = DEFAULTCLIENTS; });
 VAR(serveruprate, 0, 0, INT_MAX);
+VARF(serverbatch, 0, 0, ENET_HOST_DATAGRAM_BATCH_MAXIMUM, { if(serverhost) enet_host_batch_datagrams(serverhost, serverbatch); });
 SVAR(serverip, "");
 VARF(serverport, 0, server::serverport(), 0xFFFF, { if(!serverport) serverport = server::serverport(); });
+#ifdef STANDALONE
+VAR(serverinstances, 1, 1, 64);
+#endif
+
+// every instance listens on its own pair of game and info ports above serverport
+int instanceport() { return (serverport > 0 ? serverport : server::serverport()) + 2*serverinstance; }
 
 #ifdef STANDALONE
-int curtime = 0, lastmillis = 0, totalmillis = 0;
+INSTANCELOCAL int curtime = 0, lastmillis = 0, totalmillis = 0;
 #endif
 
 void updatemasterserver()
 {
 #if !__EMSCRIPTEN__
-    if(mastername[0] && allowupdatemaster) requestmasterf("regserv %d\n", serverport);
+    if(mastername[0] && allowupdatemaster) requestmasterf("regserv %d\n", instanceport());
     lastupdatemaster = totalmillis ? totalmillis : 1;
 #endif
 }
 
-uint totalsecs = 0;
+INSTANCELOCAL uint totalsecs = 0;
 
 void updatetime()
 {
-    static int lastsec = 0;
+    static INSTANCELOCAL int lastsec = 0;
     if(totalmillis - lastsec >= 1000) 
     {
         int cursecs = (totalmillis - lastsec) / 1000;
@@ -673,6 +974,105 @@ void updatetime()
     }
 }
 
+VAR(serverprofile, 0, 0, 1);
+SVAR(serverprofilefile, "");        // rewritten with the full profile every minute while profiling
+
+#define NUMPROFBUCKETS 20           // bucket b counts durations under 2^b microseconds, the last one all longer ones
+#define PROFTICKBUDGET 33000        // microseconds between world state updates
+
+struct profilestats
+{
+    int count, maxmicros;
+    llong totalmicros;
+    int buckets[NUMPROFBUCKETS];
+
+    int mean() const { return count ? int(totalmicros/count) : 0; }
+
+    // upper bound of the duration the given fraction of samples stayed under
+    int percentile(float frac) const
+    {
+        int target = int(ceil(count*frac)), seen = 0;
+        loopi(NUMPROFBUCKETS) if((seen += buckets[i]) >= target && seen > 0) return min(1<<i, maxmicros);
+        return maxmicros;
+    }
+};
+
+static const char * const profilenames[NUMPROFPHASES] = { "tick", "enet", "packets", "master", "update", "events", "ai", "worldstate" };
+static INSTANCELOCAL profilestats profile[NUMPROFPHASES];
+static INSTANCELOCAL int profileoverruns = 0;
+
+llong profilemicros()
+{
+#ifdef WIN32
+    static LARGE_INTEGER freq = { 0 };
+    if(!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart/freq.QuadPart*1000000 + t.QuadPart%freq.QuadPart*1000000/freq.QuadPart;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return llong(ts.tv_sec)*1000000 + ts.tv_nsec/1000;
+#endif
+}
+
+void addprofile(int phase, int micros)
+{
+    profilestats &s = profile[phase];
+    s.count++;
+    s.totalmicros += micros;
+    s.maxmicros = max(s.maxmicros, micros);
+    int b = 0;
+    while(b < NUMPROFBUCKETS-1 && micros >= 1<<b) b++;
+    s.buckets[b]++;
+    if(phase==PROF_TICK && micros > PROFTICKBUDGET) profileoverruns++;
+}
+
+// body of an EXT_TICKSTATS reply
+void putprofile(ucharbuf &p)
+{
+    putint(p, profileoverruns);
+    putint(p, NUMPROFPHASES);
+    putint(p, NUMPROFBUCKETS);
+    loopi(NUMPROFPHASES)
+    {
+        const profilestats &s = profile[i];
+        sendstring(profilenames[i], p);
+        putint(p, s.count);
+        putint(p, s.mean());
+        putint(p, s.maxmicros);
+        loopj(NUMPROFBUCKETS) putint(p, s.buckets[j]);
+    }
+}
+
+static void writeprofile()
+{
+    const profilestats &t = profile[PROF_TICK];
+    logoutf("profile: %d ticks, %d us mean, %d us p99, %d us max, %d over %d ms", t.count, t.mean(), t.percentile(0.99f), t.maxmicros, profileoverruns, PROFTICKBUDGET/1000);
+    if(!serverprofilefile[0]) return;
+    string name;
+    if(serverinstance) formatstring(name)("%s.%d", serverprofilefile, serverinstance);
+    else copystring(name, serverprofilefile);
+    stream *f = openutf8file(path(name, true), "w");
+    if(!f) { logoutf("could not write profile to %s", name); return; }
+    f->printf("%-12s %10s %10s %10s %10s %10s\n", "phase", "count", "mean us", "p50 us", "p99 us", "max us");
+    loopi(NUMPROFPHASES)
+    {
+        const profilestats &s = profile[i];
+        f->printf("%-12s %10d %10d %10d %10d %10d\n", profilenames[i], s.count, s.mean(), s.percentile(0.5f), s.percentile(0.99f), s.maxmicros);
+    }
+    f->printf("\nticks over %d ms: %d\n\n%-12s", PROFTICKBUDGET/1000, profileoverruns, "us under");
+    loopj(NUMPROFBUCKETS-1) f->printf(" %7d", 1<<j);
+    f->printf(" %7s\n", "more");
+    loopi(NUMPROFPHASES)
+    {
+        f->printf("%-12s", profilenames[i]);
+        loopj(NUMPROFBUCKETS) f->printf(" %7d", profile[i].buckets[j]);
+        f->printf("\n");
+    }
+    delete f;
+}
+
 void serverslice(bool dedicated, uint timeout)   // main server update, called from main loop in sp, or from below in dedicated server
 {
     if(!serverhost) 
@@ -692,10 +1092,18 @@ void serverslice(bool dedicated, uint timeout)   // main server update, called f
         lastmillis += curtime;
         updatetime();
     }
-    server::serverupdate();
+    llong tickstart = serverprofile ? profilemicros() : -1, servicemicros = 0;
+    {
+        profiletimer t(PROF_UPDATE);
+        server::serverupdate();
+    }
 
-    flushmasteroutput();
-    checkserversockets();
+    {
+        profiletimer t(PROF_MASTER);
+        flushmasteroutput();
+        updateserverinfo();
+        checkserversockets();
+    }
 
     if(!lastupdatemaster || totalmillis-lastupdatemaster>60*60*1000)       // send alive signal to masterserver every hour of uptime
         updatemasterserver();
@@ -705,17 +1113,31 @@ void serverslice(bool dedicated, uint timeout)   // main server update, called f
         laststatus = totalmillis;     
         if(nonlocalclients || serverhost->totalSentData || serverhost->totalReceivedData) logoutf("status: %d remote clients, %.1f send, %.1f rec (K/sec)", nonlocalclients, serverhost->totalSentData/60.0f/1024, serverhost->totalReceivedData/60.0f/1024);
         serverhost->totalSentData = serverhost->totalReceivedData = 0;
+        static INSTANCELOCAL poolstats lastpools = { 0, 0, 0, 0 };
+        const poolstats &pools = getpoolstats();
+        if(pools.allocs > lastpools.allocs) logoutf("pools: %lld allocs, %lld from malloc, %lld too large to pool", pools.allocs - lastpools.allocs, pools.mallocs - lastpools.mallocs, pools.large - lastpools.large);
+        lastpools = pools;
+        if(serverprofile) writeprofile();
     }
 
     ENetEvent event;
     bool serviced = false;
     while(!serviced)
     {
-        if(enet_host_check_events(serverhost, &event) <= 0)
+        llong servicestart = tickstart >= 0 ? profilemicros() : -1;
+        int result = enet_host_check_events(serverhost, &event);
+        if(result <= 0)
         {
-            if(enet_host_service(serverhost, &event, timeout) <= 0) break;
+            result = enet_host_service(serverhost, &event, timeout);
             serviced = true;
         }
+        if(servicestart >= 0)
+        {
+            int micros = int(profilemicros() - servicestart);
+            addprofile(PROF_ENET, micros);
+            servicemicros += micros;
+        }
+        if(result <= 0) break;
         switch(event.type)
         {
             case ENET_EVENT_TYPE_CONNECT:
@@ -726,6 +1148,11 @@ void serverslice(bool dedicated, uint timeout)   // main server update, called f
                 char hn[1024];
                 copystring(c.hostname, (enet_address_get_host_ip(&c.peer->address, hn, sizeof(hn))==0) ? hn : "unknown");
                 logoutf("client connected (%s)", c.hostname);
+                if(netmodelcrc && event.data == netmodelcrc)
+                {
+                    c.netmodel = true;
+                    acceptnetmodel(c.peer);
+                }
                 int reason = server::clientconnect(c.num, c.peer->address.host);
                 if(reason) disconnect_client(c.num, reason);
                 break;
@@ -733,7 +1160,11 @@ void serverslice(bool dedicated, uint timeout)   // main server update, called f
             case ENET_EVENT_TYPE_RECEIVE:
             {
                 client *c = (client *)event.peer->data;
-                if(c) process(event.packet, c->num, event.channelID);
+                if(c)
+                {
+                    profiletimer t(PROF_PACKETS);
+                    process(event.packet, c->num, event.channelID);
+                }
                 if(event.packet->referenceCount==0) enet_packet_destroy(event.packet);
                 break;
             }
@@ -751,6 +1182,7 @@ void serverslice(bool dedicated, uint timeout)   // main server update, called f
         }
     }
     if(server::sendpackets()) enet_host_flush(serverhost);
+    if(tickstart >= 0) addprofile(PROF_TICK, int(profilemicros() - tickstart - servicemicros));
 }
 
 void flushserver(bool force)
@@ -1061,9 +1493,45 @@ void emscripten_main_loop_caller() {
 }
 #endif
 
+#ifdef INSTANCETHREADS
+bool setuplistenserver(bool dedicated);
+
+static void *runinstance(void *n)
+{
+    serverinstance = (int)(size_t)n;
+    // the generator state is per thread and would otherwise be seeded from the same second in every instance
+    seedMT(5489U + time(NULL) + serverinstance*2654435761U);
+    setuplistenserver(true);
+    server::serverinit();
+    startserverinfothread();
+    updatemasterserver();
+    logoutf("server instance started on port %d", instanceport());
+    for(;;) serverslice(true, 5);
+    return NULL;
+}
+
+// instance 0 is run by the main thread, every other instance by a thread of its own
+// with its own host, sockets, master server connection and game state
+static void startinstances()
+{
+    for(int i = 1; i < serverinstances; i++)
+    {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, runinstance, (void *)(size_t)i)) fatal("could not start server instance %d", i);
+        pthread_detach(thread);
+    }
+}
+#endif
+
 void rundedicatedserver()
 {
     logoutf("dedicated server started, waiting for clients...");
+#ifdef INSTANCETHREADS
+    startserverinfothread();
+    startinstances();
+#elif defined(STANDALONE)
+    if(serverinstances > 1) logoutf("WARNING: multiple server instances are not supported on this platform");
+#endif
 #ifdef WIN32
     SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS);
 	for(;;)
@@ -1100,7 +1568,7 @@ bool servererror(bool dedicated, const char *desc)
   
 bool setuplistenserver(bool dedicated)
 {
-    ENetAddress address = { ENET_HOST_ANY, serverport <= 0 ? server::serverport() : serverport };
+    ENetAddress address = { ENET_HOST_ANY, instanceport() };
     if(*serverip)
     {
         if(enet_address_set_host(&address, serverip)<0) conoutf(CON_WARN, "WARNING: server ip not resolved");
@@ -1108,8 +1576,9 @@ bool setuplistenserver(bool dedicated)
     }
     serverhost = enet_host_create(&address, min(maxclients + server::reserveclients(), MAXCLIENTS), server::numchannels(), 0, serveruprate);
     if(!serverhost) return servererror(dedicated, "could not create server host");
+    if(serverbatch && enet_host_batch_datagrams(serverhost, serverbatch) < 0) conoutf(CON_WARN, "WARNING: could not enable batched datagrams");
     loopi(maxclients) serverhost->peers[i].data = NULL;
-    address.port = server::serverinfoport(serverport > 0 ? serverport : -1);
+    address.port = server::serverinfoport(address.port);
     pongsock = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
     if(pongsock != ENET_SOCKET_NULL && enet_socket_bind(pongsock, &address) < 0)
     {
@@ -1118,6 +1587,7 @@ bool setuplistenserver(bool dedicated)
     }
     if(pongsock == ENET_SOCKET_NULL) return servererror(dedicated, "could not create server info socket");
     else enet_socket_set_option(pongsock, ENET_SOCKOPT_NONBLOCK, 1);
+    if(serverinstance > 0) return true; // only one instance can listen on the fixed LAN port
     address.port = server::laninfoport();
     lansock = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
     if(lansock != ENET_SOCKET_NULL && (enet_socket_set_option(lansock, ENET_SOCKOPT_REUSEADDR, 1) < 0 || enet_socket_bind(lansock, &address) < 0))
@@ -1192,6 +1662,7 @@ bool serveroption(char *opt)
         case 'j': setvar("serverport", atoi(opt+2)); return true; 
         case 'm': setsvar("mastername", opt+2); setvar("updatemaster", mastername[0] ? 1 : 0); return true;
 #ifdef STANDALONE
+        case 'x': setvar("serverinstances", atoi(opt+2)); return true;
         case 'q': logoutf("Using home directory: %s", opt); sethomedir(opt+2); return true;
         case 'k': logoutf("Adding package directory: %s", opt); addpackagedir(opt+2); return true;
         case 'g': logoutf("Setting log file: %s", opt); setlogfile(opt+2); return true;
@@ -1206,7 +1677,7 @@ vector<const char *> gameargs;
 int main(int argc, char **argv)
 {   
     setlogfile(NULL);
-    if(enet_initialize()<0) fatal("Unable to initialise network module");
+    if(initpacketpools()<0) fatal("Unable to initialise network module");
     atexit(enet_deinitialize);
     enet_time_set(0);
 #if __EMSCRIPTEN__
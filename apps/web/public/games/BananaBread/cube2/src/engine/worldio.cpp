@@ -51,28 +51,28 @@ static void fixent(entity &e, int version)
     if(version <= 31 && e.type == ET_MAPMODEL) { int yaw = (int(e.attr1)%360 + 360)%360 + 7; e.attr1 = yaw - yaw%15; }
 }
 
-bool loadents(const char *fname, vector<entity> &ents, uint *crc)
+// opens a map and reads everything before its entities: the header, vars, game type and texture mru
+stream *openmapfile(const char *fname, octaheader &hdr, char *gametype, int &eif)
 {
     string pakname, mapname, mcfgname, ogzname;
     getmapfilenames(fname, NULL, pakname, mapname, mcfgname);
     formatstring(ogzname)("packages/%s.ogz", mapname);
     stream *f = opengzfile(ogzname, "rb");
-    if(!f) return false;
-    octaheader hdr;
-    if(f->read(&hdr, 7*sizeof(int))!=int(7*sizeof(int))) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return false; }
+    if(!f) return NULL;
+    if(f->read(&hdr, 7*sizeof(int))!=int(7*sizeof(int))) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return NULL; }
     lilswap(&hdr.version, 6);
-    if(strncmp(hdr.magic, "OCTA", 4)!=0 || hdr.worldsize <= 0|| hdr.numents < 0) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return false; }
-    if(hdr.version>MAPVERSION) { conoutf(CON_ERROR, "map %s requires a newer version of Cube 2: Sauerbraten", ogzname); delete f; return false; }
+    if(strncmp(hdr.magic, "OCTA", 4)!=0 || hdr.worldsize <= 0|| hdr.numents < 0) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return NULL; }
+    if(hdr.version>MAPVERSION) { conoutf(CON_ERROR, "map %s requires a newer version of Cube 2: Sauerbraten", ogzname); delete f; return NULL; }
     compatheader chdr;
     if(hdr.version <= 28)
     {
-        if(f->read(&chdr.lightprecision, sizeof(chdr) - 7*sizeof(int)) != int(sizeof(chdr) - 7*sizeof(int))) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return false; }
+        if(f->read(&chdr.lightprecision, sizeof(chdr) - 7*sizeof(int)) != int(sizeof(chdr) - 7*sizeof(int))) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return NULL; }
     }
     else
     {
         int extra = 0;
         if(hdr.version <= 29) extra++;
-        if(f->read(&hdr.blendmap, sizeof(hdr) - (7+extra)*sizeof(int)) != int(sizeof(hdr) - (7+extra)*sizeof(int))) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return false; }
+        if(f->read(&hdr.blendmap, sizeof(hdr) - (7+extra)*sizeof(int)) != int(sizeof(hdr) - (7+extra)*sizeof(int))) { conoutf(CON_ERROR, "map %s has malformatted header", ogzname); delete f; return NULL; }
     }
 
     if(hdr.version <= 28)
@@ -101,22 +101,12 @@ bool loadents(const char *fname, vector<entity> &ents, uint *crc)
         }
     }
 
-    string gametype;
     copystring(gametype, "fps");
-    bool samegame = true;
-    int eif = 0;
+    eif = 0;
     if(hdr.version>=16)
     {
         int len = f->getchar();
         f->read(gametype, len+1);
-    }
-    if(strcmp(gametype, game::gameident()))
-    {
-        samegame = false;
-        conoutf(CON_WARN, "WARNING: loading map from %s game, ignoring entities except for lights/mapmodels", gametype);
-    }
-    if(hdr.version>=16)
-    {
         eif = f->getlil<ushort>();
         int extrasize = f->getlil<ushort>();
         f->seek(extrasize, SEEK_CUR);
@@ -132,6 +122,23 @@ bool loadents(const char *fname, vector<entity> &ents, uint *crc)
         f->seek(nummru*sizeof(ushort), SEEK_CUR);
     }
 
+    return f;
+}
+
+bool loadents(const char *fname, vector<entity> &ents, uint *crc)
+{
+    octaheader hdr;
+    string gametype;
+    int eif = 0;
+    stream *f = openmapfile(fname, hdr, gametype, eif);
+    if(!f) return false;
+    bool samegame = true;
+    if(strcmp(gametype, game::gameident()))
+    {
+        samegame = false;
+        conoutf(CON_WARN, "WARNING: loading map from %s game, ignoring entities except for lights/mapmodels", gametype);
+    }
+
     loopi(min(hdr.numents, MAXENTS))
     {
         entity &e = ents.add();
@@ -1,5 +1,11 @@
 #include "game.h"
 
+// route searches run on worker threads where there are threads to be had, which an emscripten build only has with -pthread
+#if !defined(WIN32) && (!defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__))
+#define ROUTETHREADS 1
+#include <pthread.h>
+#endif
+
 extern int fog;
 
 namespace ai
@@ -127,6 +133,169 @@ namespace ai
         return o;
     }
 
+    // route searches requested by makeroute() while the ai think are queued and handed to worker threads at the
+    // end of update(), so they run alongside the rest of the frame; the routes are applied at the start of the next
+    // update() before anything looks at them, and anything that changes the waypoint graph syncs with the workers first
+    struct routetarget
+    {
+        int node, state, targtype, target; // the ai state this goal is for, or -1 if the caller keeps its own
+    };
+
+    struct routejob
+    {
+        fpsent *d;
+        int node, retries, prevnodes[NUMPREVNODES], found;
+        vector<routetarget> goals; // tried in order until one is reachable, as the candidate loops do inline
+        vector<int> route;
+    };
+
+    static vector<routejob *> queuedroutes, runningroutes, freeroutes;
+
+    static int findroute(routestate &rs, routejob &j)
+    {
+        // retry fails: 0 = first attempt, 1 = try ignoring obstacles, 2 = try ignoring prevnodes too
+        loopv(j.goals) for(int retries = j.retries; retries <= 2; retries++)
+            if(route(rs, j.d, j.prevnodes, j.node, j.goals[i].node, j.route, obstacles, retries)) return i;
+        return -1;
+    }
+
+#ifdef ROUTETHREADS
+    struct routeworker
+    {
+        pthread_t thread;
+        routestate rs;
+    };
+
+    static vector<routeworker *> routeworkers;
+    static pthread_mutex_t routelock = PTHREAD_MUTEX_INITIALIZER;
+    static pthread_cond_t routestart = PTHREAD_COND_INITIALIZER, routedone = PTHREAD_COND_INITIALIZER;
+    static int routenext = 0, routepending = 0;
+    static bool routequit = false;
+
+    static void *routethread(void *data)
+    {
+        routeworker *w = (routeworker *)data;
+        pthread_mutex_lock(&routelock);
+        for(;;)
+        {
+            while(!routequit && routenext >= runningroutes.length()) pthread_cond_wait(&routestart, &routelock);
+            if(routequit) break;
+            routejob &j = *runningroutes[routenext++];
+            pthread_mutex_unlock(&routelock);
+            j.found = findroute(w->rs, j);
+            pthread_mutex_lock(&routelock);
+            if(!--routepending) pthread_cond_signal(&routedone);
+        }
+        pthread_mutex_unlock(&routelock);
+        return NULL;
+    }
+
+    static void stoproutethreads()
+    {
+        if(routeworkers.empty()) return;
+        pthread_mutex_lock(&routelock);
+        while(routepending) pthread_cond_wait(&routedone, &routelock);
+        routequit = true;
+        pthread_cond_broadcast(&routestart);
+        pthread_mutex_unlock(&routelock);
+        loopv(routeworkers) pthread_join(routeworkers[i]->thread, NULL);
+        routeworkers.deletecontents();
+        routequit = false;
+    }
+
+    VARF(aithreads, 0, 2, 16, stoproutethreads());
+#else
+    VAR(aithreads, 0, 0, 0);
+#endif
+
+    static bool threadedroutes()
+    {
+#ifdef ROUTETHREADS
+        while(routeworkers.length() < aithreads)
+        {
+            routeworker *w = new routeworker;
+            if(pthread_create(&w->thread, NULL, routethread, w)) { delete w; break; }
+            routeworkers.add(w);
+        }
+        return !routeworkers.empty();
+#else
+        return false;
+#endif
+    }
+
+    static void waitroutes()
+    {
+#ifdef ROUTETHREADS
+        if(routeworkers.empty() || runningroutes.empty()) return;
+        pthread_mutex_lock(&routelock);
+        while(routepending) pthread_cond_wait(&routedone, &routelock);
+        pthread_mutex_unlock(&routelock);
+#endif
+    }
+
+    static void startroutes()
+    {
+        if(queuedroutes.empty()) return;
+        if(!threadedroutes())
+        { // workers went away since these were queued, so just do them here
+            static routestate rs;
+            loopv(queuedroutes) queuedroutes[i]->found = findroute(rs, *queuedroutes[i]);
+            runningroutes.put(queuedroutes.getbuf(), queuedroutes.length());
+            queuedroutes.setsize(0);
+            return;
+        }
+#ifdef ROUTETHREADS
+        pthread_mutex_lock(&routelock);
+        runningroutes.put(queuedroutes.getbuf(), queuedroutes.length());
+        routepending = runningroutes.length();
+        routenext = 0;
+        pthread_cond_broadcast(&routestart);
+        pthread_mutex_unlock(&routelock);
+        queuedroutes.setsize(0);
+#endif
+    }
+
+    static void applyroutes()
+    {
+        waitroutes();
+        loopv(runningroutes)
+        {
+            routejob &j = *runningroutes[i];
+            if(j.d && j.d->ai)
+            {
+                j.d->ai->route.setsize(0);
+                if(j.found >= 0) j.d->ai->route.move(j.route); // a failed search leaves no route so the ai picks something else
+                if(j.found > 0)
+                { // the ai took on the first goal when the search was queued, so move it on to the one reached
+                    const routetarget &first = j.goals[0], &reached = j.goals[j.found];
+                    aistate &b = j.d->ai->getstate();
+                    if(reached.state >= 0 && b.type == first.state && b.targtype == first.targtype && b.target == first.target)
+                    {
+                        b.type = reached.state;
+                        b.targtype = reached.targtype;
+                        b.target = reached.target;
+                        b.millis = lastmillis;
+                        b.reset();
+                    }
+                }
+            }
+            freeroutes.add(&j);
+        }
+        runningroutes.setsize(0);
+    }
+
+    void syncroutes()
+    {
+        waitroutes();
+    }
+
+    void flushroutes(fpsent *d)
+    {
+        waitroutes();
+        loopv(runningroutes) if(!d || runningroutes[i]->d == d) runningroutes[i]->d = NULL;
+        loopvrev(queuedroutes) if(!d || queuedroutes[i]->d == d) freeroutes.add(queuedroutes.remove(i));
+    }
+
     void create(fpsent *d)
     {
         if(!d->ai) d->ai = new aiinfo;
@@ -134,6 +303,7 @@ namespace ai
 
     void destroy(fpsent *d)
     {
+        flushroutes(d);
         if(d->ai) DELETEP(d->ai);
     }
 
@@ -184,9 +354,10 @@ namespace ai
 
     void update()
     {
-        if(intermission) { loopv(players) if(players[i]->ai) players[i]->stopmoving(); }
+        if(intermission) { flushroutes(); loopv(players) if(players[i]->ai) players[i]->stopmoving(); }
         else // fixed rate logic done out-of-sequence at 1 frame per second for each ai
         {
+            applyroutes(); // before avoid() rebuilds the obstacles the workers were reading
             if(totalmillis-updatemillis > 1000)
             {
                 avoid();
@@ -201,6 +372,7 @@ namespace ai
             int count = 0;
             loopv(players) if(players[i]->ai) think(players[i], ++count == iteration ? true : false);
             if(++iteration > count) iteration = 0;
+            startroutes();
         }
     }
 
@@ -222,10 +394,48 @@ namespace ai
         return !targets.empty();
     }
 
+    // goals route() would refuse anyway are dropped, so the search never waits on them;
+    // returns the index of the first goal kept, or -1 if nothing was queued
+    static int queueroute(fpsent *d, const routetarget *goals, int numgoals, int retries)
+    {
+        if(!threadedroutes()) return -1;
+        int first = 0;
+        while(first < numgoals && (!iswaypoint(goals[first].node) || goals[first].node == d->lastnode)) first++;
+        if(first >= numgoals) return -1;
+        routejob *j = NULL;
+        loopv(queuedroutes) if(queuedroutes[i]->d == d) { j = queuedroutes[i]; break; }
+        if(!j)
+        {
+            j = freeroutes.empty() ? new routejob : freeroutes.pop();
+            queuedroutes.add(j);
+        }
+        j->d = d;
+        j->node = d->lastnode;
+        j->goals.setsize(0);
+        for(int i = first; i < numgoals; i++) if(iswaypoint(goals[i].node) && goals[i].node != d->lastnode) j->goals.add(goals[i]);
+        j->retries = retries;
+        memcpy(j->prevnodes, d->ai->prevnodes, sizeof(j->prevnodes));
+        j->route.setsize(0);
+        j->found = -1;
+        return first;
+    }
+
+    int routegoal(fpsent *d)
+    {
+        loopv(queuedroutes) if(queuedroutes[i]->d == d) return queuedroutes[i]->goals[0].node;
+        return d->ai->route.empty() ? -1 : d->ai->route[0];
+    }
+
     bool makeroute(fpsent *d, aistate &b, int node, bool changed, int retries)
     {
         if(!iswaypoint(d->lastnode)) return false;
 		if(changed && d->ai->route.length() > 1 && d->ai->route[0] == node) return true;
+        routetarget goal = { node, -1, -1, -1 };
+        if(queueroute(d, &goal, 1, retries) >= 0)
+        {
+            b.override = false;
+            return true;
+        }
 		if(route(d, d->lastnode, node, d->ai->route, obstacles, retries))
 		{
 			b.override = false;
@@ -242,18 +452,40 @@ namespace ai
         return makeroute(d, b, node, changed, retries);
     }
 
+    // routes to the first reachable of the goals and returns its index; a queued search can't know which that is
+    // yet, so it takes them all and the first it can try is returned, with applyroutes() moving the ai on if another is reached
+    static int makeroute(fpsent *d, aistate &b, const vector<routetarget> &goals)
+    {
+        if(goals.empty() || !iswaypoint(d->lastnode)) return -1;
+        if(d->ai->route.length() > 1 && d->ai->route[0] == goals[0].node) return 0;
+        int first = queueroute(d, goals.getbuf(), goals.length(), 0);
+        if(first >= 0)
+        {
+            b.override = false;
+            return first;
+        }
+        loopv(goals) if(makeroute(d, b, goals[i].node)) return i;
+        return -1;
+    }
+
     bool randomnode(fpsent *d, aistate &b, const vec &pos, float guard, float wander)
     {
         static vector<int> candidates;
         candidates.setsize(0);
         findwaypointswithin(pos, guard, wander, candidates);
 
+        static vector<routetarget> goals;
+        goals.setsize(0);
         while(!candidates.empty())
         {
             int w = rnd(candidates.length()), n = candidates.removeunordered(w);
-            if(n != d->lastnode && !d->ai->hasprevnode(n) && !obstacles.find(n, d) && makeroute(d, b, n)) return true;
+            if(n == d->lastnode || d->ai->hasprevnode(n) || obstacles.find(n, d)) continue;
+            routetarget &g = goals.add();
+            g.node = g.target = n;
+            g.state = AI_S_INTEREST;
+            g.targtype = AI_T_NODE;
         }
-        return false;
+        return makeroute(d, b, goals) >= 0;
     }
 
     bool randomnode(fpsent *d, aistate &b, float guard, float wander)
@@ -457,6 +689,8 @@ namespace ai
 
     bool parseinterests(fpsent *d, aistate &b, vector<interest> &interests, bool override, bool ignore)
     {
+        static vector<routetarget> goals;
+        goals.setsize(0);
         while(!interests.empty())
         {
             int q = interests.length()-1;
@@ -470,13 +704,17 @@ namespace ai
                     break;
                 default: break;
             }
-            if(proceed && makeroute(d, b, n.node))
-            {
-                d->ai->switchstate(b, n.state, n.targtype, n.target);
-                return true;
-            }
+            if(!proceed) continue;
+            routetarget &g = goals.add();
+            g.node = n.node;
+            g.state = n.state;
+            g.targtype = n.targtype;
+            g.target = n.target;
         }
-        return false;
+        int i = makeroute(d, b, goals);
+        if(i < 0) return false;
+        d->ai->switchstate(b, goals[i].state, goals[i].targtype, goals[i].target);
+        return true;
     }
 
     bool find(fpsent *d, aistate &b, bool override = false)
@@ -510,26 +748,7 @@ namespace ai
         static vector<interest> interests;
         interests.setsize(0);
         assist(d, b, interests);
-        while(!interests.empty())
-        {
-            int q = interests.length()-1;
-            loopi(interests.length()-1) if(interests[i].score < interests[q].score) q = i;
-            interest n = interests.removeunordered(q);
-            bool proceed = true;
-            switch(n.state)
-            {
-                case AI_S_DEFEND: // don't get into herds
-                    proceed = !checkothers(targets, d, n.state, n.targtype, n.target, true);
-                    break;
-                default: break;
-            }
-            if(proceed && makeroute(d, b, n.node))
-            {
-                d->ai->switchstate(b, n.state, n.targtype, n.target);
-                return true;
-            }
-        }
-        return false;
+        return parseinterests(d, b, interests, override, false);
     }
 
     void damaged(fpsent *d, fpsent *e)
@@ -577,12 +796,12 @@ namespace ai
 
     void spawned(fpsent *d)
     {
-        if(d->ai) setup(d);
+        if(d->ai) { flushroutes(d); setup(d); }
     }
 
     void killed(fpsent *d, fpsent *e)
     {
-        if(d->ai) d->ai->reset();
+        if(d->ai) { flushroutes(d); d->ai->reset(); }
     }
 
     void itemspawned(int ent)
@@ -637,7 +856,7 @@ namespace ai
         if(target(d, b, 4, true)) return 1;
         if(randomnode(d, b, SIGHTMIN, 1e16f))
         {
-            d->ai->switchstate(b, AI_S_INTEREST, AI_T_NODE, d->ai->route[0]);
+            d->ai->switchstate(b, AI_S_INTEREST, AI_T_NODE, routegoal(d));
             return 1;
         }
         return 0; // but don't pop the state
@@ -24,15 +24,11 @@ namespace ai
     struct waypoint
     {
         vec o;
-        float curscore, estscore;
 		int weight;
-        ushort route, prev;
         ushort links[MAXWAYPOINTLINKS];
 
         waypoint() {}
-        waypoint(const vec &o, int weight = 0) : o(o), weight(weight), route(0) { memset(links, 0, sizeof(links)); }
-
-        int score() const { return int(curscore) + int(estscore); }
+        waypoint(const vec &o, int weight = 0) : o(o), weight(weight) { memset(links, 0, sizeof(links)); }
 
         int find(int wp)
 		{
@@ -128,6 +124,25 @@ namespace ai
         int remap(fpsent *d, int n, vec &pos, bool retry = false);
     };
 
+    // search scratch for route(), kept apart from the waypoints so that several searches can run at once
+    struct routenode
+    {
+        float curscore, estscore;
+        ushort route, prev;
+
+        int score() const { return int(curscore) + int(estscore); }
+    };
+
+    struct routestate
+    {
+        vector<routenode> nodes;
+        vector<routenode *> queue;
+        ushort routeid;
+
+        routestate() : routeid(0) {}
+    };
+
+    extern bool route(routestate &rs, void *owner, const int *prevnodes, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries = 0);
     extern bool route(fpsent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries = 0);
     extern void navigate();
     extern void clearwaypoints(bool full = false);
@@ -296,8 +311,11 @@ namespace ai
 
     extern bool badhealth(fpsent *d);
     extern bool checkothers(vector<int> &targets, fpsent *d = NULL, int state = -1, int targtype = -1, int target = -1, bool teams = false);
+    extern void syncroutes();
+    extern void flushroutes(fpsent *d = NULL);
     extern bool makeroute(fpsent *d, aistate &b, int node, bool changed = true, int retries = 0);
     extern bool makeroute(fpsent *d, aistate &b, const vec &pos, bool changed = true, int retries = 0);
+    extern int routegoal(fpsent *d);
     extern bool randomnode(fpsent *d, aistate &b, const vec &pos, float guard = SIGHTMIN, float wander = SIGHTMAX);
     extern bool randomnode(fpsent *d, aistate &b, float guard = SIGHTMIN, float wander = SIGHTMAX);
     extern bool violence(fpsent *d, aistate &b, fpsent *e, int pursue = 0);
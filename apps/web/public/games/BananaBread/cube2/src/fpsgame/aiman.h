@@ -1,9 +1,17 @@
 // server-side ai manager
 namespace aiman
 {
-    bool dorefresh = false;
-    VARN(serverbotlimit, botlimit, 0, 8, MAXBOTS);
-    VARN(serverbotbalance, botbalance, 0, 1, 1);
+    INSTANCELOCAL bool dorefresh = false;
+    // masters can change these in game, so every server instance keeps its own copy of the settings
+    INSTANCELOCAL int botlimit = -1, botbalance = -1;
+    VARFN(serverbotlimit, defaultbotlimit, 0, 8, MAXBOTS, botlimit = defaultbotlimit);
+    VARFN(serverbotbalance, defaultbotbalance, 0, 1, 1, botbalance = defaultbotbalance);
+
+    void init()
+    {
+        botlimit = defaultbotlimit;
+        botbalance = defaultbotbalance;
+    }
 
     void calcteams(vector<teamscore> &teams)
     {
@@ -0,0 +1,698 @@
+// headless load generator for sauer_server
+//
+// Connects many simulated players from one process, all sharing one ENet host. Each speaks
+// the regular client protocol: N_CONNECT after N_SERVINFO, N_SPAWN for every N_SPAWNSTATE,
+// an N_POS every 33 ms, N_SHOOT at the nearest player it knows of, N_POSACK for the delta
+// snapshots and N_TRYSPAWN after dying. Players walk the waypoints of a route file in a loop,
+// or between random points of a square area when no route is given.
+//
+// Every report interval it prints the N_PING round trip (which includes the wait for the
+// server's next tick), the gaps between position snapshots (the server's update cadence as
+// the clients see it), ENet's packet loss estimate and the bandwidth in each direction.
+//
+// With -q it also floods the server info port with that many server browser queries a second,
+// and reports how many were answered and their round trip, to see what query load does to the
+// tick (-n0 floods without connecting any players).
+//
+// usage: sauer_botload [-hhost] [-pport] [-nplayers] [-rconnects/sec] [-tseconds] [-iinterval]
+//                      [-wroutefile] [-aarea] [-ffire%] [-khit%] [-mmap] [-gmode] [-qqueries/sec]
+//
+// The server's maxclients (-c) must allow for the players. An idle server has no game running,
+// so the players vote -m (cb2 unless given, -m alone votes nothing) for mode -g when they join.
+
+#include "game.h"
+#include "posdelta.h"
+
+#define BOTLOAD_UPDATE 33           // ms between position updates, as the client's c2sinfo()
+#define BOTLOAD_PING 250            // ms between N_PINGs
+#define BOTLOAD_RESPAWN 3000        // ms a dead player waits before N_TRYSPAWN
+#define BOTLOAD_SPEED 100.0f        // units per second, a player's maxspeed
+#define BOTLOAD_EYEHEIGHT 14.0f
+
+FILE *logfile = stdout;
+
+void fatal(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
+
+void conoutfv(int type, const char *fmt, va_list args)
+{
+    vfprintf(logfile, fmt, args);
+    fputc('\n', logfile);
+}
+
+void conoutf(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    conoutfv(CON_INFO, fmt, args);
+    va_end(args);
+}
+
+void conoutf(int type, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    conoutfv(type, fmt, args);
+    va_end(args);
+}
+
+int players = 32, connectrate = 50, seconds = 0, interval = 5, area = 1024, firechance = 50, hitchance = 30, gamemode = 0, queryrate = 0;
+string hostname = "localhost", mapname = "cb2";
+int port = SAUERBRATEN_SERVER_PORT;
+
+vector<vec> route;
+
+void loadroute(const char *name)
+{
+    FILE *f = fopen(name, "r");
+    if(!f) fatal("could not open route %s", name);
+    char line[256];
+    while(fgets(line, sizeof(line), f))
+    {
+        vec o;
+        if(sscanf(line, "%f %f %f", &o.x, &o.y, &o.z) == 3) route.add(o);
+    }
+    fclose(f);
+    if(route.empty()) fatal("route %s has no waypoints", name);
+}
+
+// what the players learn about everyone on the server, shared since they all see the same game
+struct knownplayer
+{
+    int lifesequence, state;
+    vec o;
+    bool located;
+
+    knownplayer() : lifesequence(-1), state(CS_DEAD), o(0, 0, 0), located(false) {}
+};
+
+vector<knownplayer> known;
+
+knownplayer &getknown(int cn)
+{
+    while(known.length() <= cn) known.add();
+    return known[cn];
+}
+
+struct botplayer
+{
+    int num;
+    ENetPeer *peer;
+    int cn, state, lifesequence, gunselect, ammo[NUMGUNS];
+    bool connected, joined;
+    vec o, vel;
+    float yaw;
+    int waypoint;
+    vec goal;
+    int lastupdate, lastping, lastshot, lastsnapshot, deathmillis, ping;
+    posdeltareceiver posdelta;
+    int posdeltaacked;
+    vector<uchar> messages;
+    bool reliable;
+
+    botplayer(int num) : num(num), peer(NULL), cn(-1), state(CS_SPECTATOR), lifesequence(0), gunselect(GUN_PISTOL), connected(false), joined(false),
+        o(0, 0, 0), vel(0, 0, 0), yaw(0), waypoint(0), goal(0, 0, 0), lastupdate(0), lastping(0), lastshot(0), lastsnapshot(0), deathmillis(0), ping(0),
+        posdeltaacked(-1), reliable(false)
+    {
+        memset(ammo, 0, sizeof(ammo));
+    }
+
+    void nextgoal()
+    {
+        if(route.length())
+        {
+            waypoint = (waypoint + 1)%route.length();
+            goal = route[waypoint];
+        }
+        else goal = vec(rnd(area), rnd(area), 512 + BOTLOAD_EYEHEIGHT);
+    }
+
+    void place()
+    {
+        if(route.length()) waypoint = rnd(route.length());
+        nextgoal();
+        o = goal;
+        nextgoal();
+    }
+};
+
+vector<botplayer *> bots;
+ENetHost *clienthost = NULL;
+enet_uint32 now = 0;
+
+// percentiles of the samples taken in one report interval
+struct samples
+{
+    vector<int> vals;
+
+    void add(int v) { vals.add(v); }
+
+    int percentile(float frac)
+    {
+        if(vals.empty()) return 0;
+        return vals[min(int(vals.length()*frac), vals.length()-1)];
+    }
+
+    const char *format(char *buf)
+    {
+        vals.sort();
+        formatstring(buf)("%d/%d/%d", percentile(0.5f), percentile(0.99f), vals.empty() ? 0 : vals.last());
+        return buf;
+    }
+};
+
+samples pings, snapshotgaps, queryrtts;
+int disconnects = 0, kills = 0, shots = 0, queries = 0, answers = 0;
+
+void sendmessages(botplayer &b)
+{
+    packetbuf p(MAXTRANS);
+    if(b.messages.length())
+    {
+        p.put(b.messages.getbuf(), b.messages.length());
+        b.messages.setsize(0);
+        if(b.reliable) p.reliable();
+        b.reliable = false;
+    }
+    if(b.posdelta.latest > b.posdeltaacked)
+    {
+        putint(p, N_POSACK);
+        putuint(p, b.posdelta.latest);
+        b.posdeltaacked = b.posdelta.latest;
+    }
+    if(now - b.lastping > BOTLOAD_PING)
+    {
+        putint(p, N_PING);
+        putint(p, now);
+        b.lastping = now;
+    }
+    if(p.length()) enet_peer_send(b.peer, 1, p.finalize());
+}
+
+void sendposition(botplayer &b)
+{
+    posstate s(b.cn);
+    s.physstate = PHYS_FLOOR | ((b.lifesequence&1)<<3) | (1<<4);
+    vec feet(b.o.x, b.o.y, b.o.z - BOTLOAD_EYEHEIGHT);
+    int vel = min(int(b.vel.magnitude()*DVELF), 0xFFFF);
+    loopk(3)
+    {
+        s.o[k] = int(feet[k]*DMF);
+        if(s.o[k] < 0 || s.o[k] > 0xFFFF) s.flags |= 1<<k;
+    }
+    if(vel > 0xFF) s.flags |= 1<<3;
+    int yaw = b.yaw < 0 ? 360 + int(b.yaw)%360 : int(b.yaw)%360;
+    s.dir = yaw + 90*360;
+    s.roll = 90;
+    s.vel = vel;
+    s.veldir = s.dir;
+    packetbuf p(100);
+    s.put(p);
+    enet_peer_send(b.peer, 0, p.finalize());
+}
+
+bool hitscan(int gun) { return gun==GUN_SG || gun==GUN_CG || gun==GUN_RIFLE || gun==GUN_PISTOL; }
+
+// fires at the nearest player known to be alive, claiming a hit hitchance% of the time;
+// only hitscan guns are used, since projectiles would need the client to report explosions
+void shoot(botplayer &b)
+{
+    if(!hitscan(b.gunselect) || !b.ammo[b.gunselect])
+    {
+        int gun = -1;
+        for(int i = GUN_SG; i <= GUN_PISTOL; i++) if(hitscan(i) && b.ammo[i]) { gun = i; break; }
+        if(gun < 0) return;
+        b.gunselect = gun;
+        putint(b.messages, N_GUNSELECT);
+        putint(b.messages, gun);
+        b.reliable = true;
+        b.lastshot = now;
+        return;
+    }
+    if(now - b.lastshot < (uint)guns[b.gunselect].attackdelay || rnd(100) >= firechance) return;
+    b.lastshot = now;
+    b.ammo[b.gunselect]--;
+    int target = -1;
+    float bestdist = guns[b.gunselect].range;
+    loopv(known)
+    {
+        knownplayer &k = known[i];
+        if(i == b.cn || k.state != CS_ALIVE || !k.located || k.lifesequence < 0) continue;
+        float dist = k.o.dist(b.o);
+        if(dist < bestdist) { target = i; bestdist = dist; }
+    }
+    vec to;
+    bool hit = target >= 0 && rnd(100) < hitchance;
+    if(target >= 0) to = known[target].o;
+    else to = vec(b.vel).normalize().mul(guns[b.gunselect].range).add(b.o);
+    putint(b.messages, N_SHOOT);
+    putint(b.messages, now);
+    putint(b.messages, b.gunselect);
+    loopk(3) putint(b.messages, int(b.o[k]*DMF));
+    loopk(3) putint(b.messages, int(to[k]*DMF));
+    putint(b.messages, hit ? 1 : 0);
+    if(hit)
+    {
+        vec dir = vec(to).sub(b.o).normalize();
+        putint(b.messages, target);
+        putint(b.messages, known[target].lifesequence);
+        putint(b.messages, int(bestdist*DMF));
+        putint(b.messages, b.gunselect==GUN_SG ? SGRAYS/2 : 1);
+        loopk(3) putint(b.messages, int(dir[k]*DNF));
+    }
+    b.reliable = true;
+    shots++;
+}
+
+void update(botplayer &b)
+{
+    float secs = (now - b.lastupdate)/1000.0f;
+    b.lastupdate = now;
+    if(b.state == CS_DEAD)
+    {
+        if(now - b.deathmillis > BOTLOAD_RESPAWN)
+        {
+            putint(b.messages, N_TRYSPAWN);
+            b.reliable = true;
+            b.deathmillis = now;
+        }
+    }
+    else if(b.state == CS_ALIVE)
+    {
+        vec dir = vec(b.goal).sub(b.o);
+        float dist = dir.magnitude();
+        if(dist <= BOTLOAD_SPEED*secs) { b.o = b.goal; b.nextgoal(); }
+        else b.o.add(dir.mul(BOTLOAD_SPEED*secs/dist));
+        b.vel = vec(b.goal).sub(b.o).normalize().mul(BOTLOAD_SPEED);
+        b.yaw = -atan2(b.vel.x, b.vel.y)/RAD;
+        sendposition(b);
+        shoot(b);
+    }
+    sendmessages(b);
+}
+
+void parsestate(ucharbuf &p, int cn, int *ammo = NULL, int *gunselect = NULL)
+{
+    knownplayer &k = getknown(cn);
+    k.lifesequence = getint(p);
+    loopi(4) getint(p);
+    int gun = getint(p);
+    if(gunselect) *gunselect = gun;
+    loopi(GUN_PISTOL-GUN_SG+1)
+    {
+        int n = getint(p);
+        if(ammo) ammo[GUN_SG+i] = n;
+    }
+}
+
+// reads what a player needs from the server's messages; the message sizes of the protocol
+// table skip the rest, and anything of unknown size ends the packet as in the client
+void parsemessages(botplayer &b, ucharbuf &p, int sender = -1)
+{
+    static int msgsize[NUMSV] = { -1 };
+    if(msgsize[0] < 0)
+    {
+        memset(msgsize, 0, sizeof(msgsize));
+        for(const int *t = msgsizes; *t>=0; t += 2) msgsize[t[0]] = t[1];
+    }
+    char text[MAXTRANS];
+    while(p.remaining())
+    {
+        int type = getint(p);
+        if(p.overread() || type < 0 || type >= NUMSV) return;
+        switch(type)
+        {
+            case N_SERVINFO:
+            {
+                int cn = getint(p), prot = getint(p);
+                if(prot != PROTOCOL_VERSION) fatal("server uses protocol %d, not %d", prot, PROTOCOL_VERSION);
+                getint(p);
+                getint(p);
+                getstring(text, p);
+                b.cn = cn;
+                packetbuf q(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
+                putint(q, N_CONNECT);
+                defformatstring(name)("bot%d", b.num);
+                sendstring(name, q);
+                sendstring("", q);
+                putint(q, 0);
+                enet_peer_send(b.peer, 1, q.finalize());
+                break;
+            }
+
+            case N_WELCOME:
+                b.joined = true;
+                if(!getint(p) && mapname[0])
+                {
+                    static bool voted = false;
+                    if(!voted) conoutf("no game running, voting %s", mapname);
+                    voted = true;
+                    putint(b.messages, N_MAPVOTE);
+                    sendstring(mapname, b.messages);
+                    putint(b.messages, gamemode);
+                    b.reliable = true;
+                }
+                break;
+
+            case N_MAPCHANGE:
+                getstring(text, p);
+                getint(p);
+                getint(p);
+                break;
+
+            case N_ITEMLIST:
+                while(getint(p) >= 0 && !p.overread()) getint(p);
+                break;
+
+            case N_SETTEAM:
+                getint(p);
+                getstring(text, p);
+                getint(p);
+                break;
+
+            case N_INITCLIENT:
+                getint(p);
+                getstring(text, p);
+                getstring(text, p);
+                getint(p);
+                break;
+
+            case N_INITAI:
+                loopi(5) getint(p);
+                getstring(text, p);
+                getstring(text, p);
+                break;
+
+            case N_SERVMSG:
+                getstring(text, p);
+                break;
+
+            case N_RESUME:
+                for(;;)
+                {
+                    int cn = getint(p);
+                    if(p.overread() || cn < 0) break;
+                    int state = getint(p);
+                    loopi(3) getint(p);
+                    parsestate(p, cn);
+                    if(cn != b.cn) getknown(cn).state = state;
+                }
+                break;
+
+            case N_SPAWNSTATE:
+            {
+                int cn = getint(p);
+                if(cn != b.cn) { parsestate(p, cn); break; }
+                memset(b.ammo, 0, sizeof(b.ammo));
+                parsestate(p, cn, b.ammo, &b.gunselect);
+                b.lifesequence = getknown(cn).lifesequence;
+                b.state = CS_ALIVE;
+                getknown(cn).state = CS_ALIVE;
+                b.place();
+                putint(b.messages, N_SPAWN);
+                putint(b.messages, b.lifesequence);
+                putint(b.messages, b.gunselect);
+                b.reliable = true;
+                break;
+            }
+
+            case N_SPAWN:
+                if(sender < 0) return;
+                parsestate(p, sender);
+                getknown(sender).state = CS_ALIVE;
+                break;
+
+            case N_DIED:
+            {
+                int victim = getint(p), actor = getint(p);
+                getint(p);
+                getknown(victim).state = CS_DEAD;
+                if(victim == b.cn)
+                {
+                    b.state = CS_DEAD;
+                    b.deathmillis = now;
+                }
+                if(actor != victim && b.num == 0) kills++;
+                break;
+            }
+
+            case N_FORCEDEATH:
+            {
+                int cn = getint(p);
+                getknown(cn).state = CS_DEAD;
+                if(cn == b.cn) { b.state = CS_DEAD; b.deathmillis = now; }
+                break;
+            }
+
+            case N_SPECTATOR:
+            {
+                int cn = getint(p), val = getint(p);
+                getknown(cn).state = val ? CS_SPECTATOR : CS_DEAD;
+                if(cn == b.cn) { b.state = val ? CS_SPECTATOR : CS_DEAD; b.deathmillis = now; }
+                break;
+            }
+
+            case N_CDIS:
+            {
+                int cn = getint(p);
+                getknown(cn) = knownplayer();
+                break;
+            }
+
+            case N_PONG:
+                pings.add(now - getint(p));
+                b.ping = (b.ping*5 + pings.vals.last())/6;
+                putint(b.messages, N_CLIENTPING);
+                putint(b.messages, b.ping);
+                break;
+
+            case N_CLIENT:
+            {
+                int cn = getint(p), len = getuint(p);
+                ucharbuf q = p.subbuf(len);
+                parsemessages(b, q, cn);
+                break;
+            }
+
+            case N_POSDELTA:
+            {
+                vector<uchar> updates;
+                if(!b.posdelta.read(p, updates)) break;
+                if(b.lastsnapshot) snapshotgaps.add(now - b.lastsnapshot);
+                b.lastsnapshot = now;
+                ucharbuf q(updates.getbuf(), updates.length());
+                while(q.remaining() && getint(q) == N_POS)
+                {
+                    posstate s;
+                    if(!s.parse(q)) break;
+                    knownplayer &k = getknown(s.cn);
+                    k.o = vec(s.o[0], s.o[1], s.o[2]).div(DMF).add(vec(0, 0, BOTLOAD_EYEHEIGHT));
+                    k.located = true;
+                }
+                break;
+            }
+
+            case N_TELEPORT:
+                loopi(3) getint(p);
+                break;
+
+            case N_JUMPPAD:
+                loopi(2) getint(p);
+                break;
+
+            default:
+                if(msgsize[type] <= 0) return;
+                loopi(msgsize[type]-1) getint(p);
+                break;
+        }
+    }
+}
+
+void connectbot(botplayer &b, const ENetAddress &address)
+{
+    b.peer = enet_host_connect(clienthost, &address, 3, 0);
+    if(!b.peer) fatal("could not connect player %d", b.num);
+    b.peer->data = &b;
+    b.lastupdate = now;
+}
+
+ENetSocket querysock = ENET_SOCKET_NULL;
+ENetAddress queryaddress;
+int queriessent = 0;
+
+// plain server info queries, tagged with the time they were sent as the server browser does
+void floodqueries()
+{
+    for(int due = int(now*(long long)queryrate/1000); queriessent < due; queriessent++)
+    {
+        uchar buf[MAXTRANS];
+        ucharbuf p(buf, sizeof(buf));
+        putint(p, now + 1);
+        ENetBuffer b;
+        b.data = buf;
+        b.dataLength = p.length();
+        if(enet_socket_send(querysock, &queryaddress, &b, 1) > 0) queries++;
+    }
+    for(;;)
+    {
+        uchar buf[MAXTRANS];
+        ENetBuffer b;
+        b.data = buf;
+        b.dataLength = sizeof(buf);
+        ENetAddress from;
+        int len = enet_socket_receive(querysock, &from, &b, 1);
+        if(len <= 0) break;
+        ucharbuf p(buf, len);
+        int tag = getint(p);
+        if(p.overread() || tag <= 0) continue;
+        answers++;
+        queryrtts.add(now + 1 - tag);
+    }
+}
+
+enet_uint32 lastreport = 0;
+
+void report()
+{
+    int connected = 0, alive = 0;
+    float loss = 0;
+    loopv(bots)
+    {
+        botplayer &b = *bots[i];
+        if(!b.connected) continue;
+        connected++;
+        if(b.state == CS_ALIVE) alive++;
+        loss += b.peer->packetLoss;
+    }
+    if(connected) loss = 100*loss/(connected*float(ENET_PEER_PACKET_LOSS_SCALE));
+    float secs = max(now - lastreport, 1U)/1000.0f, sent = clienthost->totalSentData/secs/1024, received = clienthost->totalReceivedData/secs/1024;
+    string pingbuf, gapbuf;
+    conoutf("%4ds %4d players, %4d alive, ping %s ms, snapshot gap %s ms (p50/p99/max), %.2f%% loss, %.1f/%.1f K/sec up/down (%.2f/%.2f per player), %d shots, %d kills, %d disconnects",
+        now/1000, connected, alive, pings.format(pingbuf), snapshotgaps.format(gapbuf), loss,
+        sent, received, connected ? sent/connected : 0.0f, connected ? received/connected : 0.0f,
+        shots, kills, disconnects);
+    if(queryrate)
+    {
+        string rttbuf;
+        conoutf("%4ds %d queries, %d answered, %.1f/sec, round trip %s ms (p50/p99/max)",
+            now/1000, queries, answers, answers/secs, queryrtts.format(rttbuf));
+        queryrtts.vals.setsize(0);
+        queries = answers = 0;
+    }
+    pings.vals.setsize(0);
+    snapshotgaps.vals.setsize(0);
+    clienthost->totalSentData = clienthost->totalReceivedData = 0;
+    shots = kills = 0;
+    lastreport = now;
+}
+
+bool option(const char *opt)
+{
+    if(opt[0] != '-') return false;
+    switch(opt[1])
+    {
+        case 'h': copystring(hostname, opt+2); return true;
+        case 'p': port = atoi(opt+2); return true;
+        case 'n': players = clamp(atoi(opt+2), 0, MAXCLIENTS); return true;
+        case 'r': connectrate = max(atoi(opt+2), 1); return true;
+        case 't': seconds = max(atoi(opt+2), 0); return true;
+        case 'i': interval = max(atoi(opt+2), 1); return true;
+        case 'w': loadroute(opt+2); return true;
+        case 'a': area = max(atoi(opt+2), 16); return true;
+        case 'f': firechance = clamp(atoi(opt+2), 0, 100); return true;
+        case 'k': hitchance = clamp(atoi(opt+2), 0, 100); return true;
+        case 'm': copystring(mapname, opt+2); return true;
+        case 'g': gamemode = atoi(opt+2); return true;
+        case 'q': queryrate = max(atoi(opt+2), 0); return true;
+        default: return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    setvbuf(logfile, NULL, _IOLBF, BUFSIZ);
+    for(int i = 1; i < argc; i++) if(!option(argv[i])) fatal("unknown option %s", argv[i]);
+    if(initpacketpools()<0) fatal("Unable to initialise network module");
+    atexit(enet_deinitialize);
+    enet_time_set(0);
+
+    ENetAddress address;
+    if(enet_address_set_host(&address, hostname) < 0) fatal("could not resolve %s", hostname);
+    address.port = port;
+    clienthost = enet_host_create(NULL, max(players, 1), 3, 0, 0);
+    if(!clienthost) fatal("could not create client host");
+    if(queryrate)
+    {
+        queryaddress = address;
+        queryaddress.port = port+1; // as server::serverinfoport()
+        querysock = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+        if(querysock == ENET_SOCKET_NULL) fatal("could not create query socket");
+        enet_socket_set_option(querysock, ENET_SOCKOPT_NONBLOCK, 1);
+        enet_socket_set_option(querysock, ENET_SOCKOPT_RCVBUF, 1<<20);
+    }
+
+    loopi(players) bots.add(new botplayer(i));
+    int started = 0;
+    conoutf("connecting %d players to %s:%d", players, hostname, port);
+    for(;;)
+    {
+        now = enet_time_get();
+        if(seconds && now >= uint(seconds*1000)) break;
+        for(int due = min(players, int(now*connectrate/1000) + 1); started < due; started++) connectbot(*bots[started], address);
+
+        ENetEvent event;
+        while(enet_host_service(clienthost, &event, 1) > 0)
+        {
+            botplayer *b = (botplayer *)event.peer->data;
+            if(!b) { if(event.type == ENET_EVENT_TYPE_RECEIVE) enet_packet_destroy(event.packet); continue; }
+            switch(event.type)
+            {
+                case ENET_EVENT_TYPE_CONNECT:
+                    b->connected = true;
+                    break;
+
+                case ENET_EVENT_TYPE_RECEIVE:
+                {
+                    ucharbuf p(event.packet->data, (int)event.packet->dataLength);
+                    parsemessages(*b, p);
+                    enet_packet_destroy(event.packet);
+                    break;
+                }
+
+                case ENET_EVENT_TYPE_DISCONNECT:
+                    if(b->connected || !disconnects) conoutf("player %d disconnected (reason %d)", b->num, event.data);
+                    b->connected = b->joined = false;
+                    b->state = CS_SPECTATOR;
+                    b->peer->data = NULL;
+                    disconnects++;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        now = enet_time_get();
+        loopv(bots)
+        {
+            botplayer &b = *bots[i];
+            if(b.joined && now - b.lastupdate >= BOTLOAD_UPDATE) update(b);
+        }
+        enet_host_flush(clienthost);
+        if(queryrate) floodqueries();
+        if(now - lastreport >= uint(interval*1000)) report();
+    }
+    if(now > lastreport) report();
+    loopv(bots) if(bots[i]->connected) enet_peer_disconnect(bots[i]->peer, DISC_NONE);
+    enet_host_flush(clienthost);
+    enet_host_destroy(clienthost);
+    if(querysock != ENET_SOCKET_NULL) enet_socket_destroy(querysock);
+    return EXIT_SUCCESS;
+}
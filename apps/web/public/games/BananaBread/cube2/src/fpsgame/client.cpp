@@ -1,4 +1,5 @@
 #include "game.h"
+#include "posdelta.h"
 
 namespace game
 {
@@ -697,6 +698,9 @@ namespace game
         memset(connectpass, 0, sizeof(connectpass));
     }
 
+    posdeltareceiver posdelta;
+    int posdeltaacked = -1;
+
     void gameconnect(bool _remote)
     {
         connected = true;
@@ -720,6 +724,8 @@ namespace game
         player1->state = CS_ALIVE;
         player1->privilege = PRIV_NONE;
         senditemstoserver = false;
+        posdelta.reset();
+        posdeltaacked = -1;
         demoplayback = false;
         gamepaused = false;
         clearclients(false);
@@ -849,6 +855,12 @@ namespace game
             messagereliable = false;
             messagecn = -1;
         }
+        if(posdelta.latest > posdeltaacked)
+        {
+            putint(p, N_POSACK);
+            putuint(p, posdelta.latest);
+            posdeltaacked = posdelta.latest;
+        }
         if(totalmillis-lastping>250)
         {
             putint(p, N_PING);
@@ -984,6 +996,17 @@ namespace game
                 break;
             }
 
+            case N_POSDELTA:
+            {
+                vector<uchar> updates;
+                if(posdelta.read(p, updates))
+                {
+                    ucharbuf q(updates.getbuf(), updates.length());
+                    parsepositions(q);
+                }
+                break;
+            }
+
             case N_TELEPORT:
             {
                 int cn = getint(p), tp = getint(p), td = getint(p);
@@ -1693,6 +1716,44 @@ namespace game
         }
     }
 
+    // a demo download in progress, kept across disconnects so that resumedemo can pick it up again
+    int demoid = 0, demoreceived = 0;
+    stream *demodownload = NULL;
+    string demoname = "";
+
+    void receivedemodata(ucharbuf &p)
+    {
+        int id = getint(p), offset = getint(p), total = getint(p), len = p.remaining();
+        // every getdemo starts over at 0, even one for the download in progress
+        if(offset == 0)
+        {
+            DELETEP(demodownload);
+            formatstring(demoname)("%d.dmo", lastmillis);
+            demodownload = openrawfile(demoname, "wb");
+            if(!demodownload) { demoid = 0; conoutf(CON_ERROR, "could not write demo \"%s\"", demoname); return; }
+            demoid = id;
+            demoreceived = 0;
+        }
+        if(!demodownload || id != demoid || offset != demoreceived) return;
+        demodownload->write(p.subbuf(len).buf, len);
+        demoreceived += len;
+        addmsg(N_DEMOACK, "rii", id, demoreceived);
+        if(demoreceived >= total)
+        {
+            DELETEP(demodownload);
+            demoid = 0;
+            conoutf("received demo \"%s\"", demoname);
+        }
+    }
+
+    void resumedemo()
+    {
+        if(!demodownload) { conoutf(CON_ERROR, "no demo download to resume"); return; }
+        conoutf("resuming demo \"%s\" at %d bytes...", demoname, demoreceived);
+        addmsg(N_DEMOACK, "rii", demoid, demoreceived);
+    }
+    COMMAND(resumedemo, "");
+
     void receivefile(uchar *data, int len)
     {
         ucharbuf p(data, len);
@@ -1712,6 +1773,10 @@ namespace game
                 break;
             }
 
+            case N_DEMODATA:
+                receivedemodata(p);
+                break;
+
             case N_SENDMAP:
             {
                 if(!m_edit) return;
@@ -995,7 +995,7 @@ struct ctfclientmode : clientmode
 	    if(b.type == ai::AI_S_INTEREST && b.targtype == ai::AI_T_NODE) return true; // we already did this..
 		if(randomnode(d, b, ai::SIGHTMIN, 1e16f))
 		{
-            d->ai->switchstate(b, ai::AI_S_INTEREST, ai::AI_T_NODE, d->ai->route[0]);
+            d->ai->switchstate(b, ai::AI_S_INTEREST, ai::AI_T_NODE, ai::routegoal(d));
             return true;
 		}
 		return false;
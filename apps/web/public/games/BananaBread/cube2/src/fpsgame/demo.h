@@ -0,0 +1,242 @@
+// seekable demo container: a plain demoheader, then a run of chunks, each a demochunk header and the
+// zlib packed (millis, chan, len, data) records of a stretch of the game, then an index of where every
+// chunk starts; each chunk opens with keyframe records carrying the whole game state, so playback can
+// start at any chunk without reading the ones before it
+// version 1 demos are a single gzip stream of header and records, which demoreader still plays in order
+
+#define DEMO_INDEXMAGIC "DEMOINDX"
+
+struct demochunk
+{
+    int millis, keyframe, rawlen, len; // keyframe is the length of the keyframe records at the start of the chunk
+};
+
+struct demoindex
+{
+    int millis, offset;
+};
+
+struct demofooter
+{
+    char magic[8];
+    int numchunks, offset;
+};
+
+static inline void putdemorecord(vector<uchar> &buf, int millis, int chan, const void *data, int len)
+{
+    int stamp[3] = { millis, chan, len };
+    lilswap(stamp, 3);
+    buf.put((const uchar *)stamp, sizeof(stamp));
+    buf.put((const uchar *)data, len);
+}
+
+struct demowriter
+{
+    stream *f;
+    vector<uchar> chunk, packed;
+    vector<demoindex> index;
+    int chunkmillis, keyframe;
+
+    demowriter(stream *f) : f(f), chunkmillis(0), keyframe(0) {}
+
+    // ends the current chunk and opens a new one at millis with the given state as its keyframe
+    void addkeyframe(int millis, int chan, const void *data, int len)
+    {
+        flush();
+        chunkmillis = millis;
+        putdemorecord(chunk, millis, chan, data, len);
+        keyframe = chunk.length();
+    }
+
+    void addrecord(int millis, int chan, const void *data, int len)
+    {
+        putdemorecord(chunk, millis, chan, data, len);
+    }
+
+    bool flush()
+    {
+        if(chunk.empty()) return true;
+        uLongf len = compressBound(chunk.length());
+        packed.setsize(0);
+        if(compress2(packed.reserve(len).buf, &len, chunk.getbuf(), chunk.length(), Z_BEST_COMPRESSION) != Z_OK) return false;
+        demoindex &e = index.add();
+        e.millis = chunkmillis;
+        e.offset = (int)f->tell();
+        demochunk c = { chunkmillis, keyframe, chunk.length(), int(len) };
+        lilswap(&c.millis, 4);
+        f->write(&c, sizeof(c));
+        f->write(packed.getbuf(), len);
+        chunk.setsize(0);
+        keyframe = 0;
+        return true;
+    }
+
+    void finish()
+    {
+        flush();
+        demofooter footer;
+        memcpy(footer.magic, DEMO_INDEXMAGIC, sizeof(footer.magic));
+        footer.numchunks = index.length();
+        footer.offset = (int)f->tell();
+        lilswap(&footer.numchunks, 2);
+        loopv(index)
+        {
+            demoindex e = index[i];
+            lilswap(&e.millis, 2);
+            f->write(&e, sizeof(e));
+        }
+        f->write(&footer, sizeof(footer));
+    }
+
+    stream::offset size() { return f->tell() + chunk.length(); }
+};
+
+struct demoreader
+{
+    stream *file, *f;
+    int version;
+    vector<uchar> chunk, packed;
+    vector<demoindex> index;
+    int cur, pos, last, keyframe; // last is where the record next() returned last begins
+
+    demoreader() : file(NULL), f(NULL), version(0), cur(-1), pos(0), last(0), keyframe(0) {}
+    ~demoreader()
+    {
+        if(f != file) DELETEP(f);
+        DELETEP(file);
+    }
+
+    bool seekable() const { return version >= 2; }
+
+    // reads the header, checking only its magic, and the chunk index of a seekable demo
+    bool open(const char *name, demoheader &hdr)
+    {
+        file = f = openfile(name, "rb");
+        if(!file) return false;
+        if(file->read(&hdr, sizeof(demoheader))!=sizeof(demoheader) || memcmp(hdr.magic, DEMO_MAGIC, sizeof(hdr.magic)))
+        {
+            file->seek(0, SEEK_SET);
+            f = opengzfile(NULL, "rb", file);
+            if(!f || f->read(&hdr, sizeof(demoheader))!=sizeof(demoheader) || memcmp(hdr.magic, DEMO_MAGIC, sizeof(hdr.magic))) return false;
+            lilswap(&hdr.version, 2);
+            version = 1;
+            return true;
+        }
+        lilswap(&hdr.version, 2);
+        version = hdr.version;
+        if(version >= 2) loadindex();
+        return true;
+    }
+
+    // uses the trailing index, or walks the chunk headers if the recording never got to write one
+    void loadindex()
+    {
+        index.setsize(0);
+        demofooter footer;
+        stream::offset end = file->size();
+        if(end >= stream::offset(sizeof(demoheader) + sizeof(footer)) && file->seek(end - sizeof(footer), SEEK_SET) &&
+           file->read(&footer, sizeof(footer))==sizeof(footer) && !memcmp(footer.magic, DEMO_INDEXMAGIC, sizeof(footer.magic)))
+        {
+            lilswap(&footer.numchunks, 2);
+            if(footer.numchunks >= 0 && file->seek(footer.offset, SEEK_SET))
+            {
+                loopi(footer.numchunks)
+                {
+                    demoindex e;
+                    if(file->read(&e, sizeof(e))!=sizeof(e)) break;
+                    lilswap(&e.millis, 2);
+                    index.add(e);
+                }
+                if(index.length() == footer.numchunks) { file->seek(sizeof(demoheader), SEEK_SET); return; }
+            }
+            index.setsize(0);
+        }
+        file->seek(sizeof(demoheader), SEEK_SET);
+        for(;;)
+        {
+            stream::offset offset = file->tell();
+            demochunk c;
+            if(file->read(&c, sizeof(c))!=sizeof(c)) break;
+            lilswap(&c.millis, 4);
+            if(c.len < 0 || c.rawlen < 0 || offset + stream::offset(sizeof(c) + c.len) > end) break;
+            demoindex &e = index.add();
+            e.millis = c.millis;
+            e.offset = (int)offset;
+            if(!file->seek(c.len, SEEK_CUR)) break;
+        }
+        file->seek(sizeof(demoheader), SEEK_SET);
+    }
+
+    bool loadchunk(int n)
+    {
+        if(!index.inrange(n) || !file->seek(index[n].offset, SEEK_SET)) return false;
+        demochunk c;
+        if(file->read(&c, sizeof(c))!=sizeof(c)) return false;
+        lilswap(&c.millis, 4);
+        if(c.len < 0 || c.rawlen < 0 || c.keyframe < 0 || c.keyframe > c.rawlen) return false;
+        packed.setsize(0);
+        if(file->read(packed.reserve(c.len).buf, c.len)!=c.len) return false;
+        packed.advance(c.len);
+        uLongf len = c.rawlen;
+        chunk.setsize(0);
+        if(uncompress(chunk.reserve(c.rawlen).buf, &len, packed.getbuf(), c.len) != Z_OK || int(len) != c.rawlen) return false;
+        chunk.advance(c.rawlen);
+        cur = n;
+        keyframe = c.keyframe;
+        pos = last = 0;
+        return true;
+    }
+
+    // parses the record of the current chunk at pos and steps pos past it
+    bool parse(int &pos, int &millis, int &chan, int &len, uchar *&data)
+    {
+        int stamp[3];
+        if(pos + int(sizeof(stamp)) > chunk.length()) return false;
+        memcpy(stamp, &chunk[pos], sizeof(stamp));
+        lilswap(stamp, 3);
+        if(stamp[2] < 0 || pos + int(sizeof(stamp)) + stamp[2] > chunk.length()) return false;
+        millis = stamp[0];
+        chan = stamp[1];
+        len = stamp[2];
+        data = &chunk[pos + sizeof(stamp)];
+        pos += sizeof(stamp) + len;
+        return true;
+    }
+
+    // a chunk's keyframe is skipped when playing on into it from the chunk before,
+    // the first chunk's keyframe is the demo's opening state and is always played
+    bool next(int &millis, int &chan, int &len, uchar *&data)
+    {
+        if(version < 2)
+        {
+            int stamp[3];
+            if(f->read(stamp, sizeof(stamp))!=sizeof(stamp)) return false;
+            lilswap(stamp, 3);
+            if(stamp[2] < 0) return false;
+            chunk.setsize(0);
+            if(f->read(chunk.reserve(stamp[2]).buf, stamp[2])!=stamp[2]) return false;
+            chunk.advance(stamp[2]);
+            millis = stamp[0];
+            chan = stamp[1];
+            len = stamp[2];
+            data = chunk.getbuf();
+            return true;
+        }
+        if(pos >= chunk.length())
+        {
+            if(!loadchunk(cur+1)) return false;
+            if(cur > 0) pos = keyframe;
+        }
+        last = pos;
+        return parse(pos, millis, chan, len, data);
+    }
+
+    // positions playback at the start of the last chunk beginning at or before millis, keyframe included
+    bool seek(int millis)
+    {
+        if(!seekable() || index.empty()) return false;
+        int n = 0;
+        while(index.inrange(n+1) && index[n+1].millis <= millis) n++;
+        return loadchunk(n);
+    }
+};
@@ -8,6 +8,7 @@
 #define EXT_UPTIME                      0
 #define EXT_PLAYERSTATS                 1
 #define EXT_TEAMSCORE                   2
+#define EXT_TICKSTATS                   3
 
 /*
     Client:
@@ -15,6 +16,7 @@
     A: 0 EXT_UPTIME
     B: 0 EXT_PLAYERSTATS cn #a client number or -1 for all players#
     C: 0 EXT_TEAMSCORE
+    D: 0 EXT_TICKSTATS
 
     Server:  
     --------
@@ -23,33 +25,65 @@
          EXT_PLAYERSTATS_RESP_IDS pid(s) #1 packet#
          EXT_PLAYERSTATS_RESP_STATS pid playerdata #1 packet for each player#
     C: 0 EXT_TEAMSCORE EXT_ACK EXT_VERSION 0 or 1 #error, no teammode# remaining_time gamemode loop(teamdata [numbases bases] or -1)
+    D: 0 EXT_TICKSTATS EXT_ACK EXT_VERSION 0 or 1 #error, serverprofile is off# ticks_over_33ms numphases numbuckets
+         loop(phasename count mean_us max_us loop(count under 2^bucket us, the last bucket all longer))
 
     Errors:
     --------------
     B:C:default: 0 command EXT_ACK EXT_VERSION EXT_ERROR
 */
 
+    // Replies are made on the server info thread from a snapshot the tick takes, as records of
+    // key, client number and the body that follows EXT_ACK EXT_VERSION in the reply; the key is the
+    // extended command, or EXT_BASICINFO for the body of the plain server info reply.
+
+    #define EXT_BASICINFO -1
+
+    static void addinfo(vector<uchar> &info, int key, int cn, ucharbuf &body)
+    {
+        putint(info, key);
+        putint(info, cn);
+        putint(info, body.length());
+        info.put(body.buf, body.length());
+    }
+
+    static bool nextinfo(ucharbuf &info, int &key, int &cn, ucharbuf &body)
+    {
+        if(!info.remaining()) return false;
+        key = getint(info);
+        cn = getint(info);
+        int len = getint(info);
+        if(info.overread() || len < 0 || len > info.remaining()) return false;
+        body = info.subbuf(len);
+        return true;
+    }
+
+    static bool findinfo(ucharbuf info, int key, int cn, ucharbuf &body)
+    {
+        int rkey, rcn;
+        while(nextinfo(info, rkey, rcn, body)) if(rkey == key && rcn == cn) return true;
+        return false;
+    }
+
     void extinfoplayer(ucharbuf &p, clientinfo *ci)
     {
-        ucharbuf q = p;
-        putint(q, EXT_PLAYERSTATS_RESP_STATS); // send player stats following
-        putint(q, ci->clientnum); //add player id
-        putint(q, ci->ping);
-        sendstring(ci->name, q);
-        sendstring(ci->team, q);
-        putint(q, ci->state.frags);
-        putint(q, ci->state.flags);
-        putint(q, ci->state.deaths);
-        putint(q, ci->state.teamkills);
-        putint(q, ci->state.damage*100/max(ci->state.shotdamage,1));
-        putint(q, ci->state.health);
-        putint(q, ci->state.armour);
-        putint(q, ci->state.gunselect);
-        putint(q, ci->privilege);
-        putint(q, ci->state.state);
+        putint(p, EXT_PLAYERSTATS_RESP_STATS); // send player stats following
+        putint(p, ci->clientnum); //add player id
+        putint(p, ci->ping);
+        sendstring(ci->name, p);
+        sendstring(ci->team, p);
+        putint(p, ci->state.frags);
+        putint(p, ci->state.flags);
+        putint(p, ci->state.deaths);
+        putint(p, ci->state.teamkills);
+        putint(p, ci->state.damage*100/max(ci->state.shotdamage,1));
+        putint(p, ci->state.health);
+        putint(p, ci->state.armour);
+        putint(p, ci->state.gunselect);
+        putint(p, ci->privilege);
+        putint(p, ci->state.state);
         uint ip = getclientip(ci->clientnum);
-        q.put((uchar*)&ip, 3);
-        sendserverinforeply(q);
+        p.put((uchar*)&ip, 3);
     }
 
     void extinfoteams(ucharbuf &p)
@@ -95,9 +129,34 @@
         }
     }
 
-    void extserverinforeply(ucharbuf &req, ucharbuf &p)
+    void extinfosnapshot(vector<uchar> &info)
+    {
+        uchar buf[MAXTRANS];
+        ucharbuf p(buf, sizeof(buf));
+        putint(p, totalsecs); //in seconds
+        addinfo(info, EXT_UPTIME, -1, p);
+
+        p.len = 0;
+        extinfoteams(p);
+        addinfo(info, EXT_TEAMSCORE, -1, p);
+
+        p.len = 0;
+        putint(p, serverprofile ? EXT_NO_ERROR : EXT_ERROR);
+        if(serverprofile) putprofile(p);
+        addinfo(info, EXT_TICKSTATS, -1, p);
+
+        loopv(clients)
+        {
+            p.len = 0;
+            extinfoplayer(p, clients[i]);
+            addinfo(info, EXT_PLAYERSTATS, clients[i]->clientnum, p);
+        }
+    }
+
+    void extserverinforeply(ucharbuf &req, ucharbuf &p, ucharbuf &info)
     {
         int extcmd = getint(req); // extended commands  
+        ucharbuf body;
 
         //Build a new packet
         putint(p, EXT_ACK); //send ack
@@ -106,8 +165,11 @@
         switch(extcmd)
         {
             case EXT_UPTIME:
+            case EXT_TEAMSCORE:
+            case EXT_TICKSTATS:
             {
-                putint(p, totalsecs); //in seconds
+                if(!findinfo(info, extcmd, -1, body)) return;
+                p.put(body.buf, body.maxlen);
                 break;
             }
 
@@ -115,37 +177,31 @@
             {
                 int cn = getint(req); //a special player, -1 for all
                 
-                clientinfo *ci = NULL;
-                if(cn >= 0)
+                if(cn >= 0 && !findinfo(info, EXT_PLAYERSTATS, cn, body))
                 {
-                    loopv(clients) if(clients[i]->clientnum == cn) { ci = clients[i]; break; }
-                    if(!ci)
-                    {
-                        putint(p, EXT_ERROR); //client requested by id was not found
-                        sendserverinforeply(p);
-                        return;
-                    }
+                    putint(p, EXT_ERROR); //client requested by id was not found
+                    sendserverinforeply(p);
+                    return;
                 }
 
                 putint(p, EXT_NO_ERROR); //so far no error can happen anymore
                 
                 ucharbuf q = p; //remember buffer position
                 putint(q, EXT_PLAYERSTATS_RESP_IDS); //send player ids following
-                if(ci) putint(q, ci->clientnum);
-                else loopv(clients) putint(q, clients[i]->clientnum);
+                int key, rcn;
+                if(cn >= 0) putint(q, cn);
+                else for(ucharbuf s = info; nextinfo(s, key, rcn, body);) if(key == EXT_PLAYERSTATS) putint(q, rcn);
                 sendserverinforeply(q);
             
-                if(ci) extinfoplayer(p, ci);
-                else loopv(clients) extinfoplayer(p, clients[i]);
+                for(ucharbuf s = info; nextinfo(s, key, rcn, body);) if(key == EXT_PLAYERSTATS && (cn < 0 || rcn == cn))
+                {
+                    q = p;
+                    q.put(body.buf, body.maxlen);
+                    sendserverinforeply(q);
+                }
                 return;
             }
 
-            case EXT_TEAMSCORE:
-            {
-                extinfoteams(p);
-                break;
-            }
-
             default:
             {
                 putint(p, EXT_ERROR);
@@ -239,6 +239,8 @@ enum
     N_SWITCHNAME, N_SWITCHMODEL, N_SWITCHTEAM,
     N_INITTOKENS, N_TAKETOKEN, N_EXPIRETOKENS, N_DROPTOKENS, N_DEPOSITTOKENS,
     N_SERVCMD,
+    N_POSDELTA, N_POSACK,
+    N_DEMODATA, N_DEMOACK,
     NUMSV
 };
 
@@ -268,6 +270,8 @@ static const int msgsizes[] =               // size inclusive message token, 0 f
     N_SWITCHNAME, 0, N_SWITCHMODEL, 2, N_SWITCHTEAM, 0,
     N_INITTOKENS, 0, N_TAKETOKEN, 2, N_EXPIRETOKENS, 0, N_DROPTOKENS, 0, N_DEPOSITTOKENS, 2,
     N_SERVCMD, 0,
+    N_POSDELTA, 0, N_POSACK, 0,
+    N_DEMODATA, 0, N_DEMOACK, 3,
     -1
 };
 
@@ -275,8 +279,10 @@ static const int msgsizes[] =               // size inclusive message token, 0 f
 #define SAUERBRATEN_SERVER_PORT 28785
 #define SAUERBRATEN_SERVINFO_PORT 28786
 #define SAUERBRATEN_MASTER_PORT 28787
-#define PROTOCOL_VERSION 259            // bump when protocol changes
-#define DEMO_VERSION 1                  // bump when demo format changes
+#define PROTOCOL_VERSION 260            // bump when protocol changes
+#define DEMO_MINPROTOCOL 259            // oldest protocol whose demos still play back
+#define DEMO_VERSION 2                  // bump when demo format changes
+#define DEMO_GZVERSION 1                // last version stored as a single gzip stream, still played back
 #define DEMO_MAGIC "SAUERBRATEN_DEMO"
 
 struct demoheader
@@ -548,7 +554,7 @@ struct fpsent : dynent, fpsstate
         freeeditinfo(edit);
         if(attackchan >= 0) stopsound(attacksound, attackchan);
         if(idlechan >= 0) stopsound(idlesound, idlechan);
-        if(ai) delete ai;
+        if(ai) { ai::flushroutes(this); delete ai; }
     }
 
     void hitpush(int damage, const vec &dir, fpsent *actor, int gun)
@@ -0,0 +1,88 @@
+// server side lag compensation
+//
+// Every player keeps a short history of the positions its client reported. A hit the
+// shooter claims is checked against where the target was when the shooter saw it: the
+// target is rewound by the shooter's ping and the shot's ray is tested against the
+// target's box there, as the client's intersect() does.
+
+#ifndef __LAGCOMP_H__
+#define __LAGCOMP_H__
+
+enum
+{
+    LAGCOMP_HISTORY = 64,       // power of two, about 2 seconds of position updates
+    LAGCOMP_TELEPORT = 64       // samples further apart than this are not interpolated between
+};
+
+// box of a player as in physent; N_POS carries the feet position, the eyes are above it
+#define LAGCOMP_RADIUS 4.1f
+#define LAGCOMP_EYEHEIGHT 14.0f
+#define LAGCOMP_ABOVEEYE 1.0f
+
+struct lagcomphistory
+{
+    struct sample
+    {
+        int millis;
+        vec o;
+    };
+
+    sample samples[LAGCOMP_HISTORY];
+    int newest, count;
+
+    lagcomphistory() { reset(); }
+
+    void reset() { newest = -1; count = 0; }
+
+    void add(int millis, const vec &o)
+    {
+        if(count && samples[newest].millis >= millis) { samples[newest].o = o; return; }
+        newest = (newest + 1)&(LAGCOMP_HISTORY-1);
+        samples[newest].millis = millis;
+        samples[newest].o = o;
+        if(count < LAGCOMP_HISTORY) count++;
+    }
+
+    // position at the given time, walking back from the newest sample since rewinds are short
+    bool rewind(int millis, vec &o) const
+    {
+        if(!count) return false;
+        const sample *next = &samples[newest];
+        if(millis >= next->millis) { o = next->o; return true; }
+        for(int i = 1; i < count; i++)
+        {
+            const sample &prev = samples[(newest - i)&(LAGCOMP_HISTORY-1)];
+            if(prev.millis <= millis)
+            {
+                if(prev.o.squaredist(next->o) > LAGCOMP_TELEPORT*LAGCOMP_TELEPORT)
+                    o = millis - prev.millis < next->millis - millis ? prev.o : next->o;
+                else o = vec(prev.o).lerp(next->o, float(millis - prev.millis)/(next->millis - prev.millis));
+                return true;
+            }
+            next = &prev;
+        }
+        o = next->o;
+        return true;
+    }
+};
+
+// whether the ray from 'from' along the unit vector 'dir' for 'range' units passes the box of a
+// player standing at o, allowing 'slack' units plus 'spread' units per unit of distance along the ray;
+// the box is treated as a capsule around its vertical axis
+static inline bool lagcomphit(const vec &from, const vec &dir, float range, const vec &o, float spread, float slack)
+{
+    vec r = vec(from).sub(o);
+    float h = LAGCOMP_EYEHEIGHT + LAGCOMP_ABOVEEYE,
+          b = dir.z*h, c = dir.dot(r), e = h*h, f = h*r.z,
+          denom = e - b*b, s = 0, t;
+    // closest points between the ray (from + dir*s) and the axis (o + (0, 0, h*t))
+    if(denom > 1e-6f) s = clamp((b*f - c*e)/denom, 0.0f, range);
+    t = (b*s + f)/e;
+    if(t < 0) { t = 0; s = clamp(-c, 0.0f, range); }
+    else if(t > 1) { t = 1; s = clamp(b - c, 0.0f, range); }
+    vec p = vec(dir).mul(s).add(from), q(o.x, o.y, o.z + h*t);
+    float tolerance = LAGCOMP_RADIUS + slack + spread*s;
+    return p.squaredist(q) <= tolerance*tolerance;
+}
+
+#endif
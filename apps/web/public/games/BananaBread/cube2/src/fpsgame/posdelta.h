@@ -0,0 +1,314 @@
+// delta compressed position snapshots (N_POSDELTA)
+//
+// Instead of relaying every raw N_POS, the server sends each client one snapshot per
+// update holding only the entities that differ from the newest snapshot that client has
+// acknowledged with N_POSACK. Changed entities carry only the fields that differ, as
+// small deltas of the already quantized N_POS values behind a bit mask. A lost snapshot
+// just means the next one is still encoded against the older acknowledged baseline.
+//
+// Snapshot layout: N_POSDELTA, seq, seq-baseline (0 = no baseline), then per entity
+// cn-previouscn (first relative to -1), field mask, changed fields; terminated by 0.
+
+#ifndef __POSDELTA_H__
+#define __POSDELTA_H__
+
+enum
+{
+    POSDELTA_HISTORY = 32,      // snapshots remembered per client, older acks fall back to a full snapshot
+    POSDELTA_REFRESH = 250      // ms between resends of an unchanged entity that is still updating, so it is not shown as lagged
+};
+
+enum
+{
+    PD_OX = 1<<0, PD_OY = 1<<1, PD_OZ = 1<<2, PD_DIR = 1<<3, PD_VEL = 1<<4, PD_VELDIR = 1<<5, PD_FALL = 1<<6,
+    PD_PHYS = 1<<7, PD_FLAGS = 1<<8, PD_ROLL = 1<<9 // rarely changing fields last, so the common masks fit in one byte
+};
+
+// the fields of an N_POS update, as quantized by sendposition()
+struct posstate
+{
+    int cn, physstate, flags, o[3], dir, roll, vel, veldir, fall, falldir;
+
+    posstate() { reset(); }
+    explicit posstate(int cn) { reset(); this->cn = cn; }
+
+    void reset()
+    {
+        cn = -1;
+        physstate = flags = dir = roll = vel = veldir = fall = falldir = 0;
+        o[0] = o[1] = o[2] = 0;
+    }
+
+    // reads the body of an N_POS message, after the N_POS token
+    bool parse(ucharbuf &p)
+    {
+        cn = getuint(p);
+        physstate = p.get();
+        flags = getuint(p);
+        loopk(3)
+        {
+            int n = p.get(); n |= p.get()<<8; if(flags&(1<<k)) { n |= p.get()<<16; if(n&0x800000) n |= -1<<24; }
+            o[k] = n;
+        }
+        dir = p.get(); dir |= p.get()<<8;
+        roll = p.get();
+        vel = p.get(); if(flags&(1<<3)) vel |= p.get()<<8;
+        veldir = p.get(); veldir |= p.get()<<8;
+        fall = falldir = 0;
+        if(flags&(1<<4))
+        {
+            fall = p.get(); if(flags&(1<<5)) fall |= p.get()<<8;
+            if(flags&(1<<6)) { falldir = p.get(); falldir |= p.get()<<8; }
+        }
+        return !p.overread();
+    }
+
+    // writes a complete N_POS message
+    template<class T>
+    void put(T &p) const
+    {
+        putint(p, N_POS);
+        putuint(p, cn);
+        p.put(physstate);
+        putuint(p, flags);
+        loopk(3)
+        {
+            p.put(o[k]&0xFF);
+            p.put((o[k]>>8)&0xFF);
+            if(flags&(1<<k)) p.put((o[k]>>16)&0xFF);
+        }
+        p.put(dir&0xFF);
+        p.put((dir>>8)&0xFF);
+        p.put(roll);
+        p.put(vel&0xFF);
+        if(flags&(1<<3)) p.put((vel>>8)&0xFF);
+        p.put(veldir&0xFF);
+        p.put((veldir>>8)&0xFF);
+        if(flags&(1<<4))
+        {
+            p.put(fall&0xFF);
+            if(flags&(1<<5)) p.put((fall>>8)&0xFF);
+            if(flags&(1<<6)) { p.put(falldir&0xFF); p.put((falldir>>8)&0xFF); }
+        }
+    }
+
+    int deltamask(const posstate &b) const
+    {
+        int mask = 0;
+        if(o[0] != b.o[0]) mask |= PD_OX;
+        if(o[1] != b.o[1]) mask |= PD_OY;
+        if(o[2] != b.o[2]) mask |= PD_OZ;
+        if(dir != b.dir) mask |= PD_DIR;
+        if(vel != b.vel) mask |= PD_VEL;
+        if(veldir != b.veldir) mask |= PD_VELDIR;
+        if(fall != b.fall || falldir != b.falldir) mask |= PD_FALL;
+        if(physstate != b.physstate) mask |= PD_PHYS;
+        if(flags != b.flags) mask |= PD_FLAGS;
+        if(roll != b.roll) mask |= PD_ROLL;
+        return mask;
+    }
+
+    template<class T>
+    void putdelta(T &p, const posstate &b) const
+    {
+        int mask = deltamask(b);
+        putuint(p, mask);
+        loopk(3) if(mask&(PD_OX<<k)) putint(p, o[k] - b.o[k]);
+        if(mask&PD_DIR) putint(p, dir - b.dir);
+        if(mask&PD_VEL) putint(p, vel - b.vel);
+        if(mask&PD_VELDIR) putint(p, veldir - b.veldir);
+        if(mask&PD_FALL) { putint(p, fall - b.fall); putint(p, falldir - b.falldir); }
+        if(mask&PD_PHYS) p.put(physstate);
+        if(mask&PD_FLAGS) putuint(p, flags);
+        if(mask&PD_ROLL) p.put(roll);
+    }
+
+    // inverse of putdelta, cn is left to the caller
+    void getdelta(ucharbuf &p, const posstate &b)
+    {
+        int mask = getuint(p);
+        loopk(3) o[k] = b.o[k] + (mask&(PD_OX<<k) ? getint(p) : 0);
+        dir = b.dir + (mask&PD_DIR ? getint(p) : 0);
+        vel = b.vel + (mask&PD_VEL ? getint(p) : 0);
+        veldir = b.veldir + (mask&PD_VELDIR ? getint(p) : 0);
+        if(mask&PD_FALL) { fall = b.fall + getint(p); falldir = b.falldir + getint(p); }
+        else { fall = b.fall; falldir = b.falldir; }
+        physstate = mask&PD_PHYS ? p.get() : b.physstate;
+        flags = mask&PD_FLAGS ? getuint(p) : b.flags;
+        roll = mask&PD_ROLL ? p.get() : b.roll;
+    }
+
+    bool operator==(const posstate &b) const { return cn == b.cn && !deltamask(b); }
+    bool operator!=(const posstate &b) const { return !(*this == b); }
+};
+
+// entity states known to a client after a snapshot, sorted by cn
+struct possnapshot
+{
+    int seq;
+    vector<posstate> states;
+
+    possnapshot() : seq(-1) {}
+
+    posstate *find(int cn)
+    {
+        int lo = 0, hi = states.length();
+        while(lo < hi)
+        {
+            int mid = (lo + hi)/2;
+            if(states[mid].cn < cn) lo = mid + 1;
+            else hi = mid;
+        }
+        return states.inrange(lo) && states[lo].cn == cn ? &states[lo] : NULL;
+    }
+
+    void set(const posstate &s)
+    {
+        int lo = 0, hi = states.length();
+        while(lo < hi)
+        {
+            int mid = (lo + hi)/2;
+            if(states[mid].cn < s.cn) lo = mid + 1;
+            else hi = mid;
+        }
+        if(states.inrange(lo) && states[lo].cn == s.cn) states[lo] = s;
+        else states.insert(lo, s);
+    }
+};
+
+// latest state of one entity in this update, input to posdeltasender::write
+struct posupdate
+{
+    posstate state;
+    int owner;      // client that sends this entity's positions (itself, or the owner of a bot)
+    bool fresh;     // an N_POS arrived for it since the last update
+    int interval;   // ms between sends to the current receiver, 0 = every update
+};
+
+static inline bool posupdatecmp(const posupdate &a, const posupdate &b) { return a.state.cn < b.state.cn; }
+
+// server side, one per receiving client
+struct posdeltasender
+{
+    possnapshot history[POSDELTA_HISTORY];
+    int seq, ack;
+    vector<int> refreshed;  // by cn, totalmillis the entity was last sent
+
+    posdeltasender() { reset(); }
+
+    void reset()
+    {
+        seq = 1;
+        ack = -1;
+        loopi(POSDELTA_HISTORY) { history[i].seq = -1; history[i].states.setsize(0); }
+        refreshed.setsize(0);
+    }
+
+    possnapshot *snapshot(int n)
+    {
+        if(n <= 0 || n >= seq || seq - n >= POSDELTA_HISTORY) return NULL;
+        possnapshot &s = history[n%POSDELTA_HISTORY];
+        return s.seq == n ? &s : NULL;
+    }
+
+    void acknowledge(int n)
+    {
+        if(n > ack && snapshot(n)) ack = n;
+    }
+
+    // updates must be sorted by cn; entities owned by the receiver are skipped, entities
+    // the receiver already knows are held back until their interval has passed
+    // returns false and writes nothing if the client is already up to date
+    bool write(vector<uchar> &p, const vector<posupdate> &updates, int receiver, int millis)
+    {
+        static const posstate none;
+        possnapshot *base = snapshot(ack), *last = snapshot(seq-1);
+        possnapshot &next = history[seq%POSDELTA_HISTORY];
+        int start = p.length(), prevcn = -1;
+        putint(p, N_POSDELTA);
+        putuint(p, seq);
+        putuint(p, base ? seq - base->seq : 0);
+        if(base) next.states = base->states;
+        else next.states.setsize(0);
+        loopv(updates)
+        {
+            const posupdate &u = updates[i];
+            if(u.owner == receiver) continue;
+            const posstate &s = u.state;
+            posstate *b = base ? base->find(s.cn) : NULL, *l = last ? last->find(s.cn) : NULL;
+            while(refreshed.length() <= s.cn) refreshed.add(millis - POSDELTA_REFRESH);
+            if(b && *b == s && l && *l == s && (!u.fresh || millis - refreshed[s.cn] < POSDELTA_REFRESH)) continue;
+            if(b && u.interval > 0 && millis - refreshed[s.cn] < u.interval) continue;
+            putuint(p, s.cn - prevcn);
+            s.putdelta(p, b ? *b : none);
+            next.set(s);
+            refreshed[s.cn] = millis;
+            prevcn = s.cn;
+        }
+        if(prevcn < 0)
+        {
+            p.setsize(start);
+            next.seq = -1;
+            return false;
+        }
+        putuint(p, 0);
+        next.seq = seq++;
+        return true;
+    }
+};
+
+// client side
+struct posdeltareceiver
+{
+    possnapshot history[POSDELTA_HISTORY];
+    int latest;     // newest snapshot received, to be acknowledged
+
+    posdeltareceiver() { reset(); }
+
+    void reset()
+    {
+        latest = -1;
+        loopi(POSDELTA_HISTORY) { history[i].seq = -1; history[i].states.setsize(0); }
+    }
+
+    // reads a snapshot after the N_POSDELTA token and appends the entities it carries
+    // to out as plain N_POS messages; false if its baseline is no longer known, in which
+    // case it is consumed but not applied or acknowledged
+    template<class T>
+    bool read(ucharbuf &p, T &out)
+    {
+        static const posstate none;
+        int seq = getuint(p), baseoffset = getuint(p);
+        possnapshot *base = NULL;
+        if(baseoffset > 0 && baseoffset < POSDELTA_HISTORY && seq - baseoffset > 0)
+        {
+            possnapshot &b = history[(seq - baseoffset)%POSDELTA_HISTORY];
+            if(b.seq == seq - baseoffset) base = &b;
+        }
+        bool valid = seq > 0 && (baseoffset == 0 || base);
+        possnapshot &next = history[seq%POSDELTA_HISTORY];
+        if(valid)
+        {
+            if(base) next.states = base->states;
+            else next.states.setsize(0);
+        }
+        for(int cn = -1;;)
+        {
+            int offset = getuint(p);
+            if(offset <= 0 || p.overread()) break;
+            cn += offset;
+            posstate *b = base ? base->find(cn) : NULL;
+            posstate s(cn);
+            s.getdelta(p, b ? *b : none);
+            if(!valid) continue;
+            next.set(s);
+            s.put(out);
+        }
+        if(!valid || p.overread()) return false;
+        next.seq = seq;
+        if(seq > latest) latest = seq;
+        return true;
+    }
+};
+
+#endif
@@ -1,4 +1,7 @@
 #include "game.h"
+#include "posdelta.h"
+#include "lagcomp.h"
+#include "demo.h"
 
 namespace game
 {
@@ -15,7 +18,7 @@ namespace game
     const char *gameident() { return "fps"; }
 }
 
-extern ENetAddress masteraddress;
+extern INSTANCELOCAL ENetAddress masteraddress;
 
 namespace server
 {
@@ -205,7 +208,7 @@ namespace server
         }
     };
 
-    extern int gamemillis, nextexceeded;
+    extern INSTANCELOCAL int gamemillis, nextexceeded;
 
     struct clientinfo
     {
@@ -219,7 +222,11 @@ namespace server
         gamestate state;
         vector<gameevent *> events;
         vector<uchar> position, messages;
-        int posoff, poslen, msgoff, msglen;
+        int msgoff, msglen;
+        posstate pos;
+        bool posvalid, posfresh;
+        posdeltasender posdelta;
+        lagcomphistory poshistory;
         vector<clientinfo *> bots;
         uint authreq;
         string authname;
@@ -227,10 +234,11 @@ namespace server
         string clientmap;
         int mapcrc;
         bool warned, gameclip;
-        ENetPacket *getdemo, *getmap, *clipboard;
+        ENetPacket *getmap, *clipboard;
         int lastclipboard, needclipboard;
+        int demoid, demosent, demoacked, demoackmillis;
 
-        clientinfo() : getdemo(NULL), getmap(NULL), clipboard(NULL) { reset(); }
+        clientinfo() : getmap(NULL), clipboard(NULL) { reset(); }
         ~clientinfo() { events.deletecontents(); cleanclipboard(); }
 
         void addevent(gameevent *e)
@@ -293,6 +301,8 @@ namespace server
             mapcrc = 0;
             warned = false;
             gameclip = false;
+            posvalid = posfresh = false;
+            poshistory.reset();
         }
 
         void reassign()
@@ -318,6 +328,8 @@ namespace server
             authreq = 0;
             position.setsize(0);
             messages.setsize(0);
+            posdelta.reset();
+            demoid = demosent = demoacked = demoackmillis = 0;
             ping = 0;
             aireinit = 0;
             needclipboard = 0;
@@ -351,6 +363,7 @@ namespace server
 
     namespace aiman
     {
+        extern void init();
         extern void removeai(clientinfo *ci);
         extern void clearai();
         extern void checkai();
@@ -369,53 +382,65 @@ namespace server
     #define MM_PUBSERV ((1<<MM_OPEN) | (1<<MM_VETO))
     #define MM_COOPSERV (MM_AUTOAPPROVE | MM_PUBSERV | (1<<MM_LOCKED))
 
-    bool notgotitems = true;        // true when map has changed and waiting for clients to send item
-    int gamemode = 0;
-    int gamemillis = 0, gamelimit = 0, nextexceeded = 0;
-    bool gamepaused = false;
-
-    string smapname = "";
-    int interm = 0;
-    bool mapreload = false;
-    enet_uint32 lastsend = 0;
-    int mastermode = MM_OPEN, mastermask = MM_PRIVSERV;
-    int currentmaster = -1;
-    stream *mapdata = NULL;
-
-    vector<uint> allowedips;
-    vector<ban> bannedips;
-    vector<clientinfo *> connects, clients, bots;
-    vector<worldstate *> worldstates;
-    bool reliablemessages = false;
-
+    INSTANCELOCAL bool notgotitems = true;        // true when map has changed and waiting for clients to send item
+    INSTANCELOCAL int gamemode = 0;
+    INSTANCELOCAL int gamemillis = 0, gamelimit = 0, nextexceeded = 0;
+    INSTANCELOCAL bool gamepaused = false;
+
+    INSTANCELOCAL string smapname = "";
+    INSTANCELOCAL int interm = 0;
+    INSTANCELOCAL bool mapreload = false;
+    INSTANCELOCAL enet_uint32 lastsend = 0;
+    INSTANCELOCAL int mastermode = MM_OPEN, mastermask = MM_PRIVSERV;
+    INSTANCELOCAL int currentmaster = -1;
+    INSTANCELOCAL stream *mapdata = NULL;
+
+    INSTANCELOCAL vector<uint> allowedips;
+    INSTANCELOCAL vector<ban> bannedips;
+    INSTANCELOCAL vector<clientinfo *> connects, clients, bots;
+    INSTANCELOCAL vector<worldstate *> worldstates, freeworldstates;
+    INSTANCELOCAL bool reliablemessages = false;
+
+    // finished demos stay in the temporary file they were recorded to rather than in memory
     struct demofile
     {
-        string info;
-        uchar *data;
-        int len;
+        string info, tmpname;
+        stream *file;
+        int id, len;
     };
 
-    vector<demofile> demos;
-
-    bool demonextmatch = false;
-    stream *demotmp = NULL, *demorecord = NULL, *demoplayback = NULL;
-    int nextplayback = 0, demomillis = 0;
-
-    VAR(maxdemos, 0, 5, 25);
-    VAR(maxdemosize, 0, 16, 64);
+    INSTANCELOCAL vector<demofile> demos;
+
+    INSTANCELOCAL bool demonextmatch = false;
+    INSTANCELOCAL stream *demotmp = NULL;
+    INSTANCELOCAL string demotmpname = "";
+    INSTANCELOCAL demowriter *demorecord = NULL;
+    INSTANCELOCAL demoreader *demoplayback = NULL;
+    INSTANCELOCAL int nextplayback = 0, nextchan = 0, nextlen = 0, demomillis = 0, nextdemoid = 0;
+    INSTANCELOCAL uchar *nextdata = NULL;
+
+    VAR(maxdemos, 0, 5, 100);
+    VAR(maxdemosize, 0, 16, 256);
+    VAR(demowindow, 1, 64, 1024); // KB of a demo download that may be in flight unacknowledged
+    VAR(demotimeout, 0, 60, 3600); // seconds a demo download may go unacknowledged before it is dropped, 0 waits forever
+    VAR(demokeyframe, 5, 30, 600); // seconds between full state keyframes in recorded demos
     VAR(restrictdemos, 0, 1, 1);
 
     SVAR(serverdesc, "");
     SVAR(serverpass, "");
     SVAR(adminpass, "");
-    VARF(publicserver, 0, 0, 2, {
+    void updatemastermask();
+    VARF(publicserver, 0, 0, 2, updatemastermask());
+
+    void updatemastermask()
+    {
 		switch(publicserver)
 		{
 			case 0: default: mastermask = MM_PRIVSERV; break;
 			case 1: mastermask = MM_PUBSERV; break;
 			case 2: mastermask = MM_COOPSERV; break;
 		}
-	});
+    }
     SVAR(servermotd, "");
 
     void *newclientinfo() { return new clientinfo; }
@@ -428,14 +453,14 @@ namespace server
         return bots.inrange(n) ? bots[n] : NULL;
     }
 
-    uint mcrc = 0;
-    vector<entity> ments;
-    vector<server_entity> sents;
-    vector<savedscore> scores;
+    INSTANCELOCAL uint mcrc = 0;
+    INSTANCELOCAL vector<entity> ments;
+    INSTANCELOCAL vector<server_entity> sents;
+    INSTANCELOCAL vector<savedscore> scores;
 
     int msgsizelookup(int msg)
     {
-        static int sizetable[NUMSV] = { -1 };
+        static INSTANCELOCAL int sizetable[NUMSV] = { -1 };
         if(sizetable[0] < 0)
         {
             memset(sizetable, -1, sizeof(sizetable));
@@ -487,10 +512,17 @@ namespace server
         return false;
     }
 
+    void cleanupdemos();
+
     void serverinit()
     {
         smapname[0] = '\0';
         resetitems();
+        updatemastermask();
+        aiman::init();
+#ifdef WIN32
+        atexit(cleanupdemos);
+#endif
     }
 
     int numclients(int exclude = -1, bool nospec = true, bool noai = true, bool priv = false)
@@ -515,8 +547,8 @@ namespace server
     {
         if(!name) name = ci->name;
         if(name[0] && !duplicatename(ci, name) && ci->state.aitype == AI_NONE) return name;
-        static string cname[3];
-        static int cidx = 0;
+        static INSTANCELOCAL string cname[3];
+        static INSTANCELOCAL int cidx = 0;
         cidx = (cidx+1)%3;
         formatstring(cname[cidx])(ci->state.aitype == AI_NONE ? "%s \fs\f5(%d)\fr" : "%s \fs\f5[%d]\fr", name, ci->clientnum);
         return cname[cidx];
@@ -557,10 +589,10 @@ namespace server
     #include "ctf.h"
     #include "collect.h"
 
-    captureservmode capturemode;
-    ctfservmode ctfmode;
-    collectservmode collectmode;
-    servmode *smode = NULL;
+    INSTANCELOCAL captureservmode capturemode;
+    INSTANCELOCAL ctfservmode ctfmode;
+    INSTANCELOCAL collectservmode collectmode;
+    INSTANCELOCAL servmode *smode = NULL;
 
     bool canspawnitem(int type) { return !m_noitems && (type>=I_SHELLS && type<=I_QUAD && (!m_noammo || type<I_SHELLS || type>I_CARTRIDGES)); }
 
@@ -705,40 +737,50 @@ namespace server
         return worst->name;
     }
 
+    // tmpfile() files vanish once closed, but on Windows opentempfile() creates a named file that stays behind
+    void closedemofile(stream *&file, const char *tmpname)
+    {
+        DELETEP(file);
+#ifdef WIN32
+        if(tmpname[0]) remove(findfile(tmpname, "rb"));
+#endif
+    }
+
     void prunedemos(int extra = 0)
     {
         int n = clamp(demos.length() + extra - maxdemos, 0, demos.length());
         if(n <= 0) return;
-        loopi(n) delete[] demos[n].data;
+        loopi(n) closedemofile(demos[i].file, demos[i].tmpname);
         demos.remove(0, n);
     }
  
     void adddemo()
     {
         if(!demotmp) return;
-        int len = (int)min(demotmp->size(), stream::offset((maxdemosize<<20) + 0x10000));
+        int len = (int)demotmp->size();
         demofile &d = demos.add();
+        d.id = ++nextdemoid;
         time_t t = time(NULL);
         char *timestr = ctime(&t), *trim = timestr + strlen(timestr);
         while(trim>timestr && iscubespace(*--trim)) *trim = '\0';
         formatstring(d.info)("%s: %s, %s, %.2f%s", timestr, modename(gamemode), smapname, len > 1024*1024 ? len/(1024*1024.f) : len/1024.0f, len > 1024*1024 ? "MB" : "kB");
         defformatstring(msg)("demo \"%s\" recorded", d.info);
         sendservmsg(msg);
-        d.data = new uchar[len];
+        d.file = demotmp;
+        copystring(d.tmpname, demotmpname);
         d.len = len;
-        demotmp->seek(0, SEEK_SET);
-        demotmp->read(d.data, len);
-        DELETEP(demotmp);
+        demotmp = NULL;
     }
         
     void enddemorecord()
     {
         if(!demorecord) return;
 
+        demorecord->finish();
         DELETEP(demorecord);
 
         if(!demotmp) return;
-        if(!maxdemos || !maxdemosize) { DELETEP(demotmp); return; }
+        if(!maxdemos || !maxdemosize) { closedemofile(demotmp, demotmpname); return; }
 
         prunedemos(1);
         adddemo();
@@ -747,11 +789,8 @@ namespace server
     void writedemo(int chan, void *data, int len)
     {
         if(!demorecord) return;
-        int stamp[3] = { gamemillis, chan, len };
-        lilswap(stamp, 3);
-        demorecord->write(stamp, sizeof(stamp));
-        demorecord->write(data, len);
-        if(demorecord->rawtell() >= (maxdemosize<<20)) enddemorecord();
+        demorecord->addrecord(gamemillis, chan, data, len);
+        if(demorecord->size() >= (maxdemosize<<20)) enddemorecord();
     }
 
     void recordpacket(int chan, void *data, int len)
@@ -762,30 +801,40 @@ namespace server
     int welcomepacket(packetbuf &p, clientinfo *ci);
     void sendwelcome(clientinfo *ci);
 
+    void writedemokeyframe()
+    {
+        packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
+        int chan = welcomepacket(p, NULL);
+        demorecord->addkeyframe(gamemillis, chan, p.buf, p.len);
+    }
+
     void setupdemorecord()
     {
         if(!m_mp(gamemode) || m_edit) return;
 
-        demotmp = opentempfile("demorecord", "w+b");
+        if(!nextdemoid) nextdemoid = rnd(0x10000)<<8; // ids from a restarted server should not match a download in progress
+        formatstring(demotmpname)("demorecord%d", nextdemoid+1);
+        demotmp = opentempfile(demotmpname, "w+b");
         if(!demotmp) return;
 
-        stream *f = opengzfile(NULL, "wb", demotmp);
-        if(!f) { DELETEP(demotmp); return; }
-
         sendservmsg("recording demo");
 
-        demorecord = f;
-
         demoheader hdr;
         memcpy(hdr.magic, DEMO_MAGIC, sizeof(hdr.magic));
         hdr.version = DEMO_VERSION;
         hdr.protocol = PROTOCOL_VERSION;
         lilswap(&hdr.version, 2);
-        demorecord->write(&hdr, sizeof(demoheader));
+        demotmp->write(&hdr, sizeof(demoheader));
 
-        packetbuf p(MAXTRANS, ENET_PACKET_FLAG_RELIABLE);
-        welcomepacket(p, NULL);
-        writedemo(1, p.buf, p.len);
+        demorecord = new demowriter(demotmp);
+        writedemokeyframe();
+    }
+
+    // starts a new chunk once the current one spans demokeyframe seconds, called between ticks
+    // so that the keyframe catches the game state whole
+    void checkdemokeyframe()
+    {
+        if(demorecord && gamemillis - demorecord->chunkmillis >= demokeyframe*1000) writedemokeyframe();
     }
 
     void listdemos(int cn)
@@ -801,19 +850,28 @@ namespace server
     {
         if(!n)
         {
-            loopv(demos) delete[] demos[i].data;
+            loopv(demos) closedemofile(demos[i].file, demos[i].tmpname);
             demos.shrink(0);
             sendservmsg("cleared all demos");
         }
         else if(demos.inrange(n-1))
         {
-            delete[] demos[n-1].data;
+            closedemofile(demos[n-1].file, demos[n-1].tmpname);
             demos.remove(n-1);
             defformatstring(msg)("cleared demo %d", n);
             sendservmsg(msg);
         }
     }
 
+    // drops the demo being recorded and the finished ones along with their temporary files
+    void cleanupdemos()
+    {
+        DELETEP(demorecord);
+        closedemofile(demotmp, demotmpname);
+        loopv(demos) closedemofile(demos[i].file, demos[i].tmpname);
+        demos.shrink(0);
+    }
+
     static void freegetmap(ENetPacket *packet)
     {
         loopv(clients)
@@ -823,23 +881,67 @@ namespace server
         }
     }
 
-    static void freegetdemo(ENetPacket *packet)
+    demofile *finddemo(int id)
     {
-        loopv(clients)
-        {
-            clientinfo *ci = clients[i];
-            if(ci->getdemo == packet) ci->getdemo = NULL;
-        }
+        loopv(demos) if(demos[i].id == id) return &demos[i];
+        return NULL;
+    }
+
+    // demos go out as N_DEMODATA pieces on the file channel with no more than demowindow KB unacknowledged,
+    // so a download neither sits in memory whole nor holds up the channel; a client resumes an interrupted
+    // download by acknowledging what it already has. A new request replaces the download in progress,
+    // so one the client gave up on cannot block it.
+    void startdemo(clientinfo *ci, int id, int offset)
+    {
+        demofile *d = finddemo(id);
+        if(!d || offset < 0 || offset > d->len) return;
+        ci->demoid = id;
+        ci->demosent = ci->demoacked = offset;
+        ci->demoackmillis = totalmillis;
     }
 
     void senddemo(clientinfo *ci, int num)
     {
-        if(ci->getdemo) return;
         if(!num) num = demos.length();
         if(!demos.inrange(num-1)) return;
-        demofile &d = demos[num-1];
-        if((ci->getdemo = sendf(ci->clientnum, 2, "rim", N_SENDDEMO, d.len, d.data)))
-            ci->getdemo->freeCallback = freegetdemo;
+        startdemo(ci, demos[num-1].id, 0);
+    }
+
+    void ackdemo(clientinfo *ci, int id, int offset)
+    {
+        if(ci->demoid != id) startdemo(ci, id, offset);
+        else if(offset > ci->demoacked && offset <= ci->demosent)
+        {
+            ci->demoacked = offset;
+            ci->demoackmillis = totalmillis;
+        }
+    }
+
+    #define DEMOPIECE 4096
+
+    void senddemodata(clientinfo *ci)
+    {
+        demofile *d = finddemo(ci->demoid);
+        if(!d) { ci->demoid = 0; return; }
+        if(ci->demoacked >= d->len) { ci->demoid = 0; return; }
+        if(demotimeout && totalmillis - ci->demoackmillis > demotimeout*1000)
+        {
+            ci->demoid = 0;
+            sendf(ci->clientnum, 1, "ris", N_SERVMSG, "demo download stalled, use resumedemo or getdemo to try again");
+            return;
+        }
+        while(ci->demosent < d->len && ci->demosent - ci->demoacked < demowindow<<10)
+        {
+            int len = min(d->len - ci->demosent, DEMOPIECE);
+            packetbuf p(DEMOPIECE + 32, ENET_PACKET_FLAG_RELIABLE);
+            putint(p, N_DEMODATA);
+            putint(p, d->id);
+            putint(p, ci->demosent);
+            putint(p, d->len);
+            if(!d->file->seek(ci->demosent, SEEK_SET) || d->file->read(p.subbuf(len).buf, len) != len) { ci->demoid = 0; return; }
+            sendpacket(ci->clientnum, 2, p.finalize());
+            ci->demosent += len;
+        }
     }
 
     void enddemoplayback()
@@ -854,6 +956,21 @@ namespace server
         loopv(clients) sendwelcome(clients[i]);
     }
 
+    bool nextdemorecord()
+    {
+        if(demoplayback->next(nextplayback, nextchan, nextlen, nextdata)) return true;
+        enddemoplayback();
+        return false;
+    }
+
+    void senddemorecord(int cn, int chan, uchar *data, int len)
+    {
+        ENetPacket *packet = enet_packet_create(data, len, 0);
+        if(!packet) return;
+        sendpacket(cn, chan, packet);
+        if(!packet->referenceCount) enet_packet_destroy(packet);
+    }
+
     void setupdemoplayback()
     {
         if(demoplayback) return;
@@ -861,15 +978,16 @@ namespace server
         string msg;
         msg[0] = '\0';
         defformatstring(file)("%s.dmo", smapname);
-        demoplayback = opengzfile(file, "rb");
-        if(!demoplayback) formatstring(msg)("could not read demo \"%s\"", file);
-        else if(demoplayback->read(&hdr, sizeof(demoheader))!=sizeof(demoheader) || memcmp(hdr.magic, DEMO_MAGIC, sizeof(hdr.magic)))
-            formatstring(msg)("\"%s\" is not a demo file", file);
+        demoplayback = new demoreader;
+        if(!demoplayback->open(file, hdr))
+        {
+            if(!demoplayback->file) formatstring(msg)("could not read demo \"%s\"", file);
+            else formatstring(msg)("\"%s\" is not a demo file", file);
+        }
         else
         {
-            lilswap(&hdr.version, 2);
-            if(hdr.version!=DEMO_VERSION) formatstring(msg)("demo \"%s\" requires an %s version of Cube 2: Sauerbraten", file, hdr.version<DEMO_VERSION ? "older" : "newer");
-            else if(hdr.protocol!=PROTOCOL_VERSION) formatstring(msg)("demo \"%s\" requires an %s version of Cube 2: Sauerbraten", file, hdr.protocol<PROTOCOL_VERSION ? "older" : "newer");
+            if(hdr.version!=DEMO_VERSION && hdr.version!=DEMO_GZVERSION) formatstring(msg)("demo \"%s\" requires an %s version of Cube 2: Sauerbraten", file, hdr.version<DEMO_VERSION ? "older" : "newer");
+            else if(hdr.protocol<DEMO_MINPROTOCOL || hdr.protocol>PROTOCOL_VERSION) formatstring(msg)("demo \"%s\" requires an %s version of Cube 2: Sauerbraten", file, hdr.protocol<DEMO_MINPROTOCOL ? "older" : "newer");
         }
         if(msg[0])
         {
@@ -884,12 +1002,18 @@ namespace server
         demomillis = 0;
         sendf(-1, 1, "ri3", N_DEMOPLAYBACK, 1, -1);
 
-        if(demoplayback->read(&nextplayback, sizeof(nextplayback))!=sizeof(nextplayback))
-        {
-            enddemoplayback();
-            return;
-        }
-        lilswap(&nextplayback, 1);
+        nextdemorecord();
+    }
+
+    // catches a client that joins during playback up from the keyframe of the current chunk,
+    // older demos have no keyframes and start over for everyone instead
+    void joindemoplayback(clientinfo *ci)
+    {
+        sendf(ci->clientnum, 1, "ri3", N_DEMOPLAYBACK, 1, -1);
+        int millis, chan, len;
+        uchar *data;
+        for(int pos = 0; pos < demoplayback->last && demoplayback->parse(pos, millis, chan, len, data);)
+            senddemorecord(ci->clientnum, chan, data, len);
     }
 
     void readdemo()
@@ -898,34 +1022,29 @@ namespace server
         demomillis += curtime;
         while(demomillis>=nextplayback)
         {
-            int chan, len;
-            if(demoplayback->read(&chan, sizeof(chan))!=sizeof(chan) ||
-               demoplayback->read(&len, sizeof(len))!=sizeof(len))
-            {
-                enddemoplayback();
-                return;
-            }
-            lilswap(&chan, 1);
-            lilswap(&len, 1);
-            ENetPacket *packet = enet_packet_create(NULL, len, 0);
-            if(!packet || demoplayback->read(packet->data, len)!=len)
-            {
-                if(packet) enet_packet_destroy(packet);
-                enddemoplayback();
-                return;
-            }
-            sendpacket(-1, chan, packet);
-            if(!packet->referenceCount) enet_packet_destroy(packet);
-            if(!demoplayback) break;
-            if(demoplayback->read(&nextplayback, sizeof(nextplayback))!=sizeof(nextplayback))
-            {
-                enddemoplayback();
-                return;
-            }
-            lilswap(&nextplayback, 1);
+            senddemorecord(-1, nextchan, nextdata, nextlen);
+            if(!demoplayback || !nextdemorecord()) break;
         }
     }
 
+    // jumps to millis by playing the keyframe of the chunk it falls in, then every record up to it at once
+    void seekdemo(int millis)
+    {
+        if(!demoplayback) return;
+        if(!demoplayback->seek(millis))
+        {
+            sendservmsg("demo can not be seeked");
+            return;
+        }
+        while(nextdemorecord() && nextplayback < millis)
+        {
+            senddemorecord(-1, nextchan, nextdata, nextlen);
+            if(!demoplayback) return;
+        }
+        demomillis = max(millis, 0);
+    }
+    ICOMMAND(seekdemo, "i", (int *secs), seekdemo(*secs*1000));
+
     void stopdemo()
     {
         if(m_demo) enddemoplayback();
@@ -1029,7 +1148,7 @@ namespace server
                 {
                     oi->state.timeplayed += lastmillis - oi->state.lasttimeplayed;
                     oi->state.lasttimeplayed = lastmillis;
-                    static savedscore curscore;
+                    static INSTANCELOCAL savedscore curscore;
                     curscore.save(oi->state);
                     return &curscore;
                 }
@@ -1059,52 +1178,75 @@ namespace server
         // only allow edit messages in coop-edit mode
         if(type>=N_EDITENT && type<=N_EDITVAR && !m_edit) return -1;
         // server only messages
-        static const int servtypes[] = { N_SERVINFO, N_INITCLIENT, N_WELCOME, N_MAPRELOAD, N_SERVMSG, N_DAMAGE, N_HITPUSH, N_SHOTFX, N_EXPLODEFX, N_DIED, N_SPAWNSTATE, N_FORCEDEATH, N_ITEMACC, N_ITEMSPAWN, N_TIMEUP, N_CDIS, N_CURRENTMASTER, N_PONG, N_RESUME, N_BASESCORE, N_BASEINFO, N_BASEREGEN, N_ANNOUNCE, N_SENDDEMOLIST, N_SENDDEMO, N_DEMOPLAYBACK, N_SENDMAP, N_DROPFLAG, N_SCOREFLAG, N_RETURNFLAG, N_RESETFLAG, N_INVISFLAG, N_CLIENT, N_AUTHCHAL, N_INITAI, N_EXPIRETOKENS, N_DROPTOKENS };
+        static const int servtypes[] = { N_SERVINFO, N_INITCLIENT, N_WELCOME, N_MAPRELOAD, N_SERVMSG, N_DAMAGE, N_HITPUSH, N_SHOTFX, N_EXPLODEFX, N_DIED, N_SPAWNSTATE, N_FORCEDEATH, N_ITEMACC, N_ITEMSPAWN, N_TIMEUP, N_CDIS, N_CURRENTMASTER, N_PONG, N_RESUME, N_BASESCORE, N_BASEINFO, N_BASEREGEN, N_ANNOUNCE, N_SENDDEMOLIST, N_SENDDEMO, N_DEMOPLAYBACK, N_SENDMAP, N_DROPFLAG, N_SCOREFLAG, N_RETURNFLAG, N_RESETFLAG, N_INVISFLAG, N_CLIENT, N_AUTHCHAL, N_INITAI, N_EXPIRETOKENS, N_DROPTOKENS, N_POSDELTA, N_DEMODATA };
         if(ci) 
         {
             loopi(sizeof(servtypes)/sizeof(int)) if(type == servtypes[i]) return -1;
             if(type < N_EDITENT || type > N_EDITVAR || !m_edit) 
             {
-                if(type != N_POS && ++ci->overflow >= 200) return -2;
+                if(type != N_POS && type != N_POSACK && type != N_DEMOACK && ++ci->overflow >= 200) return -2;
             }
         }
         return type;
     }
 
+    // world states are reused with their buffers so building one every tick does not allocate
+    worldstate *newworldstate()
+    {
+        if(freeworldstates.empty()) return new worldstate;
+        worldstate *ws = freeworldstates.pop();
+        ws->positions.setsize(0);
+        ws->messages.setsize(0);
+        return ws;
+    }
+
+    void freeworldstate(worldstate *ws)
+    {
+        if(freeworldstates.length() < 4) freeworldstates.add(ws);
+        else delete ws;
+    }
+
     void cleanworldstate(ENetPacket *packet)
     {
         loopv(worldstates)
         {
             worldstate *ws = worldstates[i];
-            if(ws->positions.inbuf(packet->data) || ws->messages.inbuf(packet->data)) ws->uses--;
+            if(ws->messages.inbuf(packet->data)) ws->uses--;
             else continue;
             if(!ws->uses)
             {
-                delete ws;
+                freeworldstate(ws);
                 worldstates.remove(i);
             }
             break;
         }
     }
 
+    // takes the pending N_POS as the client's latest state for the delta snapshots
+    void parseclientposition(clientinfo &ci)
+    {
+        ucharbuf p(ci.position.getbuf(), ci.position.length());
+        getint(p);
+        ci.posvalid = ci.pos.parse(p);
+        ci.posfresh = true;
+        ci.position.setsize(0);
+    }
+
     void flushclientposition(clientinfo &ci)
     {
         if(ci.position.empty() || (!hasnonlocalclients() && !demorecord)) return;
         packetbuf p(ci.position.length(), 0);
         p.put(ci.position.getbuf(), ci.position.length());
-        ci.position.setsize(0);
+        parseclientposition(ci);
         sendpacket(-1, 0, p.finalize(), ci.ownernum);
     }
 
     void addclientstate(worldstate &ws, clientinfo &ci)
     {
-        if(ci.position.empty()) ci.posoff = -1;
-        else
+        if(!ci.position.empty())
         {
-            ci.posoff = ws.positions.length();
             ws.positions.put(ci.position.getbuf(), ci.position.length());
-            ci.poslen = ws.positions.length() - ci.posoff;
-            ci.position.setsize(0);
+            parseclientposition(ci);
         }
         if(ci.messages.empty()) ci.msgoff = -1;
         else
@@ -1119,9 +1261,66 @@ namespace server
         }
     }
 
+    VAR(aoirange, 0, 768, 0x10000);    // distance beyond which players are sent less often, 0 sends everyone at full rate
+    VAR(aoirate, 33, 200, 500);         // ms between updates of players at twice aoirange or more, below the client's lag timeout
+
+    // how often a receiver at r needs the position of an entity at s: every update up close,
+    // falling off linearly to aoirate between aoirange and twice that distance
+    int aoiinterval(const posstate &r, const posstate &s)
+    {
+        if(!aoirange) return 0;
+        float dist = vec(s.o[0] - r.o[0], s.o[1] - r.o[1], s.o[2] - r.o[2]).magnitude()/DMF;
+        if(dist <= aoirange) return 0;
+        return int(min(dist/aoirange - 1, 1.0f)*aoirate);
+    }
+
+    INSTANCELOCAL vector<posupdate> posupdates;
+    INSTANCELOCAL vector<uchar> posdeltabuf;
+
+    bool sendposdeltas()
+    {
+        posupdates.setsize(0);
+        loopv(clients)
+        {
+            clientinfo &ci = *clients[i];
+            if(!ci.posvalid) continue;
+            posupdate &u = posupdates.add();
+            u.state = ci.pos;
+            u.owner = ci.ownernum;
+            u.fresh = ci.posfresh;
+            u.interval = 0;
+            ci.posfresh = false;
+        }
+        posupdates.sort(posupdatecmp);
+        bool sent = false;
+        loopv(clients)
+        {
+            clientinfo &ci = *clients[i];
+            if(ci.state.aitype != AI_NONE) continue;
+            // spectators may be following anyone, and the ai of team modes tracks teammates wherever they are
+            bool filter = ci.posvalid && ci.state.state!=CS_SPECTATOR;
+            loopvj(posupdates)
+            {
+                posupdate &u = posupdates[j];
+                clientinfo *e = filter ? getinfo(u.state.cn) : NULL;
+                if(!e || isteam(e->team, ci.team)) { u.interval = 0; continue; }
+                // bots run by the receiver see with its positions, so the nearest of them counts
+                u.interval = aoiinterval(ci.pos, u.state);
+                loopvk(ci.bots) if(ci.bots[k]->posvalid) u.interval = min(u.interval, aoiinterval(ci.bots[k]->pos, u.state));
+            }
+            posdeltabuf.setsize(0);
+            if(!ci.posdelta.write(posdeltabuf, posupdates, ci.clientnum, totalmillis)) continue;
+            ENetPacket *packet = enet_packet_create(posdeltabuf.getbuf(), posdeltabuf.length(), 0);
+            sendpacket(ci.clientnum, 0, packet);
+            if(!packet->referenceCount) enet_packet_destroy(packet);
+            else sent = true;
+        }
+        return sent;
+    }
+
     bool buildworldstate()
     {
-        worldstate &ws = *new worldstate;
+        worldstate &ws = *newworldstate();
         loopv(clients)
         {
             clientinfo &ci = *clients[i];
@@ -1132,11 +1331,6 @@ namespace server
             {
                 clientinfo &bi = *ci.bots[i];
                 addclientstate(ws, bi);
-                if(bi.posoff >= 0)
-                {
-                    if(ci.posoff < 0) { ci.posoff = bi.posoff; ci.poslen = bi.poslen; }
-                    else ci.poslen += bi.poslen;
-                }
                 if(bi.msgoff >= 0)
                 {
                     if(ci.msgoff < 0) { ci.msgoff = bi.msgoff; ci.msglen = bi.msglen; }
@@ -1144,14 +1338,9 @@ namespace server
                 }
             }
         }
+        // demos keep the plain N_POS updates, clients get delta snapshots
         int psize = ws.positions.length(), msize = ws.messages.length();
-        if(psize)
-        {
-            recordpacket(0, ws.positions.getbuf(), psize);
-            ucharbuf p = ws.positions.reserve(psize);
-            p.put(ws.positions.getbuf(), psize);
-            ws.positions.addbuf(p);
-        }
+        if(psize) recordpacket(0, ws.positions.getbuf(), psize);
         if(msize)
         {
             recordpacket(1, ws.messages.getbuf(), msize);
@@ -1160,26 +1349,16 @@ namespace server
             ws.messages.addbuf(p);
         }
         ws.uses = 0;
-        if(psize || msize) loopv(clients)
+        bool sentpositions = sendposdeltas();
+        if(msize) loopv(clients)
         {
             clientinfo &ci = *clients[i];
             if(ci.state.aitype != AI_NONE) continue;
-            ENetPacket *packet;
-            if(psize && (ci.posoff<0 || psize-ci.poslen>0))
+            if(ci.msgoff<0 || msize-ci.msglen>0)
             {
-                packet = enet_packet_create(&ws.positions[ci.posoff<0 ? 0 : ci.posoff+ci.poslen],
-                                            ci.posoff<0 ? psize : psize-ci.poslen,
-                                            ENET_PACKET_FLAG_NO_ALLOCATE);
-                sendpacket(ci.clientnum, 0, packet);
-                if(!packet->referenceCount) enet_packet_destroy(packet);
-                else { ++ws.uses; packet->freeCallback = cleanworldstate; }
-            }
-
-            if(msize && (ci.msgoff<0 || msize-ci.msglen>0))
-            {
-                packet = enet_packet_create(&ws.messages[ci.msgoff<0 ? 0 : ci.msgoff+ci.msglen],
-                                            ci.msgoff<0 ? msize : msize-ci.msglen,
-                                            (reliablemessages ? ENET_PACKET_FLAG_RELIABLE : 0) | ENET_PACKET_FLAG_NO_ALLOCATE);
+                ENetPacket *packet = enet_packet_create(&ws.messages[ci.msgoff<0 ? 0 : ci.msgoff+ci.msglen],
+                                                        ci.msgoff<0 ? msize : msize-ci.msglen,
+                                                        (reliablemessages ? ENET_PACKET_FLAG_RELIABLE : 0) | ENET_PACKET_FLAG_NO_ALLOCATE);
                 sendpacket(ci.clientnum, 1, packet);
                 if(!packet->referenceCount) enet_packet_destroy(packet);
                 else { ++ws.uses; packet->freeCallback = cleanworldstate; }
@@ -1188,8 +1367,8 @@ namespace server
         reliablemessages = false;
         if(!ws.uses)
         {
-            delete &ws;
-            return false;
+            freeworldstate(&ws);
+            return sentpositions;
         }
         else
         {
@@ -1203,11 +1382,244 @@ namespace server
         if(clients.empty() || (!hasnonlocalclients() && !demorecord)) return false;
         enet_uint32 curtime = enet_time_get()-lastsend;
         if(curtime<33 && !force) return false;
-        bool flush = buildworldstate();
+        bool flush;
+        {
+            profiletimer t(PROF_WORLDSTATE);
+            flush = buildworldstate();
+        }
         lastsend += curtime - (curtime%33);
         return flush;
     }
 
+    struct posbenchack
+    {
+        int seq, due;
+    };
+
+    struct posbenchclient
+    {
+        int cn, plainbytes, deltabytes;
+        posdeltasender sender;
+        posdeltareceiver receiver;
+        vector<posbenchack> acks;   // delivered to the sender once due
+    };
+
+    // replays the positions recorded in a demo through the snapshot encoder, treating every
+    // recorded player as a client, and compares the bytes each would receive with delta
+    // snapshots, filtered by aoirange, against the plain N_POS relay; loss is the percentage
+    // of snapshots and acks dropped, ackdelay the round trip in ms before an acknowledgement
+    // reaches the server
+    void posdeltabench(const char *name, int loss, int ackdelay)
+    {
+        defformatstring(file)("%s.dmo", name);
+        demoreader f;
+        demoheader hdr;
+        if(!f.open(file, hdr))
+        {
+            conoutf(CON_ERROR, "could not read demo \"%s\"", file);
+            return;
+        }
+        if(ackdelay <= 0) ackdelay = 100;
+
+        vector<posbenchclient *> bench;
+        vector<posupdate> updates;
+        vector<int> plainsize;
+        vector<uchar> snapshot, decoded;
+        int startmillis = -1, endmillis = 0, snapshots = 0, mismatches = 0;
+        int millis, chan, len;
+        uchar *data;
+        while(f.next(millis, chan, len, data))
+        {
+            if(chan!=0) continue;
+
+            if(startmillis < 0) startmillis = millis;
+            endmillis = millis;
+            loopv(updates) updates[i].fresh = false;
+            loopv(plainsize) plainsize[i] = 0;
+            ucharbuf p(data, len);
+            while(p.remaining() && getint(p) == N_POS)
+            {
+                int start = p.length();
+                posstate s;
+                if(!s.parse(p) || s.cn < 0) break;
+                while(plainsize.length() <= s.cn) plainsize.add(0);
+                plainsize[s.cn] += p.length() - start + 1;
+                posupdate *u = NULL;
+                loopv(updates) if(updates[i].state.cn == s.cn) { u = &updates[i]; break; }
+                if(!u)
+                {
+                    u = &updates.add();
+                    u->owner = s.cn;
+                    posbenchclient *c = new posbenchclient;
+                    c->cn = s.cn;
+                    c->plainbytes = c->deltabytes = 0;
+                    bench.add(c);
+                }
+                u->state = s;
+                u->fresh = true;
+            }
+            updates.sort(posupdatecmp);
+
+            loopv(bench)
+            {
+                posbenchclient &c = *bench[i];
+                loopvj(plainsize) if(j != c.cn) c.plainbytes += plainsize[j];
+                loopvj(c.acks) if(c.acks[j].due <= millis) { c.sender.acknowledge(c.acks[j].seq); c.acks.remove(j--); }
+                const posstate *own = NULL;
+                loopvj(updates) if(updates[j].state.cn == c.cn) { own = &updates[j].state; break; }
+                loopvj(updates) updates[j].interval = own ? aoiinterval(*own, updates[j].state) : 0;
+                snapshot.setsize(0);
+                if(!c.sender.write(snapshot, updates, c.cn, millis)) continue;
+                c.deltabytes += snapshot.length();
+                snapshots++;
+                if(loss > 0 && rnd(100) < loss) continue;
+                ucharbuf q(snapshot.getbuf(), snapshot.length());
+                getint(q);
+                decoded.setsize(0);
+                if(!c.receiver.read(q, decoded)) continue;
+                possnapshot *sent = c.sender.snapshot(c.receiver.latest), &got = c.receiver.history[c.receiver.latest%POSDELTA_HISTORY];
+                if(!sent || sent->states.length() != got.states.length()) mismatches++;
+                else loopvj(got.states) if(got.states[j] != sent->states[j]) { mismatches++; break; }
+                if(loss > 0 && rnd(100) < loss) continue;
+                posbenchack &ack = c.acks.add();
+                ack.seq = c.receiver.latest;
+                ack.due = millis + ackdelay;
+            }
+        }
+
+        float seconds = max(endmillis - startmillis, 1)/1000.0f;
+        double plain = 0, delta = 0;
+        loopv(bench) { plain += bench[i]->plainbytes; delta += bench[i]->deltabytes; }
+        int numclients = max(bench.length(), 1);
+        conoutf("%s: %d clients, %.1f seconds, %d snapshots, %d%% loss, %d ms ack delay, aoirange %d", file, bench.length(), seconds, snapshots, loss, ackdelay, aoirange);
+        conoutf("plain N_POS: %.0f bytes/client/sec, delta snapshots: %.0f bytes/client/sec (%.1f%%), %d decode mismatches",
+            plain/numclients/seconds, delta/numclients/seconds, plain > 0 ? 100*delta/plain : 0.0, mismatches);
+        bench.deletecontents();
+    }
+    ICOMMAND(posdeltabench, "sii", (char *name, int *loss, int *ackdelay), posdeltabench(name, *loss, *ackdelay));
+
+    // adds the position and message records of a demo to the samples savenetmodel builds a payload model from
+    void netmodeltrain(const char *name)
+    {
+        defformatstring(file)("%s.dmo", name);
+        demoreader f;
+        demoheader hdr;
+        if(!f.open(file, hdr))
+        {
+            conoutf(CON_ERROR, "could not read demo \"%s\"", file);
+            return;
+        }
+        int millis, chan, len, records = 0;
+        uchar *data;
+        double bytes = 0;
+        while(f.next(millis, chan, len, data)) if(chan < 2)
+        {
+            addnetsample(chan, data, len);
+            records++;
+            bytes += len;
+        }
+        conoutf("%s: sampled %d records, %.0f bytes", file, records, bytes);
+    }
+    COMMAND(netmodeltrain, "s");
+
+    struct netbenchchannel
+    {
+        vector<ENetPacket *> packets;
+        double raw, model, range;
+        int modelmicros, unmodelmicros, rangemicros, unrangemicros, mismatches;
+
+        netbenchchannel() : raw(0), model(0), range(0), modelmicros(0), unmodelmicros(0), rangemicros(0), unrangemicros(0), mismatches(0) {}
+    };
+
+    // replays the position and message records of a demo as packets through the loaded payload model and
+    // through enet's adaptive range coder, comparing the bytes each would send and the time each takes per packet
+    void netmodelbench(const char *name)
+    {
+        if(!netmodelcrc) { conoutf(CON_ERROR, "no net model loaded"); return; }
+        defformatstring(file)("%s.dmo", name);
+        demoreader f;
+        demoheader hdr;
+        if(!f.open(file, hdr))
+        {
+            conoutf(CON_ERROR, "could not read demo \"%s\"", file);
+            return;
+        }
+        netbenchchannel chans[2];
+        int millis, chan, len;
+        uchar *data;
+        while(f.next(millis, chan, len, data)) if(chan < 2 && len > 0)
+        {
+            netbenchchannel &c = chans[chan];
+            c.packets.add(enet_packet_create(data, len, 0));
+            c.raw += len;
+        }
+        void *rangecoder = enet_range_coder_create();
+        vector<ENetPacket *> compressed;
+        vector<uchar> rangeout, rangeback;
+        loopk(2)
+        {
+            netbenchchannel &c = chans[k];
+            llong start = profilemicros();
+            loopv(c.packets) compressed.add(compresspacket(c.packets[i], k));
+            c.modelmicros = int(profilemicros() - start);
+            start = profilemicros();
+            loopv(c.packets)
+            {
+                ENetPacket *raw = decompresspacket(compressed[i], k);
+                if(!raw || raw->dataLength != c.packets[i]->dataLength || memcmp(raw->data, c.packets[i]->data, raw->dataLength)) c.mismatches++;
+                if(raw && raw != compressed[i]) enet_packet_destroy(raw);
+            }
+            c.unmodelmicros = int(profilemicros() - start);
+            loopv(c.packets)
+            {
+                c.model += compressed[i]->dataLength;
+                sentcompressed(compressed[i], c.packets[i]);
+            }
+            compressed.setsize(0);
+
+            vector<int> rangelen;
+            start = profilemicros();
+            loopv(c.packets)
+            {
+                ENetBuffer buf;
+                buf.data = c.packets[i]->data;
+                buf.dataLength = c.packets[i]->dataLength;
+                rangeout.setsize(0);
+                int n = (int)enet_range_coder_compress(rangecoder, &buf, 1, buf.dataLength, rangeout.reserve(buf.dataLength).buf, buf.dataLength);
+                rangelen.add(n);
+                c.range += n > 0 ? n : buf.dataLength;
+                if(n > 0) rangeback.put(rangeout.getbuf(), n);
+            }
+            c.rangemicros = int(profilemicros() - start);
+            start = profilemicros();
+            int offset = 0;
+            loopv(c.packets) if(rangelen[i] > 0)
+            {
+                int len = (int)c.packets[i]->dataLength;
+                rangeout.setsize(0);
+                uchar *out = rangeout.reserve(len).buf;
+                size_t n = enet_range_coder_decompress(rangecoder, &rangeback[offset], rangelen[i], out, len);
+                if(n != size_t(len) || memcmp(out, c.packets[i]->data, len)) c.mismatches++;
+                offset += rangelen[i];
+            }
+            c.unrangemicros = int(profilemicros() - start);
+            rangeback.setsize(0);
+        }
+        enet_range_coder_destroy(rangecoder);
+
+        conoutf("%s: net model %08x", file, netmodelcrc);
+        loopk(2)
+        {
+            netbenchchannel &c = chans[k];
+            int n = max(c.packets.length(), 1);
+            conoutf("channel %d: %d packets, %.1f bytes each, model %.1f%% (%.2f/%.2f us per packet), range coder %.1f%% (%.2f/%.2f us per packet), %d mismatches",
+                k, c.packets.length(), c.raw/n, c.raw > 0 ? 100*c.model/c.raw : 0.0, c.modelmicros/float(n), c.unmodelmicros/float(n),
+                c.raw > 0 ? 100*c.range/c.raw : 0.0, c.rangemicros/float(n), c.unrangemicros/float(n), c.mismatches);
+            loopv(c.packets) enet_packet_destroy(c.packets[i]);
+        }
+    }
+    COMMAND(netmodelbench, "s");
+
     template<class T>
     void sendstate(gamestate &gs, T &p)
     {
@@ -1225,6 +1637,7 @@ namespace server
         gamestate &gs = ci->state;
         gs.spawnstate(gamemode);
         gs.lifesequence = (gs.lifesequence + 1)&0x7F;
+        ci->poshistory.reset();
     }
 
     void sendspawn(clientinfo *ci)
@@ -1419,7 +1832,76 @@ namespace server
         }
         notgotitems = false;
     }
-        
+
+    VAR(servergeom, 0, 0, 1);           // keep the map's collision geometry, shots are then stopped by walls
+
+    INSTANCELOCAL mapgeom *smapgeom = NULL;
+
+    // every instance on the same map shares one copy of its geometry
+    void loadgeometry()
+    {
+        freemapgeom(smapgeom);
+        smapgeom = servergeom && mcrc ? loadmapgeom(smapname, mcrc) : NULL;
+    }
+
+    // half the bench's endpoints are where the map's entities stand, as players' eyes, and half are anywhere
+    // in the world, so a map with only a few entities doesn't end up testing mostly lines from a point to itself
+    static vec mapgeombenchpoint(const vector<vec> &eyes, int worldsize)
+    {
+        if(eyes.length() && rnd(2)) return eyes[rnd(eyes.length())];
+        return vec(rndscale(worldsize), rndscale(worldsize), rndscale(worldsize));
+    }
+
+    // reads a map's geometry and times queries made from points in it: rays in random directions,
+    // lines of sight between two different points and collisions of a player box near one
+    void mapgeombench(const char *name, int numqueries)
+    {
+        if(!name[0]) name = smapname;
+        if(numqueries <= 0) numqueries = 100000;
+        vector<entity> ents;
+        if(!loadents(name, ents)) { conoutf(CON_ERROR, "could not read map %s", name); return; }
+        llong start = profilemicros();
+        bool cached = false;
+        mapgeom *g = loadmapgeom(name, 0, &cached);
+        if(!g) return;
+        // geometry another instance already holds isn't read again, so there is no read time to report
+        string loaded;
+        if(cached) copystring(loaded, "cached");
+        else formatstring(loaded)("read in %.1f ms", (profilemicros() - start)/1000.0);
+        int nodes, leaves, planes, memory, worldsize = mapgeomsize(g);
+        mapgeomstats(g, nodes, leaves, planes, memory);
+        conoutf("mapgeombench: %s, %d nodes, %d partial cubes, %d planes, %.1f KB, %s",
+            name, nodes, leaves, planes, memory/1024.0f, loaded);
+
+        vector<vec> eyes;
+        loopv(ents) eyes.add(vec(ents[i].o).add(vec(0, 0, LAGCOMP_EYEHEIGHT)));
+        vector<vec> from, dirs, to;
+        loopi(numqueries)
+        {
+            vec o = mapgeombenchpoint(eyes, worldsize), dest;
+            do dest = mapgeombenchpoint(eyes, worldsize); while(dest == o);
+            from.add(o);
+            to.add(dest);
+            dirs.add(vec(rnd(360)*RAD, (rnd(180)-90)*RAD));
+        }
+
+        int hits = 0, visible = 0, unstuck = 0;
+        start = profilemicros();
+        loopi(numqueries) if(geomraycast(g, from[i], dirs[i], worldsize) < worldsize) hits++;
+        double raymicros = max(double(profilemicros() - start), 1.0);
+        start = profilemicros();
+        loopi(numqueries) { vec hitpos; if(geomlos(g, from[i], to[i], hitpos)) visible++; }
+        double losmicros = max(double(profilemicros() - start), 1.0);
+        start = profilemicros();
+        loopi(numqueries) if(geomcollide(g, vec(dirs[i]).mul(16).add(from[i]), LAGCOMP_RADIUS, LAGCOMP_EYEHEIGHT, LAGCOMP_ABOVEEYE)) unstuck++;
+        double collidemicros = max(double(profilemicros() - start), 1.0);
+        conoutf("raycast: %.0f ns (%d%% hit), line of sight: %.0f ns (%d%% clear), collide: %.0f ns (%d%% free)",
+            1000*raymicros/numqueries, hits*100/numqueries, 1000*losmicros/numqueries, visible*100/numqueries,
+            1000*collidemicros/numqueries, unstuck*100/numqueries);
+        freemapgeom(g);
+    }
+    ICOMMAND(mapgeombench, "si", (char *name, int *queries), mapgeombench(name, *queries));
+
     void changemap(const char *s, int mode)
     {
         stopdemo();
@@ -1435,6 +1917,7 @@ namespace server
         nextexceeded = 0;
         copystring(smapname, s);
         loaditems();
+        loadgeometry();
         scores.shrink(0);
         loopv(clients)
         {
@@ -1661,6 +2144,93 @@ namespace server
         }
     }
 
+    VAR(lagcomp, 0, 1, 1);
+    VAR(lagcompmax, 0, 300, 1000);      // longest rewind in ms, shooters with more ping are checked against older positions
+    VAR(lagcompslack, 0, 8, 64);        // units a claimed hit may miss the rewound target by, for prediction and muzzle offset
+
+    // whether a target with the given history was where the shooter could hit it, as seen ping ms earlier
+    bool lagcompcheck(const lagcomphistory &history, int ping, const vec &from, const vec &to, int gun, int millis)
+    {
+        vec o, dir = vec(to).sub(from);
+        if(!lagcomp || !history.rewind(millis - clamp(ping, 0, lagcompmax), o)) return true;
+        float dist = dir.magnitude();
+        if(dist <= 0) return false;
+        dir.div(dist);
+        float spread = gun==GUN_SG ? 0.5f*guns[gun].spread/1024 : 0, // shotgun rays scatter as in offsetray()
+              range = guns[gun].range + 1;
+        if(smapgeom) range = min(range, geomraycast(smapgeom, from, dir, range) + lagcompslack); // the shot ends at the first wall
+        return lagcomphit(from, dir, range, o, spread, lagcompslack);
+    }
+
+    struct lagcompbenchshot
+    {
+        int target, ping;
+        vec from, to;
+        bool honest;
+    };
+
+    // moves players around randomly for two seconds, then times the hit check of shots fired at
+    // them with random pings; half the shots aim at where the shooter saw the target and must
+    // pass, the others aim a player width to the side of it and must be rejected
+    void lagcompbench(int players, int numshots)
+    {
+        if(players < 2) players = 32;
+        if(numshots <= 0) numshots = 100000;
+        const int endmillis = 2000;
+        lagcomphistory *histories = new lagcomphistory[players];
+        vector<vec> pos, vel;
+        loopi(players)
+        {
+            pos.add(vec(rndscale(512), rndscale(512), rndscale(64)));
+            vel.add(vec(rnd(360)*RAD, 0).mul(100));
+        }
+        for(int millis = 0; millis <= endmillis; millis += 33) loopi(players)
+        {
+            if(!rnd(30)) vel[i] = vec(rnd(360)*RAD, 0).mul(100);
+            pos[i].add(vec(vel[i]).mul(0.033f));
+            histories[i].add(millis, pos[i]);
+        }
+
+        vector<lagcompbenchshot> shots;
+        loopi(numshots)
+        {
+            int shooter = rnd(players), target = (shooter + 1 + rnd(players-1))%players, ping = rnd(lagcompmax+1);
+            vec seen;
+            if(!histories[target].rewind(endmillis - ping, seen)) continue;
+            lagcompbenchshot &s = shots.add();
+            s.target = target;
+            s.ping = ping;
+            s.honest = (i&1)==0;
+            s.from = vec(pos[shooter]).add(vec(0, 0, LAGCOMP_EYEHEIGHT));
+            vec aim(seen.x + rndscale(4) - 2, seen.y + rndscale(4) - 2, seen.z + rndscale(LAGCOMP_EYEHEIGHT));
+            if(!s.honest)
+            {
+                vec side;
+                side.cross(vec(aim).sub(s.from), vec(0, 0, 1));
+                if(side.iszero()) side = vec(1, 0, 0);
+                aim.add(side.normalize().mul(2*(LAGCOMP_RADIUS + lagcompslack)));
+            }
+            s.to = vec(aim).sub(s.from).normalize().mul(guns[GUN_CG].range).add(s.from);
+        }
+
+        int passed = 0, rejected = 0;
+        llong start = profilemicros();
+        loopv(shots)
+        {
+            const lagcompbenchshot &s = shots[i];
+            bool hit = lagcompcheck(histories[s.target], s.ping, s.from, s.to, GUN_CG, endmillis);
+            if(s.honest) passed += hit ? 1 : 0;
+            else rejected += hit ? 0 : 1;
+        }
+        double micros = max(double(profilemicros() - start), 1.0), perhit = micros/shots.length();
+        int worsthits = players*min(players-1, int(SGRAYS));
+        conoutf("lagcompbench: %d players, %d shots, %.0f ns per hit check, %d/%d honest hits passed, %d/%d offset hits rejected",
+            players, shots.length(), 1000*perhit, passed, (shots.length()+1)/2, rejected, shots.length()/2);
+        conoutf("every player hitting %d players with the shotgun in one tick: %d checks, %.3f ms", min(players-1, int(SGRAYS)), worsthits, worsthits*perhit/1000);
+        delete[] histories;
+    }
+    ICOMMAND(lagcompbench, "ii", (int *players, int *shots), lagcompbench(*players, *shots));
+
     void shotevent::process(clientinfo *ci)
     {
         gamestate &gs = ci->state;
@@ -1692,7 +2262,7 @@ namespace server
                     if(!target || target->state.state!=CS_ALIVE || h.lifesequence!=target->state.lifesequence || h.rays<1 || h.dist > guns[gun].range + 1) continue;
 
                     totalrays += h.rays;
-                    if(totalrays>maxrays) continue;
+                    if(totalrays>maxrays || !lagcompcheck(target->poshistory, ci->ping, from, to, gun, millis)) continue;
                     int damage = h.rays*guns[gun].damage;
                     if(gs.quadmillis) damage *= 4;
                     dodamage(target, ci, damage, gun, h.dir);
@@ -1778,10 +2348,14 @@ namespace server
     {
         if(!gamepaused) gamemillis += curtime;
 
+        checkdemokeyframe();
         if(m_demo) readdemo();
         else if(!gamepaused && (!m_timed || gamemillis < gamelimit))
         {
-            processevents();
+            {
+                profiletimer t(PROF_EVENTS);
+                processevents();
+            }
             if(curtime)
             {
                 loopv(sents) if(sents[i].spawntime) // spawn entities when timer reached
@@ -1800,10 +2374,15 @@ namespace server
                     }
                 }
             }
-            aiman::checkai();
+            {
+                profiletimer t(PROF_AI);
+                aiman::checkai();
+            }
             if(smode) smode->update();
         }
 
+        loopv(clients) if(clients[i]->demoid) senddemodata(clients[i]);
+
         while(bannedips.length() && bannedips[0].time-totalmillis>4*60*60000) bannedips.remove(0);
         loopv(connects) if(totalmillis-connects[i]->connectmillis>15000) disconnect_client(connects[i]->clientnum, DISC_TIMEOUT);
 
@@ -1954,7 +2533,7 @@ namespace server
         enet_uint32 ip, mask;
     };
 
-    vector<gbaninfo> gbans;
+    INSTANCELOCAL vector<gbaninfo> gbans;
 
     void cleargbans()
     {
@@ -2045,7 +2624,7 @@ namespace server
         sendf(ci->clientnum, 1, "risis", N_AUTHCHAL, "", id, val);
     }
 
-    uint nextauthreq = 0;
+    INSTANCELOCAL uint nextauthreq = 0;
 
     void tryauth(clientinfo *ci, const char *user)
     {
@@ -2145,7 +2724,7 @@ namespace server
 
                 ci->playermodel = getint(p);
 
-                if(m_demo) enddemoplayback();
+                if(m_demo && demoplayback && !demoplayback->seekable()) enddemoplayback();
 
                 connects.removeobj(ci);
                 clients.add(ci);
@@ -2160,11 +2739,15 @@ namespace server
 
                 sendwelcome(ci);
                 if(restorescore(ci)) sendresume(ci);
-                sendinitclient(ci);
+                if(!demoplayback) sendinitclient(ci);
 
                 aiman::addclient(ci);
 
-                if(m_demo) setupdemoplayback();
+                if(m_demo)
+                {
+                    if(demoplayback) joindemoplayback(ci);
+                    else setupdemoplayback();
+                }
 
                 if(servermotd[0]) sendf(sender, 1, "ris", N_SERVMSG, servermotd);
             }
@@ -2223,6 +2806,7 @@ namespace server
                         while(curmsg<p.length()) cp->position.add(p.buf[curmsg++]);
                     }
                     if(smode && cp->state.state==CS_ALIVE) smode->moved(cp, cp->state.o, cp->gameclip, pos, (flags&0x80)!=0);
+                    if(cp->state.state==CS_ALIVE) cp->poshistory.add(gamemillis, pos);
                     cp->state.o = pos;
                     cp->gameclip = (flags&0x80)!=0;
                 }
@@ -2551,6 +3135,13 @@ namespace server
                 sendf(sender, 1, "i2", N_PONG, getint(p));
                 break;
 
+            case N_POSACK:
+            {
+                int seq = getuint(p);
+                if(ci) ci->posdelta.acknowledge(seq);
+                break;
+            }
+
             case N_CLIENTPING:
             {
                 int ping = getint(p);
@@ -2707,6 +3298,14 @@ namespace server
                 break;
             }
 
+            case N_DEMOACK:
+            {
+                int id = getint(p), offset = getint(p);
+                if(!ci->privilege && !ci->local && ci->state.state==CS_SPECTATOR) break;
+                ackdemo(ci, id, offset);
+                break;
+            }
+
             case N_GETMAP:
                 if(!mapdata) sendf(sender, 1, "ris", N_SERVMSG, "no map to send");
                 else if(ci->getmap) sendf(sender, 1, "ris", N_SERVMSG, "already sending map");
@@ -2868,14 +3467,10 @@ namespace server
 
     #include "extinfo.h"
 
-    void serverinforeply(ucharbuf &req, ucharbuf &p)
+    void serverinfosnapshot(vector<uchar> &info)
     {
-        if(!getint(req))
-        {
-            extserverinforeply(req, p);
-            return;
-        }
-
+        uchar buf[MAXTRANS];
+        ucharbuf p(buf, sizeof(buf));
         putint(p, numclients(-1, false, true));
         putint(p, 5);                   // number of attrs following
         putint(p, PROTOCOL_VERSION);    // generic attributes, passed back below
@@ -2885,6 +3480,22 @@ namespace server
         putint(p, serverpass[0] ? MM_PASSWORD : (!m_mp(gamemode) ? MM_PRIVATE : (mastermode || mastermask&MM_AUTOAPPROVE ? mastermode : MM_AUTH)));
         sendstring(smapname, p);
         sendstring(serverdesc, p);
+        addinfo(info, EXT_BASICINFO, -1, p);
+        extinfosnapshot(info);
+    }
+
+    // may run on the server info thread, so it only reads the snapshot
+    void serverinforeply(ucharbuf &req, ucharbuf &p, ucharbuf &info)
+    {
+        if(!getint(req))
+        {
+            extserverinforeply(req, p, info);
+            return;
+        }
+
+        ucharbuf body;
+        if(!findinfo(info, EXT_BASICINFO, -1, body)) return;
+        p.put(body.buf, body.maxlen);
         sendserverinforeply(p);
     }
 
@@ -402,73 +402,78 @@ namespace ai
         return n;
     }
 
-    static inline float heapscore(waypoint *q) { return q->score(); }
+    static inline float heapscore(routenode *q) { return q->score(); }
 
-    bool route(fpsent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
+    bool route(routestate &rs, void *owner, const int *prevnodes, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
     {
         if(waypoints.empty() || !iswaypoint(node) || !iswaypoint(goal) || goal == node || !waypoints[node].links[0])
             return false;
 
-        static ushort routeid = 1;
-        static vector<waypoint *> queue;
+        vector<routenode> &nodes = rs.nodes;
+        vector<routenode *> &queue = rs.queue;
+
+        while(nodes.length() < waypoints.length()) nodes.add().route = 0;
 
-        if(!routeid)
+        if(!rs.routeid)
         {
-            loopv(waypoints) waypoints[i].route = 0;
-            routeid = 1;
+            loopv(nodes) nodes[i].route = 0;
+            rs.routeid = 1;
         }
+        ushort routeid = rs.routeid;
 
-        if(d)
+        if(owner)
         {
-            if(retries <= 1 && d->ai) loopi(ai::NUMPREVNODES) if(d->ai->prevnodes[i] != node && iswaypoint(d->ai->prevnodes[i]))
+            if(retries <= 1 && prevnodes) loopi(ai::NUMPREVNODES) if(prevnodes[i] != node && iswaypoint(prevnodes[i]))
             {
-                waypoints[d->ai->prevnodes[i]].route = routeid;
-                waypoints[d->ai->prevnodes[i]].curscore = -1;
-                waypoints[d->ai->prevnodes[i]].estscore = 0;
+                nodes[prevnodes[i]].route = routeid;
+                nodes[prevnodes[i]].curscore = -1;
+                nodes[prevnodes[i]].estscore = 0;
             }
 			if(retries <= 0)
 			{
-				loopavoid(obstacles, d,
+				loopavoid(obstacles, owner,
 				{
 					if(iswaypoint(wp) && wp != node && wp != goal && waypoints[node].find(wp) < 0 && waypoints[goal].find(wp) < 0)
 					{
-						waypoints[wp].route = routeid;
-						waypoints[wp].curscore = -1;
-						waypoints[wp].estscore = 0;
+						nodes[wp].route = routeid;
+						nodes[wp].curscore = -1;
+						nodes[wp].estscore = 0;
 					}
 				});
 			}
         }
 
-        waypoints[node].route = routeid;
-        waypoints[node].curscore = waypoints[node].estscore = 0;
-        waypoints[node].prev = 0;
+        nodes[node].route = routeid;
+        nodes[node].curscore = nodes[node].estscore = 0;
+        nodes[node].prev = 0;
         queue.setsize(0);
-        queue.add(&waypoints[node]);
+        queue.add(&nodes[node]);
         route.setsize(0);
 
         int lowest = -1;
         while(!queue.empty())
         {
-            waypoint &m = *queue.removeheap();
-            float prevscore = m.curscore;
-            m.curscore = -1;
+            routenode &r = *queue.removeheap();
+            waypoint &m = waypoints[&r - &nodes[0]];
+            float prevscore = r.curscore;
+            r.curscore = -1;
             loopi(MAXWAYPOINTLINKS)
             {
                 int link = m.links[i];
                 if(!link) break;
                 if(iswaypoint(link) && (link == node || link == goal || waypoints[link].links[0]))
                 {
-                    waypoint &n = waypoints[link];
-                    int weight = max(n.weight, 1);
-                    float curscore = prevscore + n.o.dist(m.o)*weight;
+                    waypoint &w = waypoints[link];
+                    routenode &n = nodes[link];
+                    int weight = max(w.weight, 1);
+                    float curscore = prevscore + w.o.dist(m.o)*weight;
                     if(n.route == routeid && curscore >= n.curscore) continue;
                     n.curscore = curscore;
-                    n.prev = ushort(&m - &waypoints[0]);
+                    n.prev = ushort(&r - &nodes[0]);
                     if(n.route != routeid)
                     {
-                        n.estscore = n.o.dist(waypoints[goal].o)*weight;
-                        if(n.estscore <= WAYPOINTRADIUS*4 && (lowest < 0 || n.estscore <= waypoints[lowest].estscore))
+                        n.estscore = w.o.dist(waypoints[goal].o)*weight;
+                        if(n.estscore <= WAYPOINTRADIUS*4 && (lowest < 0 || n.estscore <= nodes[lowest].estscore))
                             lowest = link;
                         n.route = routeid;
                         if(link == goal) goto foundgoal;
@@ -480,22 +485,29 @@ namespace ai
         }
         foundgoal:
 
-        routeid++;
+        rs.routeid++;
 
         if(lowest >= 0) // otherwise nothing got there
         {
-            for(waypoint *m = &waypoints[lowest]; m > &waypoints[0]; m = &waypoints[m->prev])
-                route.add(m - &waypoints[0]); // just keep it stored backward
+            for(routenode *r = &nodes[lowest]; r > &nodes[0]; r = &nodes[r->prev])
+                route.add(r - &nodes[0]); // just keep it stored backward
         }
 
         return !route.empty();
     }
 
+    bool route(fpsent *d, int node, int goal, vector<int> &route, const avoidset &obstacles, int retries)
+    {
+        static routestate rs;
+        return ai::route(rs, d, d && d->ai ? d->ai->prevnodes : NULL, node, goal, route, obstacles, retries);
+    }
+
     VAR(dropwaypoints, 0, 0, 1);
 
     int addwaypoint(const vec &o, int weight = -1)
     {
         if(waypoints.length() > MAXWAYPOINTS) return -1;
+        syncroutes();
         int n = waypoints.length();
         waypoints.add(waypoint(o, weight >= 0 ? weight : getweight(o)));
         return n;
@@ -503,6 +515,7 @@ namespace ai
 
     void linkwaypoint(waypoint &a, int n)
     {
+        syncroutes();
         loopi(MAXWAYPOINTLINKS)
         {
             if(a.links[i] == n) return;
@@ -582,6 +595,7 @@ namespace ai
 
     void clearwaypoints(bool full)
     {
+        flushroutes();
         waypoints.setsize(0);
         clearwpcache();
         if(full)
@@ -612,6 +626,7 @@ namespace ai
 
     void remapwaypoints()
     {
+        flushroutes();
         vector<ushort> remap;
         int total = 0;
         loopv(waypoints) remap.add(waypoints[i].links[1] == 0xFFFF ? 0 : total++);
@@ -636,6 +651,7 @@ namespace ai
 
     bool cleanwaypoints()
     {
+        flushroutes();
         int cleared = 0;
         loopv(waypoints)
         {
@@ -683,6 +699,7 @@ namespace ai
 
         copystring(loadedwaypoints, wptname);
 
+        flushroutes();
         waypoints.setsize(0);
         waypoints.add(vec(0, 0, 0));
         ushort numwp = f->getlil<ushort>();
@@ -744,6 +761,7 @@ namespace ai
     {
         if(noedit(true)) return;
         vec o = sel.o.tovec().sub(0.1f), s = sel.s.tovec().mul(sel.grid).add(o).add(0.1f);
+        flushroutes();
         int cleared = 0;
         loopv(waypoints)
         {
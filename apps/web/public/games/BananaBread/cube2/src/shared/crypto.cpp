@@ -77,7 +77,7 @@ namespace tiger
         state[2] = c;
     }
 
-    void gensboxes()
+    bool gensboxes()
     {
         const char *str = "Tiger - A Fast New Hash Function, by Ross Anderson and Eli Biham";
         chunk state[3] = { 0x0123456789ABCDEFULL, 0xFEDCBA9876543210ULL, 0xF096A5B4C3B2E187ULL };
@@ -99,13 +99,13 @@ namespace tiger
                 ((uchar *)&sboxes[sb + ((uchar *)&state[abc])[col]])[col] = val;
             }
         }
+        return true;
     }
 
+    static bool sboxesinit = gensboxes(); // at startup, before server instance threads could race to build them
+
     void hash(const uchar *str, int length, hashval &val)
     {
-        static bool init = false;
-        if(!init) { gensboxes(); init = true; }
-
         uchar temp[64];
 
         val.chunks[0] = 0x0123456789ABCDEFULL;
@@ -6,10 +6,10 @@
 #define EMSCRIPTEN_KEEPALIVE
 #endif
 
-extern int curtime;                     // current frame time
-extern int lastmillis;                  // last time
-extern int totalmillis;                 // total elapsed time
-extern uint totalsecs;
+extern INSTANCELOCAL int curtime;       // current frame time
+extern INSTANCELOCAL int lastmillis;    // last time
+extern INSTANCELOCAL int totalmillis;   // total elapsed time
+extern INSTANCELOCAL uint totalsecs;
 extern int gamespeed, paused;
 
 enum
@@ -321,6 +321,16 @@ extern uint getmapcrc();
 extern void clearmapcrc();
 extern bool loadents(const char *fname, vector<entity> &ents, uint *crc = NULL);
 
+// mapgeom
+struct mapgeom;
+extern mapgeom *loadmapgeom(const char *mname, uint crc = 0, bool *cached = NULL);
+extern void freemapgeom(mapgeom *g);
+extern int mapgeomsize(const mapgeom *g);
+extern void mapgeomstats(const mapgeom *g, int &nodes, int &leaves, int &planes, int &memory);
+extern float geomraycast(const mapgeom *g, const vec &o, const vec &ray, float radius = 0, int mode = RAY_CLIPMAT);
+extern bool geomlos(const mapgeom *g, const vec &o, const vec &dest, vec &hitpos);
+extern bool geomcollide(const mapgeom *g, const vec &o, float radius, float eyeheight, float aboveeye, bool gameclip = false);
+
 // physics
 extern void moveplayer(physent *pl, int moveres, bool local);
 extern bool moveplayer(physent *pl, int moveres, bool local, int curtime);
@@ -425,6 +435,40 @@ extern bool haslocalclients();
 extern void sendserverinforeply(ucharbuf &p);
 extern bool requestmaster(const char *req);
 extern bool requestmasterf(const char *fmt, ...);
+extern uint netmodelcrc;
+extern int netcompress;
+extern ENetPacket *compresspacket(ENetPacket *packet, int chan);
+extern void sentcompressed(ENetPacket *compressed, ENetPacket *packet);
+extern ENetPacket *decompresspacket(ENetPacket *packet, int chan);
+extern void addnetsample(int chan, const uchar *data, int len);
+
+// server tick profiler, enabled by serverprofile
+enum
+{
+    PROF_TICK = 0,      // a whole server tick, except waiting for packets
+    PROF_ENET,          // servicing the host, including that wait
+    PROF_PACKETS,       // parsing received packets
+    PROF_MASTER,        // master server connection and info requests
+    PROF_UPDATE,        // server::serverupdate
+    PROF_EVENTS,        // client events (shots, explosions) of a tick
+    PROF_AI,            // bot management
+    PROF_WORLDSTATE,    // building and sending the world state
+    NUMPROFPHASES
+};
+
+extern int serverprofile;
+extern llong profilemicros();
+extern void addprofile(int phase, int micros);
+extern void putprofile(ucharbuf &p);
+
+struct profiletimer
+{
+    int phase;
+    llong start;
+
+    profiletimer(int phase) : phase(phase), start(serverprofile ? profilemicros() : -1) {}
+    ~profiletimer() { if(start >= 0) addprofile(phase, int(profilemicros() - start)); }
+};
 
 // client
 extern void sendclientpacket(ENetPacket *packet, int chan);
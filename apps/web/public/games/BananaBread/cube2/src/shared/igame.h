@@ -112,7 +112,8 @@ namespace server
     extern void parsepacket(int sender, int chan, packetbuf &p);
     extern void sendservmsg(const char *s);
     extern bool sendpackets(bool force = false);
-    extern void serverinforeply(ucharbuf &req, ucharbuf &p);
+    extern void serverinfosnapshot(vector<uchar> &info);
+    extern void serverinforeply(ucharbuf &req, ucharbuf &p, ucharbuf &info);
     extern void serverupdate();
     extern bool servercompatible(char *name, char *sdec, char *map, int ping, const vector<int> &attr, int np);
     extern int laninfoport();
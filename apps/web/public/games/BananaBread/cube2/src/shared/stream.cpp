@@ -192,7 +192,7 @@ vector<char *> packagedirs;
 
 char *makerelpath(const char *dir, const char *file, const char *prefix, const char *cmd)
 {
-    static string tmp;
+    static INSTANCELOCAL string tmp;
     if(prefix) copystring(tmp, prefix);
     else tmp[0] = '\0';
     if(file[0]=='<')
@@ -258,7 +258,7 @@ char *path(char *s)
 
 char *path(const char *s, bool copy)
 {
-    static string tmp;
+    static INSTANCELOCAL string tmp;
     copystring(tmp, s);
     path(tmp);
     return tmp;
@@ -268,7 +268,7 @@ const char *parentdir(const char *directory)
 {
     const char *p = directory + strlen(directory);
     while(p > directory && *p != '/' && *p != '\\') p--;
-    static string parent;
+    static INSTANCELOCAL string parent;
     size_t len = p-directory+1;
     copystring(parent, directory, len);
     return parent;
@@ -291,7 +291,7 @@ bool createdir(const char *path)
     size_t len = strlen(path);
     if(path[len-1]==PATHDIV)
     {
-        static string strip;
+        static INSTANCELOCAL string strip;
         path = copystring(strip, path, len);
     }
 #ifdef WIN32
@@ -353,7 +353,7 @@ const char *addpackagedir(const char *dir)
 
 const char *findfile(const char *filename, const char *mode)
 {
-    static string s;
+    static INSTANCELOCAL string s;
     if(homedir[0])
     {
         formatstring(s)("%s%s", homedir, filename);
@@ -8,8 +8,8 @@
 #define M (397)                
 #define K (0x9908B0DFU)       
 
-static uint state[N];
-static int next = N;
+static INSTANCELOCAL uint state[N];
+static INSTANCELOCAL int next = N;
 
 void seedMT(uint seed)
 {
@@ -36,3 +36,189 @@ uint randomMT()
     return y;
 }
 
+
+////////////////////////// network encoding ////////////////////////////////////////
+
+// all network traffic is in 32bit ints, which are then compressed using the following simple scheme (assumes that most values are small).
+
+template<class T>
+static inline void putint_(T &p, int n)
+{
+    if(n<128 && n>-127) p.put(n);
+    else if(n<0x8000 && n>=-0x8000) { p.put(0x80); p.put(n); p.put(n>>8); }
+    else { p.put(0x81); p.put(n); p.put(n>>8); p.put(n>>16); p.put(n>>24); }
+}
+void putint(ucharbuf &p, int n) { putint_(p, n); }
+void putint(packetbuf &p, int n) { putint_(p, n); }
+void putint(vector<uchar> &p, int n) { putint_(p, n); }
+
+int getint(ucharbuf &p)
+{
+    int c = (char)p.get();
+    if(c==-128) { int n = p.get(); n |= char(p.get())<<8; return n; }
+    else if(c==-127) { int n = p.get(); n |= p.get()<<8; n |= p.get()<<16; return n|(p.get()<<24); } 
+    else return c;
+}
+
+// much smaller encoding for unsigned integers up to 28 bits, but can handle signed
+template<class T>
+static inline void putuint_(T &p, int n)
+{
+    if(n < 0 || n >= (1<<21))
+    {
+        p.put(0x80 | (n & 0x7F));
+        p.put(0x80 | ((n >> 7) & 0x7F));
+        p.put(0x80 | ((n >> 14) & 0x7F));
+        p.put(n >> 21);
+    }
+    else if(n < (1<<7)) p.put(n);
+    else if(n < (1<<14))
+    {
+        p.put(0x80 | (n & 0x7F));
+        p.put(n >> 7);
+    }
+    else 
+    { 
+        p.put(0x80 | (n & 0x7F)); 
+        p.put(0x80 | ((n >> 7) & 0x7F));
+        p.put(n >> 14); 
+    }
+}
+void putuint(ucharbuf &p, int n) { putuint_(p, n); }
+void putuint(packetbuf &p, int n) { putuint_(p, n); }
+void putuint(vector<uchar> &p, int n) { putuint_(p, n); }
+
+int getuint(ucharbuf &p)
+{
+    int n = p.get();
+    if(n & 0x80)
+    {
+        n += (p.get() << 7) - 0x80;
+        if(n & (1<<14)) n += (p.get() << 14) - (1<<14);
+        if(n & (1<<21)) n += (p.get() << 21) - (1<<21);
+        if(n & (1<<28)) n |= -1<<28;
+    }
+    return n;
+}
+
+template<class T>
+static inline void putfloat_(T &p, float f)
+{
+    lilswap(&f, 1);
+    p.put((uchar *)&f, sizeof(float));
+}
+void putfloat(ucharbuf &p, float f) { putfloat_(p, f); }
+void putfloat(packetbuf &p, float f) { putfloat_(p, f); }
+void putfloat(vector<uchar> &p, float f) { putfloat_(p, f); }
+
+float getfloat(ucharbuf &p)
+{
+    float f;
+    p.get((uchar *)&f, sizeof(float));
+    return lilswap(f);
+}
+
+template<class T>
+static inline void sendstring_(const char *t, T &p)
+{
+    while(*t) putint(p, *t++);
+    putint(p, 0);
+}
+void sendstring(const char *t, ucharbuf &p) { sendstring_(t, p); }
+void sendstring(const char *t, packetbuf &p) { sendstring_(t, p); }
+void sendstring(const char *t, vector<uchar> &p) { sendstring_(t, p); }
+
+void getstring(char *text, ucharbuf &p, int len)
+{
+    char *t = text;
+    do
+    {
+        if(t>=&text[len]) { text[len-1] = 0; return; }
+        if(!p.remaining()) { *t = 0; return; } 
+        *t = getint(p);
+    }
+    while(*t++);
+}
+
+////////////////////////// packet pools ////////////////////////////////////////
+
+// every block starts with a header naming its size class, so ENet's free callback,
+// which is not given the size, can put it back on the right free list
+struct poolheader
+{
+    int sizeclass;
+    int pad[3];
+};
+
+#define POOLLARGE (-1)
+
+static bool poolsinstalled = false;
+static INSTANCELOCAL poolheader *freeblocks[POOLCLASSES];
+static INSTANCELOCAL int numfreeblocks[POOLCLASSES];
+static INSTANCELOCAL poolstats pools;
+
+static inline int poolclass(size_t size)
+{
+    if(size > POOLBLOCKSIZE(POOLCLASSES-1)) return POOLLARGE;
+    int c = 0;
+    while(POOLBLOCKSIZE(c) < size) c++;
+    return c;
+}
+
+static void * ENET_CALLBACK poolalloc(size_t size)
+{
+    pools.allocs++;
+    int c = poolclass(size);
+    poolheader *h;
+    if(c != POOLLARGE && freeblocks[c])
+    {
+        h = freeblocks[c];
+        freeblocks[c] = *(poolheader **)(h + 1);
+        numfreeblocks[c]--;
+    }
+    else
+    {
+        pools.mallocs++;
+        if(c==POOLLARGE) pools.large++;
+        h = (poolheader *)malloc(sizeof(poolheader) + (c==POOLLARGE ? size : POOLBLOCKSIZE(c)));
+        if(!h) return NULL;
+        h->sizeclass = c;
+    }
+    return h + 1;
+}
+
+static void ENET_CALLBACK poolfree(void *p)
+{
+    if(!p) return;
+    pools.frees++;
+    poolheader *h = (poolheader *)p - 1;
+    int c = h->sizeclass;
+    // keep at most about a megabyte of idle blocks per size class
+    if(c==POOLLARGE || numfreeblocks[c] >= max(int(POOLMINFREE), int((1<<20)/POOLBLOCKSIZE(c)))) { free(h); return; }
+    *(poolheader **)p = freeblocks[c];
+    freeblocks[c] = h;
+    numfreeblocks[c]++;
+}
+
+int initpacketpools()
+{
+    ENetCallbacks callbacks = { poolalloc, poolfree, NULL };
+    int err = enet_initialize_with_callbacks(ENET_VERSION, &callbacks);
+    if(!err) poolsinstalled = true;
+    return err;
+}
+
+void *poolshrink(void *p, size_t len)
+{
+    if(!poolsinstalled || !p || !len) return p;
+    poolheader *h = (poolheader *)p - 1;
+    int c = poolclass(len);
+    if(c==POOLLARGE || (h->sizeclass!=POOLLARGE && c >= h->sizeclass)) return p;
+    void *q = poolalloc(len);
+    if(!q) return p;
+    memcpy(q, p, len);
+    poolfree(p);
+    return q;
+}
+
+const poolstats &getpoolstats() { return pools; }
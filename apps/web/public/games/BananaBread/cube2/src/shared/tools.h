@@ -30,6 +30,15 @@ typedef unsigned long long int ullong;
 #define RESTRICT
 #endif
 
+// a posix dedicated server can run several instances, each on its own thread,
+// so state belonging to a single instance is thread local there
+#if defined(STANDALONE) && !defined(WIN32) && !defined(__EMSCRIPTEN__)
+#define INSTANCETHREADS 1
+#define INSTANCELOCAL thread_local
+#else
+#define INSTANCELOCAL
+#endif
+
 inline void *operator new(size_t size)
 {
     void *p = malloc(size);
@@ -228,6 +237,20 @@ struct databuf
 typedef databuf<char> charbuf;
 typedef databuf<uchar> ucharbuf;
 
+// ENet's packets and protocol state are carved from per-instance free lists of
+// POOLCLASSES size classes, so steady traffic does not reach malloc
+enum { POOLCLASSES = 10, POOLMINFREE = 64 };
+#define POOLBLOCKSIZE(c) (size_t(16)<<(c))
+
+struct poolstats
+{
+    llong allocs, frees, mallocs, large;
+};
+
+extern int initpacketpools();                  // enet_initialize() with the pools as its allocator
+extern void *poolshrink(void *p, size_t len);  // moves len bytes of a block into a smaller size class if one fits
+extern const poolstats &getpoolstats();
+
 struct packetbuf : ucharbuf
 {
     ENetPacket *packet;
@@ -276,6 +299,8 @@ struct packetbuf : ucharbuf
 
     ENetPacket *finalize()
     {
+        // growable buffers start out big, so give the slack back to the pool
+        if(growth > 0 && !(packet->flags&ENET_PACKET_FLAG_NO_ALLOCATE)) packet->data = (enet_uint8 *)poolshrink(packet->data, len);
         resize(len);
         return packet;
     }
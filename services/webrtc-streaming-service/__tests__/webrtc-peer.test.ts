@@ -0,0 +1,89 @@
+/**
+ * WebRTC Peer Tests
+ */
+
+// @ts-nocheck - Test file, type checking disabled
+// eslint-disable-next-line @typescript-eslint/ban-ts-comment
+// @ts-ignore
+import { describe, it, expect, jest, beforeEach } from '@jest/globals';
+
+// The addon hands out one session handle per start(); stop() without a handle stops them all
+jest.mock('../native/build/Release/native_capture.node', () => {
+  let nextHandle = 1;
+  return {
+    start: jest.fn(() => nextHandle++),
+    stop: jest.fn(),
+  };
+}, { virtual: true });
+
+jest.mock('werift', () => {
+  class RTCPeerConnection {
+    connectionState = 'new';
+    remoteDescription = null;
+    onicecandidate = null;
+    onconnectionstatechange = null;
+    async setRemoteDescription(description) { this.remoteDescription = description; }
+    close() {}
+  }
+  class RTCRtpCodecParameters {
+    constructor(parameters) { Object.assign(this, parameters); }
+  }
+  class MediaStreamTrack {}
+  return { RTCPeerConnection, RTCRtpCodecParameters, MediaStreamTrack, RTCRtpSender: class {}, RtpPacket: class {}, RtpHeader: class {} };
+});
+
+import { WebRTCPeer } from '../src/webrtc-peer';
+
+const nativeCapture = require('../native/build/Release/native_capture.node');
+
+const config = { width: 1280, height: 720, fps: 60, bitrate: 5000 };
+
+function setConnectionState(peer: WebRTCPeer, state: string) {
+  const pc = (peer as any).peerConnection;
+  pc.connectionState = state;
+  pc.onconnectionstatechange();
+}
+
+describe('WebRTCPeer', () => {
+  beforeEach(() => {
+    nativeCapture.start.mockClear();
+    nativeCapture.stop.mockClear();
+  });
+
+  describe('capture sessions', () => {
+    it('should stop only its own session when one of two peers goes away', async () => {
+      const first = new WebRTCPeer('first', config);
+      const second = new WebRTCPeer('second', config);
+      await first.handleAnswer({ type: 'answer', sdp: '' });
+      await second.handleAnswer({ type: 'answer', sdp: '' });
+
+      expect(nativeCapture.start).toHaveBeenCalledTimes(2);
+      const firstHandle = nativeCapture.start.mock.results[0].value;
+      const secondHandle = nativeCapture.start.mock.results[1].value;
+      expect(firstHandle).not.toBe(secondHandle);
+
+      setConnectionState(first, 'disconnected');
+
+      expect(nativeCapture.stop).toHaveBeenCalledTimes(1);
+      expect(nativeCapture.stop).toHaveBeenCalledWith(firstHandle);
+
+      second.close();
+
+      expect(nativeCapture.stop).toHaveBeenCalledTimes(2);
+      expect(nativeCapture.stop).toHaveBeenLastCalledWith(secondHandle);
+    });
+
+    it('should keep one session when the answer and the connected state both start capture', async () => {
+      const peer = new WebRTCPeer('peer', config);
+      await peer.handleAnswer({ type: 'answer', sdp: '' });
+      setConnectionState(peer, 'connected');
+
+      expect(nativeCapture.start).toHaveBeenCalledTimes(1);
+
+      peer.close();
+      peer.close();
+
+      expect(nativeCapture.stop).toHaveBeenCalledTimes(1);
+    });
+  });
+});
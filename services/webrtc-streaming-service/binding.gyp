@@ -4,24 +4,24 @@
       "target_name": "native_capture",
       "sources": [
         "native/src/capture_addon.cc",
-        "native/src/wgc_capture.cc",
-        "native/src/dxgi_capture.cc",
-        "native/src/h264_encoder.cc"
+        "native/src/h264_encoder.cc",
+        "native/src/color_convert.cc",
+        "native/src/frame_buffer_pool.cc",
+        "native/src/delivery_queue.cc",
+        "native/src/latency_histogram.cc",
+        "native/src/capture_pipeline.cc",
+        "native/src/frame_source.cc",
+        "native/src/synthetic_source.cc",
+        "native/src/file_source.cc",
+        "native/src/image_scale.cc",
+        "native/src/bitrate_ladder.cc",
+        "native/src/worker_pool.cc"
       ],
       "include_dirs": [
-        "<!@(node -p \"require('node-addon-api').include\")",
-        "C:/vcpkg/installed/x64-windows/include"
-      ],
-      "libraries": [
-        "-ld3d11.lib",
-        "-ldxgi.lib",
-        "-lwindowsapp.lib",
-        "C:/vcpkg/installed/x64-windows/lib/libx264.lib"
+        "<!@(node -p \"require('node-addon-api').include\")"
       ],
       "defines": [
-        "NAPI_DISABLE_CPP_EXCEPTIONS",
-        "UNICODE",
-        "_UNICODE"
+        "NAPI_DISABLE_CPP_EXCEPTIONS"
       ],
       "msvs_settings": {
         "VCCLCompilerTool": {
@@ -31,7 +31,74 @@
       },
       "conditions": [
         ["OS=='win'", {
-          "defines": [ "WIN32" ]
+          "sources": [
+            "native/src/wgc_capture.cc",
+            "native/src/dxgi_capture.cc"
+          ],
+          "include_dirs": [
+            "C:/vcpkg/installed/x64-windows/include"
+          ],
+          "libraries": [
+            "-ld3d11.lib",
+            "-ldxgi.lib",
+            "-lwindowsapp.lib",
+            "C:/vcpkg/installed/x64-windows/lib/libx264.lib"
+          ],
+          "defines": [ "WIN32", "UNICODE", "_UNICODE" ]
+        }],
+        ["OS=='linux'", {
+          "libraries": [ "-lx264" ],
+          "cflags_cc": [ "-std=c++17" ]
+        }]
+      ]
+    },
+    {
+      "target_name": "color_convert_bench",
+      "type": "executable",
+      "sources": [
+        "native/bench/color_convert_bench.cc",
+        "native/src/color_convert.cc"
+      ],
+      "msvs_settings": {
+        "VCCLCompilerTool": {
+          "AdditionalOptions": [ "/std:c++17" ],
+          "ExceptionHandling": 1
+        }
+      },
+      "cflags_cc": [ "-std=c++17", "-O2" ]
+    },
+    {
+      "target_name": "encoder_bench",
+      "type": "executable",
+      "sources": [
+        "native/bench/encoder_bench.cc",
+        "native/src/h264_encoder.cc",
+        "native/src/color_convert.cc",
+        "native/src/image_scale.cc",
+        "native/src/frame_buffer_pool.cc",
+        "native/src/latency_histogram.cc",
+        "native/src/frame_source.cc",
+        "native/src/synthetic_source.cc",
+        "native/src/file_source.cc"
+      ],
+      "msvs_settings": {
+        "VCCLCompilerTool": {
+          "AdditionalOptions": [ "/std:c++17" ],
+          "ExceptionHandling": 1
+        }
+      },
+      "cflags_cc": [ "-std=c++17", "-O2" ],
+      "conditions": [
+        ["OS=='win'", {
+          "include_dirs": [
+            "C:/vcpkg/installed/x64-windows/include"
+          ],
+          "libraries": [
+            "C:/vcpkg/installed/x64-windows/lib/libx264.lib"
+          ]
+        }],
+        ["OS=='linux'", {
+          "libraries": [ "-lx264", "-lpthread" ]
         }]
       ]
     }
@@ -0,0 +1,147 @@
+// color_convert_bench.cc - Bit-exactness check and microbenchmark for BGRA -> I420 kernels
+//
+// Usage: color_convert_bench [width height iterations]
+// Exits non-zero if any SIMD path differs from the scalar reference.
+
+#include "../src/color_convert.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct I420Frame {
+    int width;
+    int height;
+    int y_stride;
+    int uv_stride;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> u;
+    std::vector<uint8_t> v;
+
+    I420Frame(int w, int h)
+        : width(w), height(h), y_stride(w), uv_stride((w + 1) / 2),
+          y(static_cast<size_t>(w) * h),
+          u(static_cast<size_t>((w + 1) / 2) * ((h + 1) / 2)),
+          v(static_cast<size_t>((w + 1) / 2) * ((h + 1) / 2)) {}
+};
+
+void Convert(BGRAToI420Fn fn, const std::vector<uint8_t>& bgra, I420Frame& out) {
+    fn(bgra.data(), out.width * 4,
+       out.y.data(), out.y_stride,
+       out.u.data(), out.uv_stride,
+       out.v.data(), out.uv_stride,
+       out.width, out.height);
+}
+
+bool SameFrame(const I420Frame& a, const I420Frame& b) {
+    return a.y == b.y && a.u == b.u && a.v == b.v;
+}
+
+const ColorConvertPath kSimdPaths[] = { ColorConvertPath::kSSE2, ColorConvertPath::kAVX2 };
+
+// Random content plus saturated extremes, over sizes that exercise the scalar tails
+bool VerifyBitExact() {
+    static const int sizes[][2] = {
+        {2, 2}, {16, 2}, {32, 2}, {33, 3}, {47, 5}, {64, 64}, {127, 31}, {1280, 720}, {1920, 1080},
+    };
+
+    std::mt19937 rng(1234);
+    bool ok = true;
+
+    for (const auto& size : sizes) {
+        int w = size[0];
+        int h = size[1];
+        std::vector<uint8_t> bgra(static_cast<size_t>(w) * h * 4);
+
+        for (int pattern = 0; pattern < 3; pattern++) {
+            for (size_t i = 0; i < bgra.size(); i++) {
+                switch (pattern) {
+                    case 0: bgra[i] = static_cast<uint8_t>(rng()); break;
+                    case 1: bgra[i] = (rng() & 1) ? 255 : 0; break;
+                    default: bgra[i] = static_cast<uint8_t>(i * 7 + (i >> 12)); break;
+                }
+            }
+
+            I420Frame reference(w, h);
+            Convert(GetBGRAToI420(ColorConvertPath::kScalar), bgra, reference);
+
+            for (ColorConvertPath path : kSimdPaths) {
+                I420Frame out(w, h);
+                Convert(GetBGRAToI420(path), bgra, out);
+                if (!SameFrame(reference, out)) {
+                    printf("MISMATCH path=%s size=%dx%d pattern=%d\n",
+                           ColorConvertPathName(path), w, h, pattern);
+                    ok = false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+void Benchmark(int width, int height, int iterations) {
+    std::vector<uint8_t> bgra(static_cast<size_t>(width) * height * 4);
+    std::mt19937 rng(42);
+    for (auto& byte : bgra) {
+        byte = static_cast<uint8_t>(rng());
+    }
+
+    I420Frame out(width, height);
+    const ColorConvertPath paths[] = {
+        ColorConvertPath::kScalar, ColorConvertPath::kSSE2, ColorConvertPath::kAVX2,
+    };
+    double scalar_us = 0.0;
+
+    for (ColorConvertPath path : paths) {
+        if (path != ColorConvertPath::kScalar && GetBGRAToI420(path) == GetBGRAToI420(ColorConvertPath::kScalar)) {
+            printf("%-8s unsupported on this CPU\n", ColorConvertPathName(path));
+            continue;
+        }
+
+        BGRAToI420Fn fn = GetBGRAToI420(path);
+        Convert(fn, bgra, out);  // warm up
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            Convert(fn, bgra, out);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double us = std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+        if (path == ColorConvertPath::kScalar) {
+            scalar_us = us;
+        }
+        printf("%-8s %dx%d: %8.1f us/frame  %6.2fx\n",
+               ColorConvertPathName(path), width, height, us, scalar_us / us);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int width = 1920;
+    int height = 1080;
+    int iterations = 200;
+    if (argc >= 3) {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        iterations = atoi(argv[3]);
+    }
+
+    printf("Detected path: %s\n", ColorConvertPathName(DetectColorConvertPath()));
+
+    if (!VerifyBitExact()) {
+        printf("Bit-exactness check FAILED\n");
+        return 1;
+    }
+    printf("Bit-exactness check passed\n");
+
+    Benchmark(width, height, iterations);
+    return 0;
+}
@@ -0,0 +1,365 @@
+// encoder_bench.cc - Throughput / latency / rate-control sweep for the x264 encoder
+//
+// Usage: encoder_bench [options]
+//   --content   synthetic:<motion 0-3> | file:<path>:<WxH>[:bgra|i420]   (comma separated)
+//   --size      WxH list, e.g. 1280x720,1920x1080
+//   --fps       frame rate list
+//   --preset    x264 preset list
+//   --threads   thread count list
+//   --slices    sliced | frame (list)
+//   --bpp       target bits per pixel per frame (default 0.08), or
+//   --bitrate   fixed target in kbps
+//   --seconds   media seconds encoded per configuration (default 5)
+//   --csv       machine readable output
+//   --out       write results to a file instead of stdout (the encoder logs to stdout)
+//
+// Every combination is encoded as fast as possible from frames prepared up
+// front, so only the encoder is measured. Reported per configuration:
+// encoded fps and realtime factor, p50 / p99 time per EncodeI420 call, and
+// achieved bitrate relative to the target.
+
+#include "../src/color_convert.h"
+#include "../src/frame_source.h"
+#include "../src/h264_encoder.h"
+#include "../src/image_scale.h"
+#include "../src/latency_histogram.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Distinct frames per content clip; cycled for longer runs
+constexpr int kClipFrames = 30;
+
+struct Options {
+    std::vector<std::string> contents = { "synthetic:1", "synthetic:3" };
+    std::vector<std::string> sizes = { "1280x720", "1920x1080" };
+    std::vector<int> fps = { 60 };
+    std::vector<std::string> presets = { "ultrafast", "superfast" };
+    std::vector<int> threads = { 1, 4 };
+    std::vector<std::string> slices = { "sliced", "frame" };
+    double bpp = 0.08;
+    int bitrate = 0;
+    int seconds = 5;
+    bool csv = false;
+    std::string out;
+};
+
+struct I420Clip {
+    int width = 0;
+    int height = 0;
+    std::vector<std::vector<uint8_t>> frames;
+
+    I420Image Image(size_t index) {
+        std::vector<uint8_t>& frame = frames[index % frames.size()];
+        size_t luma = static_cast<size_t>(width) * height;
+        size_t chroma = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+        I420Image image = {
+            { frame.data(), frame.data() + luma, frame.data() + luma + chroma },
+            { width, (width + 1) / 2, (width + 1) / 2 },
+            width, height
+        };
+        return image;
+    }
+};
+
+std::vector<std::string> Split(const char* list, char separator) {
+    std::vector<std::string> items;
+    std::string current;
+    for (const char* p = list; ; p++) {
+        if (*p == separator || *p == '\0') {
+            if (!current.empty()) {
+                items.push_back(current);
+            }
+            current.clear();
+            if (*p == '\0') {
+                break;
+            }
+        } else {
+            current += *p;
+        }
+    }
+    return items;
+}
+
+std::vector<int> SplitInts(const char* list) {
+    std::vector<int> values;
+    for (const std::string& item : Split(list, ',')) {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+bool ParseSize(const std::string& text, int* width, int* height) {
+    return sscanf(text.c_str(), "%dx%d", width, height) == 2 && *width > 0 && *height > 0 &&
+           (*width % 2) == 0 && (*height % 2) == 0;
+}
+
+// Captures a clip from a frame source and converts it to I420 at its native size
+bool CaptureClip(IFrameSource* source, int width, int height, int fps, I420Clip* clip) {
+    clip->width = width;
+    clip->height = height;
+    clip->frames.clear();
+
+    std::vector<uint8_t> raw(FrameSize(source->Format(), width, height));
+    for (int i = 0; i < kClipFrames; i++) {
+        if (!source->Capture(raw.data(), static_cast<int64_t>(i) * 1000 / fps)) {
+            break;
+        }
+        if (source->Format() == PixelFormat::kI420) {
+            clip->frames.push_back(raw);
+            continue;
+        }
+        std::vector<uint8_t> frame(FrameSize(PixelFormat::kI420, width, height));
+        clip->frames.push_back(std::move(frame));
+        I420Image image = clip->Image(clip->frames.size() - 1);
+        ConvertBGRAToI420(raw.data(), width * 4,
+                          image.planes[0], image.strides[0],
+                          image.planes[1], image.strides[1],
+                          image.planes[2], image.strides[2],
+                          width, height);
+    }
+    return !clip->frames.empty();
+}
+
+// Content at the requested size. Synthetic content is rendered at that size;
+// recorded content is loaded at its own size and rescaled.
+bool LoadContent(const std::string& spec, int width, int height, int fps, I420Clip* clip) {
+    std::vector<std::string> parts = Split(spec.c_str(), ':');
+    if (parts.empty()) {
+        return false;
+    }
+
+    FrameSourceOptions options;
+    int source_width = width;
+    int source_height = height;
+    if (parts[0] == "synthetic") {
+        options.motion = parts.size() > 1 ? atoi(parts[1].c_str()) : 1;
+    } else if (parts[0] == "file" && parts.size() >= 3) {
+        options.type = "file";
+        options.path = parts[1];
+        if (!ParseSize(parts[2], &source_width, &source_height)) {
+            return false;
+        }
+        if (parts.size() > 3 && !ParsePixelFormat(parts[3].c_str(), &options.format)) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    std::unique_ptr<IFrameSource> source = CreateFrameSource(options);
+    if (!source || !source->Initialize({ source_width, source_height, fps })) {
+        return false;
+    }
+    I420Clip native;
+    bool ok = CaptureClip(source.get(), source_width, source_height, fps, &native);
+    source->Cleanup();
+    if (!ok) {
+        return false;
+    }
+    if (source_width == width && source_height == height) {
+        *clip = std::move(native);
+        return true;
+    }
+
+    clip->width = width;
+    clip->height = height;
+    clip->frames.assign(native.frames.size(), std::vector<uint8_t>(FrameSize(PixelFormat::kI420, width, height)));
+    I420Scaler scaler;
+    for (size_t i = 0; i < native.frames.size(); i++) {
+        scaler.Scale(native.Image(i), clip->Image(i));
+    }
+    return true;
+}
+
+struct Result {
+    double encode_fps;
+    int64_t p50_us;
+    int64_t p99_us;
+    double bitrate_kbps;
+    int lag_frames;   // calls before the first output (frame threads add delay)
+};
+
+bool RunOne(I420Clip& clip, const IEncoder::Config& config, int seconds, Result* result) {
+    std::unique_ptr<IEncoder> encoder = CreateEncoder(false);
+    if (!encoder->Initialize(config)) {
+        return false;
+    }
+
+    LatencyHistogram latency;
+    const int frame_count = seconds * config.fps;
+    uint64_t total_bytes = 0;
+    int lag = -1;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frame_count; i++) {
+        auto before = std::chrono::steady_clock::now();
+        FrameBufferRef frame = encoder->EncodeI420(clip.Image(i), static_cast<int64_t>(i) * 1000 / config.fps);
+        auto after = std::chrono::steady_clock::now();
+        latency.Record(std::chrono::duration_cast<std::chrono::microseconds>(after - before).count());
+        if (!frame.empty()) {
+            total_bytes += frame->Size();
+            if (lag < 0) {
+                lag = i;
+            }
+        }
+    }
+    // Frames still in lookahead / frame threads count towards the bitrate and
+    // the encode time, not the per-call latency
+    for (FrameBufferRef frame = encoder->Flush(); !frame.empty(); frame = encoder->Flush()) {
+        total_bytes += frame->Size();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    encoder->Cleanup();
+
+    LatencyHistogram::Summary summary = latency.Summarize();
+    result->encode_fps = frame_count / elapsed;
+    result->p50_us = summary.p50_us;
+    result->p99_us = summary.p99_us;
+    result->bitrate_kbps = static_cast<double>(total_bytes) * 8.0 / 1000.0 / seconds;
+    result->lag_frames = lag < 0 ? frame_count : lag;
+    return true;
+}
+
+void Usage() {
+    printf("Usage: encoder_bench [--content list] [--size list] [--fps list] [--preset list]\n"
+           "                     [--threads list] [--slices sliced,frame] [--bpp n | --bitrate kbps]\n"
+           "                     [--seconds n] [--csv] [--out file]\n");
+}
+
+bool ParseArgs(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--csv") == 0) {
+            options->csv = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        if (strcmp(arg, "--content") == 0) {
+            options->contents = Split(value, ',');
+        } else if (strcmp(arg, "--size") == 0) {
+            options->sizes = Split(value, ',');
+        } else if (strcmp(arg, "--fps") == 0) {
+            options->fps = SplitInts(value);
+        } else if (strcmp(arg, "--preset") == 0) {
+            options->presets = Split(value, ',');
+        } else if (strcmp(arg, "--threads") == 0) {
+            options->threads = SplitInts(value);
+        } else if (strcmp(arg, "--slices") == 0) {
+            options->slices = Split(value, ',');
+        } else if (strcmp(arg, "--bpp") == 0) {
+            options->bpp = atof(value);
+        } else if (strcmp(arg, "--bitrate") == 0) {
+            options->bitrate = atoi(value);
+        } else if (strcmp(arg, "--seconds") == 0) {
+            options->seconds = atoi(value);
+        } else if (strcmp(arg, "--out") == 0) {
+            options->out = value;
+        } else {
+            return false;
+        }
+    }
+    return options->seconds > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseArgs(argc, argv, &options)) {
+        Usage();
+        return 2;
+    }
+
+    FILE* out = stdout;
+    if (!options.out.empty()) {
+        out = fopen(options.out.c_str(), "w");
+        if (!out) {
+            printf("Cannot open %s\n", options.out.c_str());
+            return 2;
+        }
+    }
+
+    if (options.csv) {
+        fprintf(out, "content,width,height,fps,preset,threads,slices,target_kbps,encode_fps,realtime,p50_us,p99_us,actual_kbps,bitrate_ratio,lag_frames\n");
+    } else {
+        fprintf(out, "%-14s %-10s %4s %-10s %3s %-6s %8s %9s %6s %8s %8s %8s %6s %4s\n",
+               "content", "size", "fps", "preset", "thr", "slices", "target", "enc fps", "x rt",
+               "p50 us", "p99 us", "kbps", "ratio", "lag");
+    }
+
+    int failures = 0;
+    for (const std::string& content : options.contents) {
+        for (const std::string& size : options.sizes) {
+            int width;
+            int height;
+            if (!ParseSize(size, &width, &height)) {
+                printf("Invalid size %s (even WxH expected)\n", size.c_str());
+                return 2;
+            }
+            for (int fps : options.fps) {
+                I420Clip clip;
+                if (!LoadContent(content, width, height, fps, &clip)) {
+                    printf("Could not load content %s at %s\n", content.c_str(), size.c_str());
+                    failures++;
+                    continue;
+                }
+
+                for (const std::string& preset : options.presets) {
+                    for (int threads : options.threads) {
+                        for (const std::string& slices : options.slices) {
+                            IEncoder::Config config;
+                            config.width = width;
+                            config.height = height;
+                            config.fps = fps;
+                            config.bitrate = options.bitrate > 0 ? options.bitrate
+                                : static_cast<int>(static_cast<double>(width) * height * fps * options.bpp / 1000.0);
+                            config.threads = threads;
+                            config.sliced_threads = slices != "frame";
+                            config.preset = preset;
+
+                            Result result;
+                            if (!RunOne(clip, config, options.seconds, &result)) {
+                                printf("Encoder init failed: %s %s %s t=%d\n",
+                                       content.c_str(), size.c_str(), preset.c_str(), threads);
+                                failures++;
+                                continue;
+                            }
+
+                            double ratio = result.bitrate_kbps / config.bitrate;
+                            if (options.csv) {
+                                fprintf(out, "%s,%d,%d,%d,%s,%d,%s,%d,%.1f,%.2f,%lld,%lld,%.0f,%.3f,%d\n",
+                                       content.c_str(), width, height, fps, preset.c_str(), threads,
+                                       slices.c_str(), config.bitrate, result.encode_fps,
+                                       result.encode_fps / fps, static_cast<long long>(result.p50_us),
+                                       static_cast<long long>(result.p99_us), result.bitrate_kbps,
+                                       ratio, result.lag_frames);
+                            } else {
+                                fprintf(out, "%-14s %-10s %4d %-10s %3d %-6s %8d %9.1f %6.2f %8lld %8lld %8.0f %6.3f %4d\n",
+                                       content.c_str(), size.c_str(), fps, preset.c_str(), threads,
+                                       slices.c_str(), config.bitrate, result.encode_fps,
+                                       result.encode_fps / fps, static_cast<long long>(result.p50_us),
+                                       static_cast<long long>(result.p99_us), result.bitrate_kbps,
+                                       ratio, result.lag_frames);
+                            }
+                            fflush(out);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return failures == 0 ? 0 : 1;
+}
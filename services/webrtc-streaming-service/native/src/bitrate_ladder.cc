@@ -0,0 +1,141 @@
+// bitrate_ladder.cc - Bandwidth estimate -> bitrate / resolution / frame rate
+
+#include "bitrate_ladder.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+// Rung shapes relative to the capture size, highest first. Frame rate is
+// dropped to 30 before resolution, since a halved frame rate is less visible
+// on desktop content than a blurrier picture.
+static const struct {
+    int num;
+    int den;
+    int max_fps;
+} kRungShapes[] = {
+    { 1, 1, 240 },
+    { 1, 1, 30 },
+    { 3, 4, 30 },
+    { 1, 2, 30 },
+    { 1, 3, 30 },
+    { 1, 4, 15 },
+};
+
+// Bits per pixel per frame below which x264 ultrafast output at a rung looks
+// worse than the next rung down at the same bitrate
+static constexpr double kMinBitsPerPixel = 0.05;
+
+static constexpr int kMinRungWidth = 160;
+static constexpr int kMinRungHeight = 90;
+
+BitrateLadder::BitrateLadder(const IEncoder::Config& top, int min_kbps, bool adapt_resolution)
+    : min_kbps_(std::min(min_kbps, top.bitrate)), max_kbps_(top.bitrate), rung_(0), current_(top),
+      below_since_ms_(-1), above_since_ms_(-1), last_switch_ms_(-1) {
+    for (const auto& shape : kRungShapes) {
+        Rung rung;
+        rung.width = (top.width * shape.num / shape.den) & ~1;
+        rung.height = (top.height * shape.num / shape.den) & ~1;
+        rung.fps = std::min(top.fps, shape.max_fps);
+        rung.min_kbps = static_cast<int>(static_cast<double>(rung.width) * rung.height * rung.fps *
+                                         kMinBitsPerPixel / 1000.0);
+
+        if (!rungs_.empty()) {
+            const Rung& previous = rungs_.back();
+            if (rung.width == previous.width && rung.height == previous.height && rung.fps == previous.fps) {
+                continue;
+            }
+            if (rung.width < kMinRungWidth || rung.height < kMinRungHeight) {
+                break;
+            }
+        }
+        rungs_.push_back(rung);
+        if (!adapt_resolution) {
+            break;
+        }
+    }
+
+    // The top rung is always the capture format, whatever its rounding
+    rungs_[0].width = top.width;
+    rungs_[0].height = top.height;
+}
+
+IEncoder::Config BitrateLadder::RungConfig(size_t rung, int bitrate) const {
+    IEncoder::Config config = current_;
+    config.width = rungs_[rung].width;
+    config.height = rungs_[rung].height;
+    config.fps = rungs_[rung].fps;
+    config.bitrate = bitrate;
+    return config;
+}
+
+BitrateLadder::Decision BitrateLadder::Update(int estimate_kbps, int64_t now_ms) {
+    int target = static_cast<int>(estimate_kbps * kTargetFraction);
+    target = std::max(min_kbps_, std::min(max_kbps_, target));
+    size_t rung = rung_;
+
+    // Down: go straight to the highest rung the bitrate can carry, one IDR
+    // instead of one per intermediate rung
+    if (rung + 1 < rungs_.size() && target < rungs_[rung].min_kbps) {
+        if (below_since_ms_ < 0) {
+            below_since_ms_ = now_ms;
+        }
+        if (now_ms - below_since_ms_ >= kDownHoldMs) {
+            while (rung + 1 < rungs_.size() && target < rungs_[rung].min_kbps) {
+                rung++;
+            }
+        }
+    } else {
+        below_since_ms_ = -1;
+    }
+
+    // Up: one rung at a time, only after the estimate has held for a while
+    if (rung == rung_ && rung > 0 && target >= rungs_[rung - 1].min_kbps * kUpHeadroom) {
+        if (above_since_ms_ < 0) {
+            above_since_ms_ = now_ms;
+        }
+        if (now_ms - above_since_ms_ >= kUpHoldMs &&
+            (last_switch_ms_ < 0 || now_ms - last_switch_ms_ >= kUpHoldMs)) {
+            rung--;
+        }
+    } else {
+        above_since_ms_ = -1;
+    }
+
+    Decision decision;
+    decision.rung_changed = rung != rung_;
+    if (decision.rung_changed) {
+        printf("[BitrateLadder] %dx%d@%d -> %dx%d@%d at %d kbps (estimate %d kbps)\n",
+               current_.width, current_.height, current_.fps,
+               rungs_[rung].width, rungs_[rung].height, rungs_[rung].fps, target, estimate_kbps);
+        rung_ = rung;
+        last_switch_ms_ = now_ms;
+        below_since_ms_ = -1;
+        above_since_ms_ = -1;
+        current_ = RungConfig(rung_, target);
+        decision.changed = true;
+    } else {
+        int delta = std::abs(target - current_.bitrate);
+        decision.changed = delta > 0 && (delta >= current_.bitrate * kMinChange ||
+                                         target == min_kbps_ || target == max_kbps_);
+        if (decision.changed) {
+            current_.bitrate = target;
+        }
+    }
+
+    decision.config = current_;
+    return decision;
+}
+
+void BitrateLadder::Override(const IEncoder::Config& config, int64_t now_ms) {
+    size_t rung = 0;
+    while (rung + 1 < rungs_.size() &&
+           (rungs_[rung].width > config.width || rungs_[rung].height > config.height ||
+            rungs_[rung].fps > config.fps)) {
+        rung++;
+    }
+    rung_ = rung;
+    current_ = config;
+    last_switch_ms_ = now_ms;
+    below_since_ms_ = -1;
+    above_since_ms_ = -1;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "h264_encoder.h"
+
+// Maps a bandwidth estimate from JS to encoder settings.
+//
+// Bitrate tracks the estimate on every update; that is a rate-control change
+// and costs nothing. Resolution and frame rate (a "rung") change only when
+// the bitrate falls outside what the current rung can use: each rung switch
+// reopens the encoder and starts with an IDR, so switches are held back by
+// hysteresis. Stepping down needs the estimate below the rung floor for
+// kDownHoldMs; stepping up needs it comfortably above the next rung's floor
+// for kUpHoldMs, and only one rung at a time.
+class BitrateLadder {
+public:
+    struct Rung {
+        int width;
+        int height;
+        int fps;
+        int min_kbps;   // below this the rung looks worse than the next one down
+    };
+
+    struct Decision {
+        IEncoder::Config config;
+        bool changed;        // config differs from the previous decision
+        bool rung_changed;   // resolution or frame rate changed (encoder restarts)
+    };
+
+    // top is the capture resolution / frame rate at the maximum bitrate.
+    // Without adapt_resolution the ladder has a single rung and only the
+    // bitrate follows the estimate.
+    BitrateLadder(const IEncoder::Config& top, int min_kbps, bool adapt_resolution);
+
+    Decision Update(int estimate_kbps, int64_t now_ms);
+
+    // Settings applied from outside the ladder (an explicit reconfigure).
+    // Later updates continue from them: the bitrate follows the estimate
+    // while the resolution and frame rate stay until the next rung switch,
+    // counted from the highest rung that fits within them.
+    void Override(const IEncoder::Config& config, int64_t now_ms);
+
+    const IEncoder::Config& Current() const { return current_; }
+    size_t CurrentRung() const { return rung_; }
+    const std::vector<Rung>& Rungs() const { return rungs_; }
+
+private:
+    static constexpr int64_t kDownHoldMs = 500;
+    static constexpr int64_t kUpHoldMs = 5000;
+    static constexpr double kTargetFraction = 0.9;   // leave room for audio, FEC and estimate error
+    static constexpr double kUpHeadroom = 1.3;       // estimate margin over the next rung's floor
+    static constexpr double kMinChange = 0.05;       // ignore bitrate jitter below 5%
+
+    IEncoder::Config RungConfig(size_t rung, int bitrate) const;
+
+    std::vector<Rung> rungs_;   // highest first
+    int min_kbps_;
+    int max_kbps_;
+    size_t rung_;
+    IEncoder::Config current_;
+    int64_t below_since_ms_;    // -1 when not below the current floor
+    int64_t above_since_ms_;    // -1 when not above the next rung's floor
+    int64_t last_switch_ms_;
+};
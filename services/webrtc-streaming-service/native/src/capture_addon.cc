@@ -1,130 +1,184 @@
 // capture_addon.cc - N-API bindings with ThreadSafeFunction for frame callbacks
 #include <napi.h>
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <cstring>
+#include <map>
+#include <string>
+#include "bitrate_ladder.h"
+#include "capture_pipeline.h"
+#include "delivery_queue.h"
+#include "frame_buffer_pool.h"
+#include "frame_source.h"
 #include "h264_encoder.h"
+#include "worker_pool.h"
 
-// Capture state
+// Capture session state
 struct CaptureContext {
+    uint32_t id = 0;
     std::unique_ptr<IEncoder> encoder;
-    std::thread capture_thread;
-    std::atomic<bool> should_stop{false};
+    std::unique_ptr<IFrameSource> source;
+    std::unique_ptr<CapturePipeline> pipeline;
+    std::unique_ptr<BitrateLadder> ladder;   // JS thread only
     napi_threadsafe_function tsfn = nullptr;
     IEncoder::Config config;
+    std::shared_ptr<FrameBufferPool> frame_pool;
+    // Shared with the TSFN, which may still drain them after the context is gone
+    std::shared_ptr<DeliveryQueue> queue;
+    std::shared_ptr<PipelineMetrics> metrics;
+    std::atomic<int> frame_count{0};
 };
 
-static std::unique_ptr<CaptureContext> g_context;
-
-// Thread-safe function call data
-struct TSFNCallData {
-    uint8_t* data;
-    size_t size;
+// TSFN context: what the JS thread needs to drain and time delivered frames
+struct JsDelivery {
+    std::shared_ptr<DeliveryQueue> queue;
+    std::shared_ptr<PipelineMetrics> metrics;
 };
 
-// Called on JS thread when TSFN is invoked
-static void CallJs(napi_env env, napi_value js_callback, void* context, void* data) {
-    TSFNCallData* call_data = static_cast<TSFNCallData*>(data);
-    
-    if (call_data && js_callback != nullptr) {
-        napi_value buffer;
+// Concurrent capture sessions by handle. Only touched on the JS thread.
+static std::map<uint32_t, std::unique_ptr<CaptureContext>> g_sessions;
+static uint32_t g_next_session_id = 1;
+
+// Encode workers shared by all sessions; created with the first session and
+// released with the last one
+static std::unique_ptr<WorkerPool> g_encode_pool;
+static size_t g_encode_workers = 0;   // 0 = one worker per kDefaultEncoderThreads cores
+
+// Frames buffered for JS before the drop policy kicks in (~66 ms at 60 fps)
+static constexpr size_t kDefaultQueueSize = 4;
+
+// Lowest bitrate setBandwidthEstimate() will drive the encoder to
+static constexpr int kDefaultMinBitrate = 300;
+
+// x264 threads per session unless the session asks for another count
+static constexpr int kDefaultEncoderThreads = 4;
+
+// Finalizer for external Buffers: returns the slab to its pool once JS drops the Buffer
+static void FinalizeFrameBuffer(napi_env env, void* data, void* hint) {
+    FrameBufferRef::Adopt(static_cast<FrameBuffer*>(hint));
+}
+
+// Passes one encoded frame to the JS callback; the slab itself becomes the Buffer
+static void CallJsWithFrame(napi_env env, napi_value js_callback, PipelineMetrics* metrics,
+                            FrameBufferRef frame) {
+    int64_t now_us = PipelineNowUs();
+    metrics->stages[PipelineMetrics::kDeliver].Record(now_us - frame->EncodedTimeUs());
+    metrics->stages[PipelineMetrics::kTotal].Record(now_us - frame->CaptureTimeUs());
+
+    napi_value buffer;
+    napi_status status = napi_create_external_buffer(env, frame->Size(), frame->Data(),
+                                                     FinalizeFrameBuffer, frame.Get(), &buffer);
+    if (status == napi_ok) {
+        frame.Detach();  // now owned by the Buffer finalizer
+    } else {
+        // Runtimes with a V8 sandbox refuse external buffers; fall back to a copy
         void* buffer_data;
-        
-        // Create Node.js Buffer
-        napi_create_buffer_copy(env, call_data->size, call_data->data, &buffer_data, &buffer);
-        
-        // Call JS callback with buffer
-        napi_value argv[1] = {buffer};
-        napi_value global;
-        napi_get_global(env, &global);
-        napi_call_function(env, global, js_callback, 1, argv, nullptr);
+        if (napi_create_buffer_copy(env, frame->Size(), frame->Data(), &buffer_data, &buffer) != napi_ok) {
+            return;
+        }
     }
-    
-    // Free the data
-    if (call_data) {
-        delete[] call_data->data;
-        delete call_data;
+
+    // Call JS callback with buffer
+    napi_value argv[1] = {buffer};
+    napi_value global;
+    napi_get_global(env, &global);
+    napi_call_function(env, global, js_callback, 1, argv, nullptr);
+}
+
+// Called on JS thread when TSFN is invoked. The TSFN only carries wake-ups;
+// the frames themselves are drained from the delivery queue (TSFN context).
+static void CallJs(napi_env env, napi_value js_callback, void* context, void* data) {
+    JsDelivery* delivery = static_cast<JsDelivery*>(context);
+    DeliveryQueue* queue = delivery->queue.get();
+
+    // env is null when the TSFN is torn down; queued frames are freed with the queue
+    if (env == nullptr || js_callback == nullptr) {
+        return;
+    }
+
+    queue->DisarmWakeup();
+    while (FrameBufferRef frame = queue->Pop()) {
+        CallJsWithFrame(env, js_callback, delivery->metrics.get(), std::move(frame));
     }
 }
 
-// Capture thread function
-static void CaptureThreadFunc(CaptureContext* ctx) {
-    printf("[NativeCaptureAddon] Capture thread started\n");
-    
-    // IMMEDIATE TEST: Send fake NAL to verify TSFN works
-    {
-        uint8_t fake_nal[] = {0x00, 0x00, 0x00, 0x01, 0x09, 0x10}; // AUD NAL
-        TSFNCallData* call_data = new TSFNCallData();
-        call_data->data = new uint8_t[sizeof(fake_nal)];
-        call_data->size = sizeof(fake_nal);
-        memcpy(call_data->data, fake_nal, sizeof(fake_nal));
-        
-        napi_status status = napi_call_threadsafe_function(ctx->tsfn, call_data, napi_tsfn_nonblocking);
-        if (status == napi_ok) {
-            printf("[NativeCaptureAddon] Fake NAL sent via TSFN\n");
-        } else {
-            printf("[NativeCaptureAddon] ERROR: TSFN call failed with status %d\n", status);
-            delete[] call_data->data;
-            delete call_data;
-        }
+// Queues an encoded frame for the JS thread, applying the drop policy when
+// JS falls behind. Returns false if the frame was dropped.
+static bool DeliverFrame(CaptureContext* ctx, FrameBufferRef frame) {
+    bool needs_keyframe = false;
+    DeliveryQueue::PushResult result = ctx->queue->Push(std::move(frame), &needs_keyframe);
+
+    if (needs_keyframe) {
+        // A dropped reference frame broke the decode chain: resync with an IDR
+        ctx->encoder->RequestKeyframe();
     }
-    
-    // Simple test pattern frame (black screen)
-    int frame_size = ctx->config.width * ctx->config.height * 4; // BGRA
-    std::vector<uint8_t> test_frame(frame_size, 0); // All zeros = black
-    
-    auto frame_duration = std::chrono::milliseconds(1000 / ctx->config.fps);
-    int64_t timestamp_ms = 0;
-    int frame_count = 0;
-    
-    while (!ctx->should_stop.load()) {
-        auto frame_start = std::chrono::steady_clock::now();
-        
-        // Encode the test frame
-        std::vector<uint8_t> nal_data = ctx->encoder->Encode(test_frame.data(), timestamp_ms);
-        
-        if (!nal_data.empty()) {
-            // Copy NAL data to heap (will be freed in CallJs)
-            TSFNCallData* call_data = new TSFNCallData();
-            call_data->data = new uint8_t[nal_data.size()];
-            call_data->size = nal_data.size();
-            memcpy(call_data->data, nal_data.data(), nal_data.size());
-            
-            // Send to JS thread via TSFN
-            napi_status status = napi_call_threadsafe_function(ctx->tsfn, call_data, napi_tsfn_nonblocking);
-            if (status != napi_ok) {
-                printf("[NativeCaptureAddon] TSFN call failed for frame %d\n", frame_count);
-                delete[] call_data->data;
-                delete call_data;
-            }
-            
-            frame_count++;
-            if (frame_count % ctx->config.fps == 0) {
-                printf("[NativeCaptureAddon] Sent %d frames (NAL size: %zu bytes)\n", 
-                       frame_count, nal_data.size());
-            }
-        }
-        
-        timestamp_ms += (1000 / ctx->config.fps);
-        
-        // Frame rate limiting
-        auto frame_end = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(frame_end - frame_start);
-        if (elapsed < frame_duration) {
-            std::this_thread::sleep_for(frame_duration - elapsed);
+    if (result == DeliveryQueue::PushResult::kDropped || result == DeliveryQueue::PushResult::kClosed) {
+        return false;
+    }
+
+    if (ctx->queue->ArmWakeup()) {
+        if (napi_call_threadsafe_function(ctx->tsfn, nullptr, napi_tsfn_nonblocking) != napi_ok) {
+            ctx->queue->DisarmWakeup();
         }
     }
-    
-    printf("[NativeCaptureAddon] Capture thread stopped, sent %d frames\n", frame_count);
+    return true;
 }
 
-// TSFN finalize callback
+// IMMEDIATE TEST: Send fake NAL to verify TSFN works
+static void SendTestNal(CaptureContext* ctx) {
+    uint8_t fake_nal[] = {0x00, 0x00, 0x00, 0x01, 0x09, 0x10}; // AUD NAL
+    FrameBufferRef frame = ctx->frame_pool->Acquire(sizeof(fake_nal));
+    memcpy(frame->Data(), fake_nal, sizeof(fake_nal));
+    frame->SetSize(sizeof(fake_nal));
+    int64_t now_us = PipelineNowUs();
+    frame->SetTimes(now_us, now_us);
+
+    if (DeliverFrame(ctx, std::move(frame))) {
+        printf("[NativeCaptureAddon] Fake NAL sent via TSFN\n");
+    } else {
+        printf("[NativeCaptureAddon] ERROR: fake NAL was not queued\n");
+    }
+}
+
+// Pipeline sink, runs on the encode stage thread
+static void OnEncodedFrame(CaptureContext* ctx, FrameBufferRef nal_data) {
+    size_t nal_size = nal_data->Size();
+    int frame_count = ++ctx->frame_count;
+
+    // Send to JS thread via the delivery queue (the slab itself becomes the JS Buffer)
+    if (!DeliverFrame(ctx, std::move(nal_data))) {
+        printf("[NativeCaptureAddon] Session %u: frame %d dropped (%s)\n", ctx->id, frame_count,
+               DropPolicyName(ctx->queue->policy()));
+    }
+
+    if (frame_count % ctx->config.fps == 0) {
+        FrameBufferPool::Stats pool = ctx->frame_pool->GetStats();
+        printf("[NativeCaptureAddon] Session %u: sent %d frames (NAL size: %zu bytes, pool: %zu in flight, %llu slab allocs)\n", 
+               ctx->id, frame_count, nal_size, pool.outstanding,
+               static_cast<unsigned long long>(pool.allocations));
+    }
+}
+
+// TSFN finalize callback: drops the TSFN's references to the queue and metrics
 static void TSFNFinalize(napi_env env, void* finalize_data, void* finalize_hint) {
+    delete static_cast<JsDelivery*>(finalize_data);
     printf("[NativeCaptureAddon] TSFN finalized\n");
 }
 
+// Stops the pipeline, unblocking the encode stage first if the block policy is waiting on JS
+static void StopPipeline(CaptureContext* ctx) {
+    if (ctx->queue) {
+        ctx->queue->Close();
+    }
+    if (ctx->pipeline) {
+        ctx->pipeline->Stop();
+    }
+}
+
 // Start capture
 Napi::Value Start(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
@@ -144,107 +198,459 @@ Napi::Value Start(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    // Stop any existing capture
-    if (g_context) {
-        g_context->should_stop.store(true);
-        if (g_context->capture_thread.joinable()) {
-            g_context->capture_thread.join();
+    // Create new session
+    auto ctx = std::make_unique<CaptureContext>();
+
+    // Extract config
+    Napi::Object config = info[0].As<Napi::Object>();
+    ctx->config.width = config.Get("width").As<Napi::Number>().Int32Value();
+    ctx->config.height = config.Get("height").As<Napi::Number>().Int32Value();
+    ctx->config.fps = config.Get("fps").As<Napi::Number>().Int32Value();
+    ctx->config.bitrate = config.Get("bitrate").As<Napi::Number>().Int32Value();
+    ctx->config.intra_refresh = config.Has("intraRefresh") &&
+                                config.Get("intraRefresh").As<Napi::Boolean>().Value();
+    ctx->config.threads = kDefaultEncoderThreads;
+    if (config.Has("encoderThreads")) {
+        int32_t threads = config.Get("encoderThreads").As<Napi::Number>().Int32Value();
+        if (threads < 1) {
+            Napi::RangeError::New(env, "encoderThreads must be at least 1").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        ctx->config.threads = threads;
+    }
+    if (config.Has("slicedThreads")) {
+        ctx->config.sliced_threads = config.Get("slicedThreads").As<Napi::Boolean>().Value();
+    }
+    if (config.Has("preset")) {
+        ctx->config.preset = config.Get("preset").As<Napi::String>().Utf8Value();
+    }
+
+    // Backpressure: bounded queue between capture thread and JS (optional)
+    size_t queue_size = kDefaultQueueSize;
+    DropPolicy drop_policy = DropPolicy::kDropOldest;
+    if (config.Has("queueSize")) {
+        int32_t requested = config.Get("queueSize").As<Napi::Number>().Int32Value();
+        if (requested < 1) {
+            Napi::RangeError::New(env, "queueSize must be at least 1").ThrowAsJavaScriptException();
+            return env.Undefined();
         }
-        if (g_context->tsfn) {
-            napi_release_threadsafe_function(g_context->tsfn, napi_tsfn_abort);
+        queue_size = static_cast<size_t>(requested);
+    }
+    if (config.Has("dropPolicy")) {
+        std::string name = config.Get("dropPolicy").As<Napi::String>().Utf8Value();
+        if (!ParseDropPolicy(name.c_str(), &drop_policy)) {
+            Napi::TypeError::New(env, "dropPolicy must be 'drop-oldest', 'drop-newest' or 'block'").ThrowAsJavaScriptException();
+            return env.Undefined();
         }
-        g_context.reset();
     }
 
-    // Create new context
-    g_context = std::make_unique<CaptureContext>();
+    // Frame source (optional): { type: 'synthetic', motion } or { type: 'file', path, format, loop }
+    FrameSourceOptions source_options;
+    if (config.Has("source")) {
+        Napi::Object source = config.Get("source").As<Napi::Object>();
+        if (source.Has("type")) {
+            source_options.type = source.Get("type").As<Napi::String>().Utf8Value();
+        }
+        if (source.Has("motion")) {
+            source_options.motion = source.Get("motion").As<Napi::Number>().Int32Value();
+        }
+        if (source.Has("path")) {
+            source_options.path = source.Get("path").As<Napi::String>().Utf8Value();
+        }
+        if (source.Has("format")) {
+            std::string format = source.Get("format").As<Napi::String>().Utf8Value();
+            if (!ParsePixelFormat(format.c_str(), &source_options.format)) {
+                Napi::TypeError::New(env, "source.format must be 'bgra' or 'i420'").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+        }
+        if (source.Has("loop")) {
+            source_options.loop = source.Get("loop").As<Napi::Boolean>().Value();
+        }
+    }
 
-    // Extract config
-    Napi::Object config = info[0].As<Napi::Object>();
-    g_context->config.width = config.Get("width").As<Napi::Number>().Int32Value();
-    g_context->config.height = config.Get("height").As<Napi::Number>().Int32Value();
-    g_context->config.fps = config.Get("fps").As<Napi::Number>().Int32Value();
-    g_context->config.bitrate = config.Get("bitrate").As<Napi::Number>().Int32Value();
+    ctx->source = CreateFrameSource(source_options);
+    if (!ctx->source) {
+        Napi::TypeError::New(env, "source.type must be 'synthetic' or 'file'").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    IFrameSource::Config source_config = { ctx->config.width, ctx->config.height, ctx->config.fps };
+    if (!ctx->source->Initialize(source_config)) {
+        Napi::Error::New(env, "Failed to initialize frame source").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
 
-    // Create TSFN
+    ctx->queue = std::make_shared<DeliveryQueue>(queue_size, drop_policy);
+    ctx->metrics = std::make_shared<PipelineMetrics>();
+
+    // Create TSFN. It only carries wake-ups (at most one outstanding), so its
+    // own queue is bounded to a single entry; frames wait in the delivery queue.
     Napi::Function callback = info[1].As<Napi::Function>();
     napi_value async_resource_name;
     napi_create_string_utf8(env, "NativeCaptureTSFN", NAPI_AUTO_LENGTH, &async_resource_name);
-    
+
+    auto* tsfn_delivery = new JsDelivery{ ctx->queue, ctx->metrics };
     napi_status status = napi_create_threadsafe_function(
         env,
         callback,
         nullptr,  // async_resource
         async_resource_name,
-        0,        // max_queue_size (0 = unlimited)
+        1,        // max_queue_size (wake-ups only)
         1,        // initial_thread_count
-        nullptr,  // thread_finalize_data
+        tsfn_delivery,  // thread_finalize_data
         TSFNFinalize,
-        nullptr,  // context
+        tsfn_delivery,  // context
         CallJs,
-        &g_context->tsfn
+        &ctx->tsfn
     );
 
     if (status != napi_ok) {
+        delete tsfn_delivery;
         Napi::Error::New(env, "Failed to create ThreadSafeFunction").ThrowAsJavaScriptException();
-        g_context.reset();
         return env.Undefined();
     }
 
-    printf("[NativeCaptureAddon] ThreadSafeFunction initialized\n");
+    printf("[NativeCaptureAddon] ThreadSafeFunction initialized (queue %zu, %s)\n",
+           queue_size, DropPolicyName(drop_policy));
 
     // Initialize encoder
-    g_context->encoder = CreateEncoder(false);
-    if (!g_context->encoder->Initialize(g_context->config)) {
-        napi_release_threadsafe_function(g_context->tsfn, napi_tsfn_abort);
+    // Enough slabs for frames in flight to JS; more are allocated only if JS holds on to buffers
+    ctx->frame_pool = FrameBufferPool::Create(8, EncodedFrameSlabSize(ctx->config));
+    ctx->encoder = CreateEncoder(false, ctx->frame_pool);
+    if (!ctx->encoder->Initialize(ctx->config)) {
+        napi_release_threadsafe_function(ctx->tsfn, napi_tsfn_abort);
         Napi::Error::New(env, "Failed to initialize encoder").ThrowAsJavaScriptException();
-        g_context.reset();
         return env.Undefined();
     }
 
-    printf("[NativeCaptureAddon] Encoder initialized: %dx%d @ %dfps, %dkbps\n", 
-           g_context->config.width, g_context->config.height, 
-           g_context->config.fps, g_context->config.bitrate);
+    printf("[NativeCaptureAddon] Encoder initialized: %dx%d @ %dfps, %dkbps%s\n", 
+           ctx->config.width, ctx->config.height, 
+           ctx->config.fps, ctx->config.bitrate,
+           ctx->config.intra_refresh ? ", intra refresh" : "");
 
-    // Start capture thread
-    g_context->should_stop.store(false);
-    g_context->capture_thread = std::thread(CaptureThreadFunc, g_context.get());
+    SendTestNal(ctx.get());
 
-    return env.Undefined();
+    // Bandwidth-driven bitrate (and optionally resolution / frame rate) control
+    int min_bitrate = kDefaultMinBitrate;
+    if (config.Has("minBitrate")) {
+        min_bitrate = config.Get("minBitrate").As<Napi::Number>().Int32Value();
+    }
+    bool adapt_resolution = config.Has("adaptiveResolution") &&
+                            config.Get("adaptiveResolution").As<Napi::Boolean>().Value();
+    ctx->ladder = std::make_unique<BitrateLadder>(ctx->config, min_bitrate, adapt_resolution);
+
+    if (!g_encode_pool) {
+        size_t workers = g_encode_workers;
+        if (workers == 0) {
+            workers = std::max<size_t>(1, std::thread::hardware_concurrency() / kDefaultEncoderThreads);
+        }
+        g_encode_pool = std::make_unique<WorkerPool>(workers);
+    }
+
+    // Start capture -> convert -> encode pipeline
+    CaptureContext* session = ctx.get();
+    session->id = g_next_session_id++;
+    session->pipeline = std::make_unique<CapturePipeline>(
+        session->source.get(), session->encoder.get(), session->config, session->metrics,
+        [session](FrameBufferRef frame) { OnEncodedFrame(session, std::move(frame)); },
+        g_encode_pool.get());
+    session->pipeline->Start();
+    g_sessions[session->id] = std::move(ctx);
+
+    printf("[NativeCaptureAddon] Session %u started (%zu active)\n", session->id, g_sessions.size());
+    return Napi::Number::New(env, session->id);
+}
+
+static void StopSession(CaptureContext* ctx) {
+    printf("[NativeCaptureAddon] Stopping session %u...\n", ctx->id);
+    StopPipeline(ctx);
+    
+    if (ctx->encoder) {
+        ctx->encoder->Cleanup();
+    }
+    if (ctx->source) {
+        ctx->source->Cleanup();
+    }
+    
+    if (ctx->tsfn) {
+        napi_release_threadsafe_function(ctx->tsfn, napi_tsfn_release);
+        ctx->tsfn = nullptr;
+    }
+    printf("[NativeCaptureAddon] Session %u stopped\n", ctx->id);
 }
 
-// Stop capture
+// Stop one session, or every session when called without a handle
 Napi::Value Stop(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
-    if (g_context) {
-        printf("[NativeCaptureAddon] Stopping capture...\n");
-        g_context->should_stop.store(true);
-        
-        if (g_context->capture_thread.joinable()) {
-            g_context->capture_thread.join();
-        }
-        
-        if (g_context->encoder) {
-            g_context->encoder->Cleanup();
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        auto it = g_sessions.find(info[0].As<Napi::Number>().Uint32Value());
+        if (it != g_sessions.end()) {
+            StopSession(it->second.get());
+            g_sessions.erase(it);
         }
-        
-        if (g_context->tsfn) {
-            napi_release_threadsafe_function(g_context->tsfn, napi_tsfn_release);
-            g_context->tsfn = nullptr;
+    } else {
+        for (auto& entry : g_sessions) {
+            StopSession(entry.second.get());
         }
-        
-        g_context.reset();
-        printf("[NativeCaptureAddon] Stopped\n");
+        g_sessions.clear();
     }
 
+    if (g_sessions.empty()) {
+        g_encode_pool.reset();
+    }
+
+    return env.Undefined();
+}
+
+// Session for the handle in the first argument; null if missing or already stopped
+static CaptureContext* FindSession(const Napi::CallbackInfo& info) {
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(info.Env(), "Expected session handle").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+    auto it = g_sessions.find(info[0].As<Napi::Number>().Uint32Value());
+    return it != g_sessions.end() ? it->second.get() : nullptr;
+}
+
+// Sizes the shared encode worker pool. Only allowed while no session is running.
+Napi::Value SetEncodeWorkers(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        Napi::TypeError::New(env, "Expected worker count").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!g_sessions.empty()) {
+        Napi::Error::New(env, "Encode workers can only be changed while no session is running").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    int32_t workers = info[0].As<Napi::Number>().Int32Value();
+    g_encode_workers = workers > 0 ? static_cast<size_t>(workers) : 0;
+
     return env.Undefined();
 }
 
+static Napi::Object EncoderConfigToObject(Napi::Env env, const IEncoder::Config& config) {
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("width", Napi::Number::New(env, config.width));
+    result.Set("height", Napi::Number::New(env, config.height));
+    result.Set("fps", Napi::Number::New(env, config.fps));
+    result.Set("bitrate", Napi::Number::New(env, config.bitrate));
+    return result;
+}
+
+// Sends new encoder settings to the encode thread and paces capture to match
+static bool ApplyEncoderConfig(CaptureContext* ctx, const IEncoder::Config& config) {
+    if (!ctx->encoder->Reconfigure(config)) {
+        return false;
+    }
+    ctx->pipeline->SetFrameRate(config.fps);
+    return true;
+}
+
+// Feeds a bandwidth estimate (kbps, e.g. from GCC / TWCC feedback) to the
+// ladder controller; returns the encoder settings now in effect
+Napi::Value SetBandwidthEstimate(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    CaptureContext* ctx = FindSession(info);
+    if (!ctx || !ctx->ladder) {
+        return env.Undefined();
+    }
+    if (info.Length() < 2 || !info[1].IsNumber()) {
+        Napi::TypeError::New(env, "Expected bandwidth estimate in kbps").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    int estimate_kbps = info[1].As<Napi::Number>().Int32Value();
+    BitrateLadder::Decision decision = ctx->ladder->Update(estimate_kbps, PipelineNowUs() / 1000);
+    if (decision.changed) {
+        ApplyEncoderConfig(ctx, decision.config);
+    }
+
+    Napi::Object result = EncoderConfigToObject(env, decision.config);
+    result.Set("rung", Napi::Number::New(env, static_cast<double>(ctx->ladder->CurrentRung())));
+    result.Set("changed", Napi::Boolean::New(env, decision.changed));
+    result.Set("restarted", Napi::Boolean::New(env, decision.rung_changed));
+    return result;
+}
+
+// Explicit encoder settings: { bitrate?, width?, height?, fps? }. Resolution
+// and frame rate may not exceed the capture format.
+Napi::Value Reconfigure(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    CaptureContext* ctx = FindSession(info);
+    if (!ctx || !ctx->encoder) {
+        return env.Undefined();
+    }
+    if (info.Length() < 2 || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected encoder settings object").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::Object settings = info[1].As<Napi::Object>();
+    IEncoder::Config config = ctx->ladder->Current();
+    if (settings.Has("bitrate")) {
+        config.bitrate = settings.Get("bitrate").As<Napi::Number>().Int32Value();
+    }
+    if (settings.Has("width")) {
+        config.width = settings.Get("width").As<Napi::Number>().Int32Value();
+    }
+    if (settings.Has("height")) {
+        config.height = settings.Get("height").As<Napi::Number>().Int32Value();
+    }
+    if (settings.Has("fps")) {
+        config.fps = settings.Get("fps").As<Napi::Number>().Int32Value();
+    }
+
+    if (config.width > ctx->config.width || config.height > ctx->config.height ||
+        config.fps > ctx->config.fps) {
+        Napi::RangeError::New(env, "Encoder settings exceed the capture format").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!ApplyEncoderConfig(ctx, config)) {
+        Napi::RangeError::New(env, "Invalid encoder settings (dimensions must be even and positive)").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    // Keep the ladder on the new settings, or its next step would undo them
+    ctx->ladder->Override(config, PipelineNowUs() / 1000);
+
+    Napi::Object result = EncoderConfigToObject(env, config);
+    result.Set("rung", Napi::Number::New(env, static_cast<double>(ctx->ladder->CurrentRung())));
+    return result;
+}
+
+// Forces an IDR on the next frame (receiver sent PLI / FIR)
+Napi::Value RequestKeyframe(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    CaptureContext* ctx = FindSession(info);
+    if (ctx && ctx->encoder) {
+        ctx->encoder->RequestKeyframe();
+    }
+
+    return env.Undefined();
+}
+
+// Delivery queue counters
+Napi::Value GetDeliveryStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    CaptureContext* ctx = FindSession(info);
+    if (!ctx || !ctx->queue) {
+        return env.Undefined();
+    }
+
+    DeliveryQueue::Stats stats = ctx->queue->GetStats();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("queued", Napi::Number::New(env, static_cast<double>(stats.queued)));
+    result.Set("delivered", Napi::Number::New(env, static_cast<double>(stats.delivered)));
+    result.Set("dropped", Napi::Number::New(env, static_cast<double>(stats.dropped)));
+    result.Set("keyframeRequests", Napi::Number::New(env, static_cast<double>(stats.keyframe_requests)));
+    result.Set("depth", Napi::Number::New(env, static_cast<double>(stats.depth)));
+    result.Set("maxDepth", Napi::Number::New(env, static_cast<double>(stats.max_depth)));
+    result.Set("capacity", Napi::Number::New(env, static_cast<double>(stats.capacity)));
+    result.Set("dropPolicy", Napi::String::New(env, DropPolicyName(ctx->queue->policy())));
+    return result;
+}
+
+// Per-stage latency percentiles and pipeline counters
+Napi::Value GetPipelineStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    CaptureContext* ctx = FindSession(info);
+    if (!ctx || !ctx->metrics) {
+        return env.Undefined();
+    }
+
+    PipelineMetrics* metrics = ctx->metrics.get();
+    Napi::Object stages = Napi::Object::New(env);
+    for (int i = 0; i < PipelineMetrics::kStageCount; i++) {
+        LatencyHistogram::Summary summary = metrics->stages[i].Summarize();
+        Napi::Object stage = Napi::Object::New(env);
+        stage.Set("count", Napi::Number::New(env, static_cast<double>(summary.count)));
+        stage.Set("meanUs", Napi::Number::New(env, summary.mean_us));
+        stage.Set("p50Us", Napi::Number::New(env, static_cast<double>(summary.p50_us)));
+        stage.Set("p90Us", Napi::Number::New(env, static_cast<double>(summary.p90_us)));
+        stage.Set("p99Us", Napi::Number::New(env, static_cast<double>(summary.p99_us)));
+        stage.Set("maxUs", Napi::Number::New(env, static_cast<double>(summary.max_us)));
+        stages.Set(PipelineMetrics::StageName(i), stage);
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("framesCaptured", Napi::Number::New(env, static_cast<double>(metrics->frames_captured.load())));
+    result.Set("framesEncoded", Napi::Number::New(env, static_cast<double>(metrics->frames_encoded.load())));
+    result.Set("captureOverruns", Napi::Number::New(env, static_cast<double>(metrics->capture_overruns.load())));
+    result.Set("lateTicks", Napi::Number::New(env, static_cast<double>(metrics->late_ticks.load())));
+    result.Set("sourceEnded", Napi::Boolean::New(env, metrics->source_ended.load()));
+    result.Set("stages", stages);
+
+    // Encoded size distribution per frame type, to check for IDR spikes
+    Napi::Object frame_sizes = Napi::Object::New(env);
+    for (int i = 0; i < PipelineMetrics::kFrameKindCount; i++) {
+        LatencyHistogram::Summary summary = metrics->frame_bytes[i].Summarize();
+        Napi::Object kind = Napi::Object::New(env);
+        kind.Set("count", Napi::Number::New(env, static_cast<double>(summary.count)));
+        kind.Set("meanBytes", Napi::Number::New(env, summary.mean_us));
+        kind.Set("p50Bytes", Napi::Number::New(env, static_cast<double>(summary.p50_us)));
+        kind.Set("p90Bytes", Napi::Number::New(env, static_cast<double>(summary.p90_us)));
+        kind.Set("p99Bytes", Napi::Number::New(env, static_cast<double>(summary.p99_us)));
+        kind.Set("maxBytes", Napi::Number::New(env, static_cast<double>(summary.max_us)));
+        frame_sizes.Set(PipelineMetrics::FrameKindName(i), kind);
+    }
+    result.Set("frameSizes", frame_sizes);
+    return result;
+}
+
+// Drains the per-frame encode telemetry recorded since the last call
+Napi::Value GetStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    CaptureContext* ctx = FindSession(info);
+    if (!ctx || !ctx->metrics) {
+        return env.Undefined();
+    }
+
+    std::vector<FrameTelemetry> records;
+    ctx->metrics->telemetry.Drain(&records);
+
+    Napi::Array frames = Napi::Array::New(env, records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        const FrameTelemetry& record = records[i];
+        Napi::Object frame = Napi::Object::New(env);
+        frame.Set("frame", Napi::Number::New(env, static_cast<double>(record.frame_number)));
+        frame.Set("timestamp", Napi::Number::New(env, static_cast<double>(record.timestamp_ms)));
+        frame.Set("captureUs", Napi::Number::New(env, static_cast<double>(record.capture_us)));
+        frame.Set("captureQueueUs", Napi::Number::New(env, record.capture_queue_us));
+        frame.Set("convertUs", Napi::Number::New(env, record.convert_us));
+        frame.Set("encodeQueueUs", Napi::Number::New(env, record.encode_queue_us));
+        frame.Set("encodeUs", Napi::Number::New(env, record.encode_us));
+        frame.Set("bytes", Napi::Number::New(env, record.bytes));
+        frame.Set("nalTypes", Napi::Number::New(env, record.nal_types));
+        frame.Set("qp", Napi::Number::New(env, record.qp));
+        frame.Set("type", Napi::String::New(env, FrameTypeName(record.type)));
+        frames.Set(static_cast<uint32_t>(i), frame);
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("frames", frames);
+    result.Set("overflows", Napi::Number::New(env, static_cast<double>(ctx->metrics->telemetry.Overflows())));
+    return result;
+}
+
 // Module initialization
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports.Set(Napi::String::New(env, "start"), Napi::Function::New(env, Start));
     exports.Set(Napi::String::New(env, "stop"), Napi::Function::New(env, Stop));
+    exports.Set(Napi::String::New(env, "getDeliveryStats"), Napi::Function::New(env, GetDeliveryStats));
+    exports.Set(Napi::String::New(env, "getPipelineStats"), Napi::Function::New(env, GetPipelineStats));
+    exports.Set(Napi::String::New(env, "getStats"), Napi::Function::New(env, GetStats));
+    exports.Set(Napi::String::New(env, "setEncodeWorkers"), Napi::Function::New(env, SetEncodeWorkers));
+    exports.Set(Napi::String::New(env, "setBandwidthEstimate"), Napi::Function::New(env, SetBandwidthEstimate));
+    exports.Set(Napi::String::New(env, "reconfigure"), Napi::Function::New(env, Reconfigure));
+    exports.Set(Napi::String::New(env, "requestKeyframe"), Napi::Function::New(env, RequestKeyframe));
 
     printf("[NativeCaptureAddon] Module initialized\n");
 
@@ -0,0 +1,291 @@
+// capture_pipeline.cc - Pipelined capture -> convert -> encode worker graph
+
+#include "capture_pipeline.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Idle stage threads re-check the stop flag at least this often
+static constexpr std::chrono::microseconds kStageWaitTimeout(5000);
+
+int64_t PipelineNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* PipelineMetrics::StageName(int stage) {
+    switch (stage) {
+        case kCaptureQueue: return "captureQueue";
+        case kConvert: return "convert";
+        case kEncodeQueue: return "encodeQueue";
+        case kEncode: return "encode";
+        case kDeliver: return "deliver";
+        case kTotal: return "total";
+        default: return "unknown";
+    }
+}
+
+const char* PipelineMetrics::FrameKindName(int kind) {
+    switch (kind) {
+        case kKeyframe: return "keyframe";
+        case kDeltaFrame: return "delta";
+        default: return "unknown";
+    }
+}
+
+CapturePipeline::CapturePipeline(IFrameSource* source, IEncoder* encoder, const IEncoder::Config& config,
+                                 std::shared_ptr<PipelineMetrics> metrics, FrameSink sink,
+                                 WorkerPool* encode_pool)
+    : source_(source), source_format_(source->Format()), encoder_(encoder), config_(config),
+      metrics_(std::move(metrics)), sink_(std::move(sink)), encode_pool_(encode_pool),
+      target_fps_(config.fps) {
+    size_t source_size = FrameSize(source_format_, config.width, config.height);
+    int chroma_width = (config.width + 1) / 2;
+    int chroma_height = (config.height + 1) / 2;
+    size_t luma_size = static_cast<size_t>(config.width) * config.height;
+    size_t chroma_size = static_cast<size_t>(chroma_width) * chroma_height;
+
+    for (size_t i = 0; i < kSlotCount; i++) {
+        auto slot = std::make_unique<SourceSlot>();
+        slot->pixels.resize(source_size);
+        source_free_.TryPush(slot.get());
+        source_slots_.push_back(std::move(slot));
+
+        auto i420 = std::make_unique<I420Slot>();
+        i420->pixels.resize(luma_size + 2 * chroma_size);
+        i420->image.planes[0] = i420->pixels.data();
+        i420->image.planes[1] = i420->pixels.data() + luma_size;
+        i420->image.planes[2] = i420->pixels.data() + luma_size + chroma_size;
+        i420->image.strides[0] = config.width;
+        i420->image.strides[1] = chroma_width;
+        i420->image.strides[2] = chroma_width;
+        i420->image.width = config.width;
+        i420->image.height = config.height;
+        i420_free_.TryPush(i420.get());
+        i420_slots_.push_back(std::move(i420));
+    }
+}
+
+CapturePipeline::~CapturePipeline() {
+    Stop();
+}
+
+void CapturePipeline::Start() {
+    should_stop_.store(false);
+    if (!encode_pool_) {
+        encode_thread_ = std::thread(&CapturePipeline::EncodeLoop, this);
+    }
+    convert_thread_ = std::thread(&CapturePipeline::ConvertLoop, this);
+    capture_thread_ = std::thread(&CapturePipeline::CaptureLoop, this);
+}
+
+void CapturePipeline::Stop() {
+    {
+        // Under the job lock so no pooled job is scheduled after this
+        std::lock_guard<std::mutex> lock(encode_job_mutex_);
+        should_stop_.store(true);
+    }
+    convert_signal_.Notify();
+    encode_signal_.Notify();
+
+    // Upstream first so downstream stages see no new work
+    if (capture_thread_.joinable()) {
+        capture_thread_.join();
+    }
+    if (convert_thread_.joinable()) {
+        convert_thread_.join();
+    }
+    if (encode_thread_.joinable()) {
+        encode_thread_.join();
+    }
+
+    // A pooled job may still be queued or running; it sees should_stop_ and finishes
+    std::unique_lock<std::mutex> lock(encode_job_mutex_);
+    encode_job_done_.wait(lock, [this] { return !encode_scheduled_; });
+}
+
+void CapturePipeline::SetFrameRate(int fps) {
+    target_fps_.store(fps < config_.fps ? fps : config_.fps);
+}
+
+// Paces on absolute steady_clock deadlines so scheduling jitter does not
+// accumulate into drift. If the thread falls more than a frame behind, the
+// missed ticks are skipped instead of being captured in a burst.
+void CapturePipeline::CaptureLoop() {
+    printf("[CapturePipeline] Capture stage started\n");
+
+    const auto interval = std::chrono::nanoseconds(1000000000LL / config_.fps);
+    auto deadline = std::chrono::steady_clock::now();
+    int64_t frame_index = 0;
+    // Frame-rate decimation: each tick earns target_fps credits and a capture
+    // costs config_.fps, which spreads the kept ticks evenly
+    int credit = config_.fps;
+
+    while (!should_stop_.load()) {
+        std::this_thread::sleep_until(deadline);
+        if (should_stop_.load()) {
+            break;
+        }
+
+        credit = std::min(credit + target_fps_.load(std::memory_order_relaxed), config_.fps);
+        if (credit >= config_.fps) {
+            SourceSlot* slot;
+            if (source_free_.TryPop(slot)) {
+                credit -= config_.fps;
+                slot->timestamp_ms = frame_index * 1000 / config_.fps;
+                slot->capture_us = PipelineNowUs();
+                if (!source_->Capture(slot->pixels.data(), slot->timestamp_ms)) {
+                    source_free_.TryPush(slot);
+                    metrics_->source_ended.store(true);
+                    printf("[CapturePipeline] Frame source ended\n");
+                    break;
+                }
+                source_ready_.TryPush(slot);
+                convert_signal_.Notify();
+                metrics_->frames_captured.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                // Conversion is behind and every slot is in use: skip this frame
+                metrics_->capture_overruns.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        frame_index++;
+        deadline += interval;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - deadline > interval) {
+            int64_t missed = (now - deadline) / interval;
+            deadline += interval * missed;
+            frame_index += missed;
+            metrics_->late_ticks.fetch_add(static_cast<uint64_t>(missed), std::memory_order_relaxed);
+        }
+    }
+
+    printf("[CapturePipeline] Capture stage stopped after %lld frames\n",
+           static_cast<long long>(frame_index));
+}
+
+void CapturePipeline::ConvertLoop() {
+    SourceSlot* input = nullptr;
+
+    while (!should_stop_.load()) {
+        uint64_t epoch = convert_signal_.Epoch();
+
+        if (!input && !source_ready_.TryPop(input)) {
+            convert_signal_.Wait(epoch, kStageWaitTimeout);
+            continue;
+        }
+
+        I420Slot* output;
+        if (!i420_free_.TryPop(output)) {
+            // Encoder still holds every I420 slot; keep the input and wait for one
+            convert_signal_.Wait(epoch, kStageWaitTimeout);
+            continue;
+        }
+
+        int64_t start_us = PipelineNowUs();
+        metrics_->stages[PipelineMetrics::kCaptureQueue].Record(start_us - input->capture_us);
+
+        if (source_format_ == PixelFormat::kI420) {
+            // Same tightly packed plane layout as the slot, nothing to convert
+            memcpy(output->pixels.data(), input->pixels.data(), output->pixels.size());
+        } else {
+            ConvertBGRAToI420(input->pixels.data(), config_.width * 4,
+                              output->image.planes[0], output->image.strides[0],
+                              output->image.planes[1], output->image.strides[1],
+                              output->image.planes[2], output->image.strides[2],
+                              config_.width, config_.height);
+        }
+
+        output->timestamp_ms = input->timestamp_ms;
+        output->capture_us = input->capture_us;
+        output->convert_start_us = start_us;
+        output->converted_us = PipelineNowUs();
+        metrics_->stages[PipelineMetrics::kConvert].Record(output->converted_us - start_us);
+
+        source_free_.TryPush(input);
+        input = nullptr;
+        i420_ready_.TryPush(output);
+        if (encode_pool_) {
+            ScheduleEncode();
+        } else {
+            encode_signal_.Notify();
+        }
+    }
+}
+
+void CapturePipeline::EncodeLoop() {
+    while (!should_stop_.load()) {
+        uint64_t epoch = encode_signal_.Epoch();
+
+        I420Slot* slot;
+        if (!i420_ready_.TryPop(slot)) {
+            encode_signal_.Wait(epoch, kStageWaitTimeout);
+            continue;
+        }
+        EncodeSlot(slot);
+    }
+}
+
+void CapturePipeline::ScheduleEncode() {
+    std::lock_guard<std::mutex> lock(encode_job_mutex_);
+    if (encode_scheduled_ || should_stop_.load()) {
+        return;
+    }
+    encode_scheduled_ = true;
+    encode_pool_->Submit([this] { EncodeJob(); });
+}
+
+// One frame per job, so sessions sharing the pool take turns. Successive jobs
+// may run on different workers; the job lock orders their ring accesses.
+void CapturePipeline::EncodeJob() {
+    I420Slot* slot;
+    if (!should_stop_.load() && i420_ready_.TryPop(slot)) {
+        EncodeSlot(slot);
+    }
+
+    std::lock_guard<std::mutex> lock(encode_job_mutex_);
+    if (!should_stop_.load() && i420_ready_.SizeApprox() > 0) {
+        encode_pool_->Submit([this] { EncodeJob(); });
+        return;
+    }
+    encode_scheduled_ = false;
+    encode_job_done_.notify_all();
+}
+
+void CapturePipeline::EncodeSlot(I420Slot* slot) {
+    int64_t start_us = PipelineNowUs();
+    metrics_->stages[PipelineMetrics::kEncodeQueue].Record(start_us - slot->converted_us);
+
+    FrameBufferRef frame = encoder_->EncodeI420(slot->image, slot->timestamp_ms);
+
+    int64_t encoded_us = PipelineNowUs();
+    metrics_->stages[PipelineMetrics::kEncode].Record(encoded_us - start_us);
+
+    FrameTelemetry record;
+    record.timestamp_ms = slot->timestamp_ms;
+    record.capture_us = slot->capture_us;
+    record.capture_queue_us = static_cast<int32_t>(slot->convert_start_us - slot->capture_us);
+    record.convert_us = static_cast<int32_t>(slot->converted_us - slot->convert_start_us);
+    record.encode_queue_us = static_cast<int32_t>(start_us - slot->converted_us);
+    record.encode_us = static_cast<int32_t>(encoded_us - start_us);
+
+    // x264 has copied the picture, so the slot can go straight back to the converter
+    i420_free_.TryPush(slot);
+    convert_signal_.Notify();
+
+    if (!frame.empty()) {
+        const IEncoder::FrameInfo& info = encoder_->LastFrameInfo();
+        record.frame_number = metrics_->frames_encoded.fetch_add(1, std::memory_order_relaxed);
+        record.bytes = static_cast<uint32_t>(frame->Size());
+        record.nal_types = info.nal_types;
+        record.qp = static_cast<int16_t>(info.qp);
+        record.type = info.type;
+        metrics_->telemetry.Record(record);
+
+        frame->SetTimes(record.capture_us, encoded_us);
+        int kind = frame->IsKeyframe() ? PipelineMetrics::kKeyframe : PipelineMetrics::kDeltaFrame;
+        metrics_->frame_bytes[kind].Record(static_cast<int64_t>(frame->Size()));
+        sink_(std::move(frame));
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "color_convert.h"
+#include "encode_telemetry.h"
+#include "frame_buffer_pool.h"
+#include "frame_source.h"
+#include "h264_encoder.h"
+#include "latency_histogram.h"
+#include "spsc_ring.h"
+#include "worker_pool.h"
+
+// steady_clock in microseconds, the time base of all pipeline timestamps
+int64_t PipelineNowUs();
+
+// Per-stage latency histograms and counters. Shared with the JS delivery path,
+// which records the final "deliver" and "total" stages.
+struct PipelineMetrics {
+    enum Stage {
+        kCaptureQueue,   // captured -> conversion starts
+        kConvert,        // BGRA -> I420
+        kEncodeQueue,    // converted -> encoding starts
+        kEncode,         // x264
+        kDeliver,        // encoded -> JS callback
+        kTotal,          // captured -> JS callback
+        kStageCount,
+    };
+
+    enum FrameKind {
+        kKeyframe,       // IDR
+        kDeltaFrame,     // P (including intra refresh frames)
+        kFrameKindCount,
+    };
+
+    static const char* StageName(int stage);
+    static const char* FrameKindName(int kind);
+
+    LatencyHistogram stages[kStageCount];
+    LatencyHistogram frame_bytes[kFrameKindCount];   // encoded size distribution per frame type
+    EncodeTelemetry telemetry;                       // per-frame records, drained by getStats()
+    std::atomic<uint64_t> frames_captured{0};
+    std::atomic<uint64_t> frames_encoded{0};
+    std::atomic<uint64_t> capture_overruns{0};  // no free source slot, frame skipped
+    std::atomic<uint64_t> late_ticks{0};        // capture deadlines missed entirely
+    std::atomic<bool> source_ended{false};      // frame source ran out (non-looping file)
+};
+
+// capture -> convert -> encode worker graph. Each stage runs on its own
+// thread and the stages are joined by lock-free SPSC rings of preallocated
+// frame slots, so frame N+1 is converted while frame N is being encoded.
+// Encoded frames are handed to the sink on the encode thread.
+//
+// With an encode pool the pipeline has no encode thread of its own: each
+// converted frame becomes one job on the shared pool, with at most one job
+// per pipeline in flight so frames stay in order. A sink that blocks (the
+// "block" drop policy) holds its worker for that long.
+class CapturePipeline {
+public:
+    using FrameSink = std::function<void(FrameBufferRef frame)>;
+
+    // source must already be initialized at the encoder's resolution.
+    // encode_pool is optional and must outlive the pipeline.
+    CapturePipeline(IFrameSource* source, IEncoder* encoder, const IEncoder::Config& config,
+                    std::shared_ptr<PipelineMetrics> metrics, FrameSink sink,
+                    WorkerPool* encode_pool = nullptr);
+    ~CapturePipeline();
+
+    CapturePipeline(const CapturePipeline&) = delete;
+    CapturePipeline& operator=(const CapturePipeline&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Captures only enough ticks to feed the encoder at fps (at most the
+    // capture rate) instead of converting frames it would not use
+    void SetFrameRate(int fps);
+
+private:
+    static constexpr size_t kSlotCount = 3;
+    static constexpr size_t kRingSize = 4;   // power of two >= kSlotCount
+
+    // Raw source frame (BGRA, or I420 for sources that produce it natively)
+    struct SourceSlot {
+        std::vector<uint8_t> pixels;
+        int64_t timestamp_ms;
+        int64_t capture_us;
+    };
+
+    struct I420Slot {
+        std::vector<uint8_t> pixels;
+        I420Image image;
+        int64_t timestamp_ms;
+        int64_t capture_us;
+        int64_t convert_start_us;
+        int64_t converted_us;
+    };
+
+    void CaptureLoop();
+    void ConvertLoop();
+    void EncodeLoop();
+    void EncodeSlot(I420Slot* slot);
+
+    // Pooled encoding
+    void ScheduleEncode();
+    void EncodeJob();
+
+    IFrameSource* source_;
+    PixelFormat source_format_;
+    IEncoder* encoder_;
+    IEncoder::Config config_;
+    std::shared_ptr<PipelineMetrics> metrics_;
+    FrameSink sink_;
+    WorkerPool* encode_pool_;
+
+    std::vector<std::unique_ptr<SourceSlot>> source_slots_;
+    std::vector<std::unique_ptr<I420Slot>> i420_slots_;
+
+    // capture -> convert, and back
+    SpscRing<SourceSlot*, kRingSize> source_ready_;
+    SpscRing<SourceSlot*, kRingSize> source_free_;
+    // convert -> encode, and back
+    SpscRing<I420Slot*, kRingSize> i420_ready_;
+    SpscRing<I420Slot*, kRingSize> i420_free_;
+
+    StageSignal convert_signal_;   // source_ready_ or i420_free_ gained an entry
+    StageSignal encode_signal_;    // i420_ready_ gained an entry
+
+    std::atomic<int> target_fps_;
+    std::atomic<bool> should_stop_{false};
+
+    // Guards the pooled encode job: set while one is queued or running
+    std::mutex encode_job_mutex_;
+    std::condition_variable encode_job_done_;
+    bool encode_scheduled_ = false;
+
+    std::thread capture_thread_;
+    std::thread convert_thread_;
+    std::thread encode_thread_;
+};
@@ -0,0 +1,353 @@
+// color_convert.cc - BGRA -> I420 conversion kernels (scalar / SSE2 / AVX2)
+// The SIMD paths are chosen at runtime and must stay bit-exact with the scalar reference
+
+#include "color_convert.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COLOR_CONVERT_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(COLOR_CONVERT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define COLOR_CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define COLOR_CONVERT_TARGET_AVX2
+#endif
+
+namespace {
+
+// Fixed-point BT.601 coefficients (8 fractional bits)
+constexpr int kYR = 77, kYG = 150, kYB = 29;
+constexpr int kUR = -43, kUG = -85, kUB = 128;
+constexpr int kVR = 128, kVG = -107, kVB = -21;
+
+inline uint8_t LumaScalar(int b, int g, int r) {
+    return static_cast<uint8_t>((kYR * r + kYG * g + kYB * b) >> 8);
+}
+
+// Converts columns [x_begin, width) of one pair of source rows. x_begin must be even.
+// s1/y1 may alias s0/y0 for the last row of an odd-height frame; the last column of
+// an odd-width frame is replicated into its chroma block.
+void ConvertRowPairScalar(const uint8_t* s0, const uint8_t* s1,
+                          uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                          int x_begin, int width) {
+    for (int x = x_begin; x < width; x += 2) {
+        int x1 = (x + 1 < width) ? x + 1 : x;
+        const uint8_t* p00 = s0 + x * 4;
+        const uint8_t* p01 = s0 + x1 * 4;
+        const uint8_t* p10 = s1 + x * 4;
+        const uint8_t* p11 = s1 + x1 * 4;
+
+        y0[x] = LumaScalar(p00[0], p00[1], p00[2]);
+        y1[x] = LumaScalar(p10[0], p10[1], p10[2]);
+        if (x1 != x) {
+            y0[x1] = LumaScalar(p01[0], p01[1], p01[2]);
+            y1[x1] = LumaScalar(p11[0], p11[1], p11[2]);
+        }
+
+        // 2x2 box filter with rounding
+        int b = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+        int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+        int r = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+
+        u[x / 2] = static_cast<uint8_t>(((kUR * r + kUG * g + kUB * b) >> 8) + 128);
+        v[x / 2] = static_cast<uint8_t>(((kVR * r + kVG * g + kVB * b) >> 8) + 128);
+    }
+}
+
+// Walks the frame in row pairs and hands each pair to a row kernel
+template <typename RowPairFn>
+void ForEachRowPair(const uint8_t* bgra, int bgra_stride,
+                    uint8_t* y, int y_stride,
+                    uint8_t* u, int u_stride,
+                    uint8_t* v, int v_stride,
+                    int width, int height, RowPairFn row_pair) {
+    for (int row = 0; row < height; row += 2) {
+        int row1 = (row + 1 < height) ? row + 1 : row;
+        row_pair(bgra + static_cast<intptr_t>(row) * bgra_stride,
+                 bgra + static_cast<intptr_t>(row1) * bgra_stride,
+                 y + static_cast<intptr_t>(row) * y_stride,
+                 y + static_cast<intptr_t>(row1) * y_stride,
+                 u + static_cast<intptr_t>(row / 2) * u_stride,
+                 v + static_cast<intptr_t>(row / 2) * v_stride,
+                 width);
+    }
+}
+
+void BGRAToI420Scalar(const uint8_t* bgra, int bgra_stride,
+                      uint8_t* y, int y_stride,
+                      uint8_t* u, int u_stride,
+                      uint8_t* v, int v_stride,
+                      int width, int height) {
+    ForEachRowPair(bgra, bgra_stride, y, y_stride, u, u_stride, v, v_stride, width, height,
+        [](const uint8_t* s0, const uint8_t* s1, uint8_t* y0, uint8_t* y1,
+           uint8_t* u_row, uint8_t* v_row, int w) {
+            ConvertRowPairScalar(s0, s1, y0, y1, u_row, v_row, 0, w);
+        });
+}
+
+#if defined(COLOR_CONVERT_X86)
+
+// ---------------------------------------------------------------------------
+// SSE2: 16 pixels x 2 rows per iteration
+// ---------------------------------------------------------------------------
+
+// Splits 8 BGRA pixels into 16-bit B, G, R lanes
+inline void DeinterleaveSSE2(__m128i p0, __m128i p1, __m128i& b, __m128i& g, __m128i& r) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+                        _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+                        _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+// Sum fits in 16 unsigned bits, so wrapping adds + logical shift are exact
+inline __m128i LumaSSE2(__m128i b, __m128i g, __m128i r) {
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(kYR)),
+                                _mm_mullo_epi16(g, _mm_set1_epi16(kYG)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(kYB)));
+    return _mm_srli_epi16(sum, 8);
+}
+
+// Averages 2x2 blocks: top/bottom hold 8 pixels each, result is 4 x int32
+inline __m128i BlockSumSSE2(__m128i top, __m128i bottom) {
+    return _mm_madd_epi16(_mm_add_epi16(top, bottom), _mm_set1_epi16(1));
+}
+
+inline __m128i BlockAverageSSE2(__m128i sum_lo, __m128i sum_hi) {
+    __m128i sum = _mm_packs_epi32(sum_lo, sum_hi);
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+// Weighted sum lies in [-32640, 32640], so int16 arithmetic is exact
+inline __m128i ChromaSSE2(__m128i b, __m128i g, __m128i r, int cr, int cg, int cb) {
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(static_cast<short>(cr))),
+                                _mm_mullo_epi16(g, _mm_set1_epi16(static_cast<short>(cg))));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(static_cast<short>(cb))));
+    return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+void ConvertRowPairSSE2(const uint8_t* s0, const uint8_t* s1,
+                        uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int width) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i* t = reinterpret_cast<const __m128i*>(s0 + x * 4);
+        const __m128i* d = reinterpret_cast<const __m128i*>(s1 + x * 4);
+
+        __m128i tb0, tg0, tr0, tb1, tg1, tr1;
+        __m128i db0, dg0, dr0, db1, dg1, dr1;
+        DeinterleaveSSE2(_mm_loadu_si128(t + 0), _mm_loadu_si128(t + 1), tb0, tg0, tr0);
+        DeinterleaveSSE2(_mm_loadu_si128(t + 2), _mm_loadu_si128(t + 3), tb1, tg1, tr1);
+        DeinterleaveSSE2(_mm_loadu_si128(d + 0), _mm_loadu_si128(d + 1), db0, dg0, dr0);
+        DeinterleaveSSE2(_mm_loadu_si128(d + 2), _mm_loadu_si128(d + 3), db1, dg1, dr1);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + x),
+                         _mm_packus_epi16(LumaSSE2(tb0, tg0, tr0), LumaSSE2(tb1, tg1, tr1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + x),
+                         _mm_packus_epi16(LumaSSE2(db0, dg0, dr0), LumaSSE2(db1, dg1, dr1)));
+
+        __m128i b = BlockAverageSSE2(BlockSumSSE2(tb0, db0), BlockSumSSE2(tb1, db1));
+        __m128i g = BlockAverageSSE2(BlockSumSSE2(tg0, dg0), BlockSumSSE2(tg1, dg1));
+        __m128i r = BlockAverageSSE2(BlockSumSSE2(tr0, dr0), BlockSumSSE2(tr1, dr1));
+
+        __m128i cu = ChromaSSE2(b, g, r, kUR, kUG, kUB);
+        __m128i cv = ChromaSSE2(b, g, r, kVR, kVG, kVB);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), _mm_packus_epi16(cu, cu));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), _mm_packus_epi16(cv, cv));
+    }
+    ConvertRowPairScalar(s0, s1, y0, y1, u, v, x, width);
+}
+
+void BGRAToI420SSE2(const uint8_t* bgra, int bgra_stride,
+                    uint8_t* y, int y_stride,
+                    uint8_t* u, int u_stride,
+                    uint8_t* v, int v_stride,
+                    int width, int height) {
+    ForEachRowPair(bgra, bgra_stride, y, y_stride, u, u_stride, v, v_stride, width, height,
+                   ConvertRowPairSSE2);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2: 32 pixels x 2 rows per iteration
+//
+// pack/madd work per 128-bit lane, so intermediate results are in a shuffled
+// pixel order; a single dword permute at the store restores linear order.
+// ---------------------------------------------------------------------------
+
+COLOR_CONVERT_TARGET_AVX2
+inline void DeinterleaveAVX2(__m256i p0, __m256i p1, __m256i& b, __m256i& g, __m256i& r) {
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    b = _mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask));
+    g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+                           _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask));
+    r = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask),
+                           _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask));
+}
+
+COLOR_CONVERT_TARGET_AVX2
+inline __m256i LumaAVX2(__m256i b, __m256i g, __m256i r) {
+    __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(kYR)),
+                                   _mm256_mullo_epi16(g, _mm256_set1_epi16(kYG)));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(kYB)));
+    return _mm256_srli_epi16(sum, 8);
+}
+
+COLOR_CONVERT_TARGET_AVX2
+inline __m256i BlockSumAVX2(__m256i top, __m256i bottom) {
+    return _mm256_madd_epi16(_mm256_add_epi16(top, bottom), _mm256_set1_epi16(1));
+}
+
+COLOR_CONVERT_TARGET_AVX2
+inline __m256i BlockAverageAVX2(__m256i sum_lo, __m256i sum_hi) {
+    __m256i sum = _mm256_packs_epi32(sum_lo, sum_hi);
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+COLOR_CONVERT_TARGET_AVX2
+inline __m256i ChromaAVX2(__m256i b, __m256i g, __m256i r, int cr, int cg, int cb) {
+    __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(static_cast<short>(cr))),
+                                   _mm256_mullo_epi16(g, _mm256_set1_epi16(static_cast<short>(cg))));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(static_cast<short>(cb))));
+    return _mm256_add_epi16(_mm256_srai_epi16(sum, 8), _mm256_set1_epi16(128));
+}
+
+// Packs 16 chroma words (lane-shuffled order) into 16 linear bytes
+COLOR_CONVERT_TARGET_AVX2
+inline __m128i PackChromaAVX2(__m256i c, __m256i order) {
+    c = _mm256_permutevar8x32_epi32(c, order);
+    return _mm_packus_epi16(_mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1));
+}
+
+COLOR_CONVERT_TARGET_AVX2
+void ConvertRowPairAVX2(const uint8_t* s0, const uint8_t* s1,
+                        uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int width) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i* t = reinterpret_cast<const __m256i*>(s0 + x * 4);
+        const __m256i* d = reinterpret_cast<const __m256i*>(s1 + x * 4);
+
+        __m256i tb0, tg0, tr0, tb1, tg1, tr1;
+        __m256i db0, dg0, dr0, db1, dg1, dr1;
+        DeinterleaveAVX2(_mm256_loadu_si256(t + 0), _mm256_loadu_si256(t + 1), tb0, tg0, tr0);
+        DeinterleaveAVX2(_mm256_loadu_si256(t + 2), _mm256_loadu_si256(t + 3), tb1, tg1, tr1);
+        DeinterleaveAVX2(_mm256_loadu_si256(d + 0), _mm256_loadu_si256(d + 1), db0, dg0, dr0);
+        DeinterleaveAVX2(_mm256_loadu_si256(d + 2), _mm256_loadu_si256(d + 3), db1, dg1, dr1);
+
+        __m256i ty = _mm256_packus_epi16(LumaAVX2(tb0, tg0, tr0), LumaAVX2(tb1, tg1, tr1));
+        __m256i dy = _mm256_packus_epi16(LumaAVX2(db0, dg0, dr0), LumaAVX2(db1, dg1, dr1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(y0 + x), _mm256_permutevar8x32_epi32(ty, order));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(y1 + x), _mm256_permutevar8x32_epi32(dy, order));
+
+        __m256i b = BlockAverageAVX2(BlockSumAVX2(tb0, db0), BlockSumAVX2(tb1, db1));
+        __m256i g = BlockAverageAVX2(BlockSumAVX2(tg0, dg0), BlockSumAVX2(tg1, dg1));
+        __m256i r = BlockAverageAVX2(BlockSumAVX2(tr0, dr0), BlockSumAVX2(tr1, dr1));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(u + x / 2),
+                         PackChromaAVX2(ChromaAVX2(b, g, r, kUR, kUG, kUB), order));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + x / 2),
+                         PackChromaAVX2(ChromaAVX2(b, g, r, kVR, kVG, kVB), order));
+    }
+    ConvertRowPairScalar(s0, s1, y0, y1, u, v, x, width);
+}
+
+void BGRAToI420AVX2(const uint8_t* bgra, int bgra_stride,
+                    uint8_t* y, int y_stride,
+                    uint8_t* u, int u_stride,
+                    uint8_t* v, int v_stride,
+                    int width, int height) {
+    ForEachRowPair(bgra, bgra_stride, y, y_stride, u, u_stride, v, v_stride, width, height,
+                   ConvertRowPairAVX2);
+}
+
+bool CpuHasSSE2() {
+#if defined(_M_X64) || defined(__x86_64__)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool CpuHasAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) {
+        return false;
+    }
+    // OS must save/restore XMM and YMM state
+    if ((_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif  // COLOR_CONVERT_X86
+
+}  // namespace
+
+ColorConvertPath DetectColorConvertPath() {
+    static const ColorConvertPath path = []() {
+#if defined(COLOR_CONVERT_X86)
+        if (CpuHasAVX2()) {
+            return ColorConvertPath::kAVX2;
+        }
+        if (CpuHasSSE2()) {
+            return ColorConvertPath::kSSE2;
+        }
+#endif
+        return ColorConvertPath::kScalar;
+    }();
+    return path;
+}
+
+BGRAToI420Fn GetBGRAToI420(ColorConvertPath path) {
+#if defined(COLOR_CONVERT_X86)
+    ColorConvertPath best = DetectColorConvertPath();
+    if (path == ColorConvertPath::kAVX2 && best == ColorConvertPath::kAVX2) {
+        return BGRAToI420AVX2;
+    }
+    if (path == ColorConvertPath::kSSE2 && best != ColorConvertPath::kScalar) {
+        return BGRAToI420SSE2;
+    }
+#endif
+    return BGRAToI420Scalar;
+}
+
+const char* ColorConvertPathName(ColorConvertPath path) {
+    switch (path) {
+        case ColorConvertPath::kAVX2: return "avx2";
+        case ColorConvertPath::kSSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+void ConvertBGRAToI420(const uint8_t* bgra, int bgra_stride,
+                       uint8_t* y, int y_stride,
+                       uint8_t* u, int u_stride,
+                       uint8_t* v, int v_stride,
+                       int width, int height) {
+    static const BGRAToI420Fn convert = GetBGRAToI420(DetectColorConvertPath());
+    convert(bgra, bgra_stride, y, y_stride, u, u_stride, v, v_stride, width, height);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+// BGRA -> I420 (YUV420p) color conversion
+//
+// Y  = (77*R + 150*G + 29*B) >> 8
+// U  = ((-43*R - 85*G + 128*B) >> 8) + 128
+// V  = ((128*R - 107*G - 21*B) >> 8) + 128
+//
+// Chroma is computed from the rounded average of each 2x2 block of pixels
+// (box filter) rather than point-sampling the top-left pixel. Every path
+// (scalar, SSE2, AVX2) produces bit-identical output; the scalar path is the
+// reference the SIMD kernels are verified against.
+
+// Non-owning view of an I420 frame
+struct I420Image {
+    uint8_t* planes[3];   // Y, U, V
+    int strides[3];
+    int width;
+    int height;
+};
+
+enum class ColorConvertPath {
+    kScalar,
+    kSSE2,
+    kAVX2,
+};
+
+using BGRAToI420Fn = void (*)(const uint8_t* bgra, int bgra_stride,
+                              uint8_t* y, int y_stride,
+                              uint8_t* u, int u_stride,
+                              uint8_t* v, int v_stride,
+                              int width, int height);
+
+// Best path supported by the running CPU (detected once, then cached)
+ColorConvertPath DetectColorConvertPath();
+
+// Kernel for a specific path; falls back to scalar if the path was not
+// compiled in or is not supported by the running CPU
+BGRAToI420Fn GetBGRAToI420(ColorConvertPath path);
+
+const char* ColorConvertPathName(ColorConvertPath path);
+
+// Converts using the best available path
+void ConvertBGRAToI420(const uint8_t* bgra, int bgra_stride,
+                       uint8_t* y, int y_stride,
+                       uint8_t* u, int u_stride,
+                       uint8_t* v, int v_stride,
+                       int width, int height);
@@ -0,0 +1,128 @@
+// delivery_queue.cc - Bounded capture -> JS frame queue with drop policies
+
+#include "delivery_queue.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+bool ParseDropPolicy(const char* name, DropPolicy* policy) {
+    if (strcmp(name, "drop-oldest") == 0) {
+        *policy = DropPolicy::kDropOldest;
+    } else if (strcmp(name, "drop-newest") == 0) {
+        *policy = DropPolicy::kDropNewest;
+    } else if (strcmp(name, "block") == 0) {
+        *policy = DropPolicy::kBlock;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* DropPolicyName(DropPolicy policy) {
+    switch (policy) {
+        case DropPolicy::kDropOldest: return "drop-oldest";
+        case DropPolicy::kDropNewest: return "drop-newest";
+        default: return "block";
+    }
+}
+
+DeliveryQueue::DeliveryQueue(size_t capacity, DropPolicy policy)
+    : capacity_(std::max<size_t>(capacity, 1)), policy_(policy) {}
+
+// Dropping a referenced frame breaks decoding of everything after it unless
+// the very next frame is an IDR. A keyframe request is only counted once per
+// break, except when the dropped frame was itself the IDR we were waiting for.
+static bool DropBreaksChain(const FrameBufferRef& dropped, const FrameBuffer* next) {
+    if (!dropped->IsReference()) {
+        return false;
+    }
+    return !(next && next->IsKeyframe());
+}
+
+DeliveryQueue::PushResult DeliveryQueue::Push(FrameBufferRef frame, bool* needs_keyframe) {
+    *needs_keyframe = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_) {
+        return PushResult::kClosed;
+    }
+
+    PushResult result = PushResult::kQueued;
+    if (frames_.size() >= capacity_) {
+        switch (policy_) {
+            case DropPolicy::kDropNewest: {
+                dropped_++;
+                // The next frame is still unknown, so a referenced frame always breaks the chain
+                if (DropBreaksChain(frame, nullptr) && (!chain_broken_ || frame->IsKeyframe())) {
+                    chain_broken_ = true;
+                    keyframe_requests_++;
+                    *needs_keyframe = true;
+                }
+                return PushResult::kDropped;
+            }
+            case DropPolicy::kDropOldest: {
+                // Prefer a non-IDR victim so a queued IDR can still resync the decoder
+                auto victim = std::find_if(frames_.begin(), frames_.end(),
+                                           [](const FrameBufferRef& f) { return !f->IsKeyframe(); });
+                if (victim == frames_.end()) {
+                    victim = frames_.begin();
+                }
+                auto next = std::next(victim);
+                const FrameBuffer* next_frame = (next != frames_.end()) ? next->Get() : frame.Get();
+
+                if (DropBreaksChain(*victim, next_frame) && (!chain_broken_ || (*victim)->IsKeyframe())) {
+                    chain_broken_ = true;
+                    keyframe_requests_++;
+                    *needs_keyframe = true;
+                }
+                frames_.erase(victim);
+                dropped_++;
+                result = PushResult::kQueuedAfterDrop;
+                break;
+            }
+            case DropPolicy::kBlock:
+                not_full_.wait(lock, [this]() { return closed_ || frames_.size() < capacity_; });
+                if (closed_) {
+                    return PushResult::kClosed;
+                }
+                break;
+        }
+    }
+
+    if (frame->IsKeyframe()) {
+        chain_broken_ = false;
+    }
+    frames_.push_back(std::move(frame));
+    queued_++;
+    max_depth_ = std::max(max_depth_, frames_.size());
+    return result;
+}
+
+FrameBufferRef DeliveryQueue::Pop() {
+    FrameBufferRef frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frames_.empty()) {
+            return frame;
+        }
+        frame = std::move(frames_.front());
+        frames_.pop_front();
+        delivered_++;
+    }
+    not_full_.notify_one();
+    return frame;
+}
+
+void DeliveryQueue::Close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    not_full_.notify_all();
+}
+
+DeliveryQueue::Stats DeliveryQueue::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{ queued_, delivered_, dropped_, keyframe_requests_,
+                  frames_.size(), max_depth_, capacity_ };
+}
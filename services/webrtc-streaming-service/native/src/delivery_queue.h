@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include "frame_buffer_pool.h"
+
+// What to do when the capture thread produces a frame and the queue to the
+// JS thread is full
+enum class DropPolicy {
+    kDropOldest,    // evict the oldest queued non-IDR frame (oldest frame if all are IDR)
+    kDropNewest,    // discard the incoming frame
+    kBlock,         // wait for the JS thread to drain (stalls the encoder)
+};
+
+// Parses "drop-oldest" / "drop-newest" / "block"; returns false if unknown
+bool ParseDropPolicy(const char* name, DropPolicy* policy);
+const char* DropPolicyName(DropPolicy policy);
+
+// Bounded frame queue between the capture thread (producer) and the JS
+// thread (consumer). The TSFN only carries a wake-up; frames live here so
+// that the drop policy can inspect and evict queued frames.
+class DeliveryQueue {
+public:
+    struct Stats {
+        uint64_t queued;              // frames accepted into the queue
+        uint64_t delivered;           // frames handed to JS
+        uint64_t dropped;             // frames discarded by the policy
+        uint64_t keyframe_requests;   // drops that broke the reference chain
+        size_t depth;                 // frames currently queued
+        size_t max_depth;             // high-water mark
+        size_t capacity;
+    };
+
+    enum class PushResult {
+        kQueued,
+        kQueuedAfterDrop,   // accepted, an older frame was evicted
+        kDropped,           // the incoming frame was discarded
+        kClosed,            // queue closed (shutting down)
+    };
+
+    DeliveryQueue(size_t capacity, DropPolicy policy);
+
+    // Producer side. Sets *needs_keyframe when a dropped frame was referenced by
+    // later frames, i.e. the decoder cannot recover until the next IDR.
+    PushResult Push(FrameBufferRef frame, bool* needs_keyframe);
+
+    // Consumer side. Returns an empty ref when the queue is empty.
+    FrameBufferRef Pop();
+
+    // Wakes a producer blocked in Push; further pushes are rejected
+    void Close();
+
+    // Wake-up coalescing for the TSFN: the producer signals only when
+    // ArmWakeup() returns true, the consumer disarms before draining
+    bool ArmWakeup() { return !wakeup_armed_.exchange(true); }
+    void DisarmWakeup() { wakeup_armed_.store(false); }
+
+    Stats GetStats() const;
+    DropPolicy policy() const { return policy_; }
+
+private:
+    const size_t capacity_;
+    const DropPolicy policy_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::deque<FrameBufferRef> frames_;
+    bool closed_ = false;
+    std::atomic<bool> wakeup_armed_{false};
+    // Set once a referenced frame is dropped, cleared when the next IDR is queued
+    bool chain_broken_ = false;
+
+    uint64_t queued_ = 0;
+    uint64_t delivered_ = 0;
+    uint64_t dropped_ = 0;
+    uint64_t keyframe_requests_ = 0;
+    size_t max_depth_ = 0;
+};
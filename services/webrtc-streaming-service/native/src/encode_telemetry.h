@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "h264_encoder.h"
+#include "spsc_ring.h"
+
+// One record per encoded frame
+struct FrameTelemetry {
+    uint64_t frame_number;      // encoded frames since start
+    int64_t timestamp_ms;       // media timestamp
+    int64_t capture_us;         // steady clock at capture (PipelineNowUs)
+    int32_t capture_queue_us;   // captured -> conversion starts
+    int32_t convert_us;
+    int32_t encode_queue_us;    // converted -> encoding starts
+    int32_t encode_us;
+    uint32_t bytes;
+    uint32_t nal_types;         // bit n set if a NAL unit of type n was emitted
+    int16_t qp;
+    IEncoder::FrameType type;
+};
+
+// Per-frame telemetry handed from the encode thread to JS. The encode thread
+// is the only writer and the JS thread the only reader, so recording is a
+// lock-free ring write with no allocation. If JS stops polling, new records
+// are dropped (and counted) rather than blocking the encoder.
+class EncodeTelemetry {
+public:
+    // Encode thread
+    void Record(const FrameTelemetry& record) {
+        if (!ring_.TryPush(record)) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // JS thread: appends everything recorded since the last drain
+    void Drain(std::vector<FrameTelemetry>* records) {
+        FrameTelemetry record;
+        while (ring_.TryPop(record)) {
+            records->push_back(record);
+        }
+    }
+
+    uint64_t Overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t kCapacity = 1024;   // ~17 s at 60 fps between polls
+
+    SpscRing<FrameTelemetry, kCapacity> ring_;
+    std::atomic<uint64_t> overflows_{0};
+};
@@ -0,0 +1,60 @@
+// file_source.cc - Raw BGRA / I420 file replay frame source
+
+#include "frame_source.h"
+
+FileFrameSource::FileFrameSource(const std::string& path, PixelFormat format, bool loop)
+    : path_(path), format_(format), loop_(loop), file_(nullptr), frame_size_(0) {}
+
+FileFrameSource::~FileFrameSource() {
+    Cleanup();
+}
+
+bool FileFrameSource::Initialize(const Config& config) {
+    frame_size_ = FrameSize(format_, config.width, config.height);
+
+    file_ = fopen(path_.c_str(), "rb");
+    if (!file_) {
+        printf("[FileSource] ERROR: cannot open %s\n", path_.c_str());
+        return false;
+    }
+
+    // Must hold at least one whole frame, otherwise looping would spin forever
+    fseek(file_, 0, SEEK_END);
+    long file_size = ftell(file_);
+    fseek(file_, 0, SEEK_SET);
+    if (file_size < 0 || static_cast<size_t>(file_size) < frame_size_) {
+        printf("[FileSource] ERROR: %s is smaller than one %dx%d %s frame\n",
+               path_.c_str(), config.width, config.height, PixelFormatName(format_));
+        Cleanup();
+        return false;
+    }
+
+    printf("[FileSource] %s: %ld frames of %dx%d %s%s\n", path_.c_str(),
+           file_size / static_cast<long>(frame_size_), config.width, config.height,
+           PixelFormatName(format_), loop_ ? ", looping" : "");
+    return true;
+}
+
+bool FileFrameSource::Capture(uint8_t* frame, int64_t timestamp_ms) {
+    if (!file_) {
+        return false;
+    }
+
+    if (fread(frame, 1, frame_size_, file_) == frame_size_) {
+        return true;
+    }
+
+    // End of file (a trailing partial frame is ignored)
+    if (!loop_) {
+        return false;
+    }
+    fseek(file_, 0, SEEK_SET);
+    return fread(frame, 1, frame_size_, file_) == frame_size_;
+}
+
+void FileFrameSource::Cleanup() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
@@ -0,0 +1,94 @@
+// frame_buffer_pool.cc - Ref-counted slab pool for encoded frames
+
+#include "frame_buffer_pool.h"
+#include <algorithm>
+#include <iterator>
+
+void FrameBuffer::Release() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Move the owner out first: recycling may drop the last pool reference
+        std::shared_ptr<FrameBufferPool> pool = std::move(owner_);
+        pool->Recycle(this);
+    }
+}
+
+std::shared_ptr<FrameBufferPool> FrameBufferPool::Create(size_t slab_count, size_t slab_size,
+                                                         size_t max_free_slabs) {
+    std::shared_ptr<FrameBufferPool> pool(
+        new FrameBufferPool(slab_size, std::max(max_free_slabs, slab_count)));
+
+    pool->free_.reserve(pool->max_free_slabs_);
+    for (size_t i = 0; i < slab_count; i++) {
+        FrameBuffer* buffer = new FrameBuffer();
+        buffer->data_.reset(new uint8_t[slab_size]);
+        buffer->capacity_ = slab_size;
+        pool->free_.push_back(buffer);
+        pool->allocations_++;
+    }
+    return pool;
+}
+
+FrameBufferPool::FrameBufferPool(size_t slab_size, size_t max_free_slabs)
+    : slab_size_(slab_size), max_free_slabs_(max_free_slabs) {}
+
+FrameBufferPool::~FrameBufferPool() {
+    // Outstanding buffers hold a reference to the pool, so only free slabs remain here
+    for (FrameBuffer* buffer : free_) {
+        delete buffer;
+    }
+}
+
+FrameBufferRef FrameBufferPool::Acquire(size_t min_capacity) {
+    FrameBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            // Prefer the most recently returned slab that already fits
+            auto fits = std::find_if(free_.rbegin(), free_.rend(), [min_capacity](FrameBuffer* b) {
+                return b->capacity_ >= min_capacity;
+            });
+            auto it = (fits != free_.rend()) ? std::prev(fits.base()) : std::prev(free_.end());
+            buffer = *it;
+            free_.erase(it);
+        }
+        acquired_++;
+        outstanding_++;
+        if (!buffer || buffer->capacity_ < min_capacity) {
+            allocations_++;
+        }
+    }
+
+    if (!buffer) {
+        buffer = new FrameBuffer();
+    }
+    if (buffer->capacity_ < min_capacity) {
+        // Grow with headroom so the next keyframe of similar size fits
+        size_t capacity = std::max(slab_size_, min_capacity + min_capacity / 2);
+        buffer->data_.reset(new uint8_t[capacity]);
+        buffer->capacity_ = capacity;
+    }
+
+    buffer->size_ = 0;
+    buffer->keyframe_ = false;
+    buffer->reference_ = false;
+    buffer->capture_time_us_ = 0;
+    buffer->encoded_time_us_ = 0;
+    buffer->refs_.store(1, std::memory_order_relaxed);
+    buffer->owner_ = shared_from_this();
+    return FrameBufferRef::Adopt(buffer);
+}
+
+void FrameBufferPool::Recycle(FrameBuffer* buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    outstanding_--;
+    if (free_.size() < max_free_slabs_) {
+        free_.push_back(buffer);
+    } else {
+        delete buffer;
+    }
+}
+
+FrameBufferPool::Stats FrameBufferPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Stats{ acquired_, allocations_, outstanding_, free_.size() };
+}
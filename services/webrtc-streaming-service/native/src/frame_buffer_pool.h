@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class FrameBufferPool;
+
+// Pooled slab holding one encoded access unit (Annex B NALs back to back).
+// Reference counted intrusively so handing a frame between threads never
+// allocates; the last reference returns the slab to its pool.
+class FrameBuffer {
+public:
+    uint8_t* Data() { return data_.get(); }
+    const uint8_t* Data() const { return data_.get(); }
+    size_t Size() const { return size_; }
+    size_t Capacity() const { return capacity_; }
+
+    // Caller must stay within Capacity()
+    void SetSize(size_t size) { size_ = size; }
+
+    // IDR access unit (decoder can start / resync here)
+    bool IsKeyframe() const { return keyframe_; }
+    // Referenced by later frames, so dropping it corrupts them until the next IDR
+    bool IsReference() const { return reference_; }
+    void SetFrameType(bool keyframe, bool reference) {
+        keyframe_ = keyframe;
+        reference_ = reference;
+    }
+
+    // steady_clock microseconds when the source frame was captured / finished encoding
+    int64_t CaptureTimeUs() const { return capture_time_us_; }
+    int64_t EncodedTimeUs() const { return encoded_time_us_; }
+    void SetTimes(int64_t capture_time_us, int64_t encoded_time_us) {
+        capture_time_us_ = capture_time_us;
+        encoded_time_us_ = encoded_time_us;
+    }
+
+    void AddRef() { refs_.fetch_add(1, std::memory_order_relaxed); }
+    void Release();
+
+private:
+    friend class FrameBufferPool;
+
+    FrameBuffer() = default;
+
+    std::unique_ptr<uint8_t[]> data_;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    bool keyframe_ = false;
+    bool reference_ = false;
+    int64_t capture_time_us_ = 0;
+    int64_t encoded_time_us_ = 0;
+    std::atomic<int> refs_{0};
+    // Keeps the pool alive while the slab is checked out (e.g. held by a JS Buffer)
+    std::shared_ptr<FrameBufferPool> owner_;
+};
+
+// Owning handle to a FrameBuffer
+class FrameBufferRef {
+public:
+    FrameBufferRef() = default;
+    FrameBufferRef(const FrameBufferRef& other) : buffer_(other.buffer_) {
+        if (buffer_) buffer_->AddRef();
+    }
+    FrameBufferRef(FrameBufferRef&& other) noexcept : buffer_(other.buffer_) {
+        other.buffer_ = nullptr;
+    }
+    FrameBufferRef& operator=(FrameBufferRef other) noexcept {
+        std::swap(buffer_, other.buffer_);
+        return *this;
+    }
+    ~FrameBufferRef() {
+        if (buffer_) buffer_->Release();
+    }
+
+    // Takes over a reference previously detached with Detach()
+    static FrameBufferRef Adopt(FrameBuffer* buffer) {
+        FrameBufferRef ref;
+        ref.buffer_ = buffer;
+        return ref;
+    }
+
+    // Hands the reference to C code (TSFN payload, external Buffer hint)
+    FrameBuffer* Detach() {
+        FrameBuffer* buffer = buffer_;
+        buffer_ = nullptr;
+        return buffer;
+    }
+
+    FrameBuffer* Get() const { return buffer_; }
+    FrameBuffer* operator->() const { return buffer_; }
+    explicit operator bool() const { return buffer_ != nullptr; }
+    bool empty() const { return !buffer_ || buffer_->Size() == 0; }
+
+private:
+    FrameBuffer* buffer_ = nullptr;
+};
+
+class FrameBufferPool : public std::enable_shared_from_this<FrameBufferPool> {
+public:
+    struct Stats {
+        uint64_t acquired;      // total Acquire() calls
+        uint64_t allocations;   // slab (re)allocations, should plateau after warm-up
+        size_t outstanding;     // slabs currently checked out
+        size_t free_slabs;
+    };
+
+    // Preallocates slab_count slabs of slab_size bytes; at most max_free_slabs
+    // are kept around once returned
+    static std::shared_ptr<FrameBufferPool> Create(size_t slab_count, size_t slab_size,
+                                                   size_t max_free_slabs = 16);
+    ~FrameBufferPool();
+
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+    // Returns an empty buffer with at least min_capacity bytes. Reuses a free
+    // slab when possible and only grows it if the frame does not fit.
+    FrameBufferRef Acquire(size_t min_capacity);
+
+    Stats GetStats() const;
+
+private:
+    friend class FrameBuffer;
+
+    FrameBufferPool(size_t slab_size, size_t max_free_slabs);
+    void Recycle(FrameBuffer* buffer);
+
+    const size_t slab_size_;
+    const size_t max_free_slabs_;
+
+    mutable std::mutex mutex_;
+    std::vector<FrameBuffer*> free_;
+    uint64_t acquired_ = 0;
+    uint64_t allocations_ = 0;
+    size_t outstanding_ = 0;
+};
@@ -0,0 +1,39 @@
+// frame_source.cc - Frame source factory and shared helpers
+
+#include "frame_source.h"
+#include <cstring>
+
+size_t FrameSize(PixelFormat format, int width, int height) {
+    size_t luma = static_cast<size_t>(width) * height;
+    if (format == PixelFormat::kI420) {
+        size_t chroma = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+        return luma + 2 * chroma;
+    }
+    return luma * 4;
+}
+
+bool ParsePixelFormat(const char* name, PixelFormat* format) {
+    if (strcmp(name, "bgra") == 0) {
+        *format = PixelFormat::kBGRA;
+    } else if (strcmp(name, "i420") == 0 || strcmp(name, "yuv") == 0) {
+        *format = PixelFormat::kI420;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* PixelFormatName(PixelFormat format) {
+    return format == PixelFormat::kI420 ? "i420" : "bgra";
+}
+
+std::unique_ptr<IFrameSource> CreateFrameSource(const FrameSourceOptions& options) {
+    if (options.type == "synthetic") {
+        return std::make_unique<SyntheticFrameSource>(options.motion);
+    }
+    if (options.type == "file") {
+        return std::make_unique<FileFrameSource>(options.path, options.format, options.loop);
+    }
+    // Future: "wgc" / "dxgi" desktop capture on Windows
+    return nullptr;
+}
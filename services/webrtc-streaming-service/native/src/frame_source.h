@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Pixel layout produced by a frame source
+enum class PixelFormat {
+    kBGRA,   // packed, stride = width * 4
+    kI420,   // planar Y, U, V back to back, chroma stride = (width + 1) / 2
+};
+
+// Bytes in one tightly packed frame of the given format
+size_t FrameSize(PixelFormat format, int width, int height);
+
+// Frame source interface (capture backends, synthetic content, file replay)
+class IFrameSource {
+public:
+    struct Config {
+        int width;
+        int height;
+        int fps;
+    };
+
+    virtual ~IFrameSource() = default;
+    virtual bool Initialize(const Config& config) = 0;
+    virtual PixelFormat Format() const = 0;
+    // Fills one tightly packed frame of FrameSize(Format(), width, height) bytes.
+    // Returns false when the source has no more frames or failed.
+    virtual bool Capture(uint8_t* frame, int64_t timestamp_ms) = 0;
+    virtual void Cleanup() = 0;
+};
+
+// Deterministic moving test pattern. Frame content depends only on the
+// timestamp, so runs are reproducible across hosts.
+//   motion 0: static color bars
+//   motion 1: horizontally scrolling bars
+//   motion 2: + bouncing boxes
+//   motion 3: + macroblock noise regenerated every frame (worst case for the encoder)
+class SyntheticFrameSource : public IFrameSource {
+public:
+    explicit SyntheticFrameSource(int motion);
+
+    bool Initialize(const Config& config) override;
+    PixelFormat Format() const override { return PixelFormat::kBGRA; }
+    bool Capture(uint8_t* frame, int64_t timestamp_ms) override;
+    void Cleanup() override;
+
+private:
+    void DrawBars(uint8_t* frame, int offset);
+    void DrawBox(uint8_t* frame, int64_t frame_index, int box, uint32_t color);
+    void DrawNoise(uint8_t* frame, int64_t frame_index);
+
+    int motion_;
+    Config config_;
+    std::vector<uint8_t> row_;   // one precomputed row of bars
+};
+
+// Replays a raw .bgra / .yuv (I420) file, one tightly packed frame after
+// another, optionally looping at end of file
+class FileFrameSource : public IFrameSource {
+public:
+    FileFrameSource(const std::string& path, PixelFormat format, bool loop);
+    ~FileFrameSource() override;
+
+    bool Initialize(const Config& config) override;
+    PixelFormat Format() const override { return format_; }
+    bool Capture(uint8_t* frame, int64_t timestamp_ms) override;
+    void Cleanup() override;
+
+private:
+    std::string path_;
+    PixelFormat format_;
+    bool loop_;
+    FILE* file_;
+    size_t frame_size_;
+};
+
+struct FrameSourceOptions {
+    std::string type = "synthetic";   // "synthetic" | "file"
+    int motion = 0;                   // synthetic only
+    std::string path;                 // file only
+    PixelFormat format = PixelFormat::kBGRA;
+    bool loop = true;
+};
+
+bool ParsePixelFormat(const char* name, PixelFormat* format);
+const char* PixelFormatName(PixelFormat format);
+
+// Factory function; returns null for an unknown source type
+std::unique_ptr<IFrameSource> CreateFrameSource(const FrameSourceOptions& options);
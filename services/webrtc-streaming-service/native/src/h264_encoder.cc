@@ -2,10 +2,13 @@
 // Encoder-agnostic interface for future AMF integration
 
 #include "h264_encoder.h"
+#include "color_convert.h"
+#include "image_scale.h"
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <memory>
-#include <map>
 
 extern "C" {
 #include <x264.h>
@@ -13,8 +16,9 @@ extern "C" {
 
 // X264EncoderImpl implementation
 
-X264EncoderImpl::X264EncoderImpl() 
-    : encoder_(nullptr), initialized_(false) {
+X264EncoderImpl::X264EncoderImpl(std::shared_ptr<FrameBufferPool> output_pool)
+    : encoder_(nullptr), input_width_(0), input_height_(0), last_pts_(-1), last_frame_(), initialized_(false),
+      output_pool_(std::move(output_pool)), keyframe_requested_(false), reconfig_pending_(false) {
     printf("[X264] CONSTRUCTOR this=%p\n", this);
 }
 
@@ -23,12 +27,45 @@ X264EncoderImpl::~X264EncoderImpl() {
     Cleanup();
 }
 
+// ABR with a VBV cap; shared by open and runtime reconfig
+static void SetRateControl(const IEncoder::Config& config, x264_param_t* param) {
+    param->rc.i_rc_method = X264_RC_ABR;
+    param->rc.i_bitrate = config.bitrate;
+    if (config.intra_refresh) {
+        // Without IDRs no frame needs a large buffer; a two-frame VBV keeps
+        // every frame close to the average size
+        param->rc.i_vbv_max_bitrate = config.bitrate;
+        param->rc.i_vbv_buffer_size = std::max(config.bitrate * 2 / config.fps, 1);
+    } else {
+        param->rc.i_vbv_max_bitrate = static_cast<int>(config.bitrate * 1.5);
+        param->rc.i_vbv_buffer_size = config.bitrate;
+    }
+}
+
 bool X264EncoderImpl::Initialize(const IEncoder::Config& config) {
+    if (!Open(config)) {
+        return false;
+    }
+    input_width_ = config.width;
+    input_height_ = config.height;
+
+    if (!output_pool_) {
+        output_pool_ = FrameBufferPool::Create(4, EncodedFrameSlabSize(config));
+    }
+
+    printf("[X264] Color conversion path: %s\n", ColorConvertPathName(DetectColorConvertPath()));
+
+    initialized_ = true;
+    return true;
+}
+
+bool X264EncoderImpl::Open(const IEncoder::Config& config) {
     config_ = config;
+    last_pts_ = -1;
 
     // Configure x264 parameters
     x264_param_t param;
-    if (x264_param_default_preset(&param, "ultrafast", "zerolatency") < 0) {
+    if (x264_param_default_preset(&param, config.preset.c_str(), "zerolatency") < 0) {
         return false;
     }
 
@@ -39,20 +76,25 @@ bool X264EncoderImpl::Initialize(const IEncoder::Config& config) {
     param.i_fps_den = 1;
 
     // Bitrate control (VBR)
-    param.rc.i_rc_method = X264_RC_ABR;
-    param.rc.i_bitrate = config.bitrate;
-    param.rc.i_vbv_max_bitrate = static_cast<int>(config.bitrate * 1.5);
-    param.rc.i_vbv_buffer_size = config.bitrate;
-
-    // WebRTC-friendly GOP: Force IDR every 1 second
-    param.i_keyint_max = config.fps;       // IDR every 1 second
-    param.i_keyint_min = config.fps;       // Min = max (disable scenecut)
-    param.b_intra_refresh = 0;             // CRITICAL: Disable gradual refresh, use full IDR
+    SetRateControl(config, &param);
+
+    if (config.intra_refresh) {
+        // Low-latency mode: one intra refresh sweep per second, IDR on demand only
+        param.i_keyint_max = config.fps;   // refresh period
+        param.i_keyint_min = config.fps;
+        param.b_intra_refresh = 1;
+        param.i_frame_reference = 1;       // refresh needs a single reference
+    } else {
+        // WebRTC-friendly GOP: Force IDR every 1 second
+        param.i_keyint_max = config.fps;       // IDR every 1 second
+        param.i_keyint_min = config.fps;       // Min = max (disable scenecut)
+        param.b_intra_refresh = 0;             // CRITICAL: Disable gradual refresh, use full IDR
+    }
     param.i_scenecut_threshold = 0;        // Disable scene-cut detection
 
     // Low latency settings
-    param.i_threads = 4;
-    param.b_sliced_threads = 1;
+    param.i_threads = config.threads;
+    param.b_sliced_threads = config.sliced_threads ? 1 : 0;
     param.i_sync_lookahead = 0;
     param.rc.i_lookahead = 0;
 
@@ -71,8 +113,9 @@ bool X264EncoderImpl::Initialize(const IEncoder::Config& config) {
     }
     
     // PHASE 1 & 2: Log encoder lifecycle and final params
-    printf("[X264] INIT this=%p fps=%d keyint_max=%d keyint_min=%d intra_refresh=%d repeat_headers=%d scenecut=%d\n",
-           this, config.fps, param.i_keyint_max, param.i_keyint_min, 
+    printf("[X264] INIT this=%p preset=%s threads=%d%s fps=%d keyint_max=%d keyint_min=%d intra_refresh=%d repeat_headers=%d scenecut=%d\n",
+           this, config.preset.c_str(), param.i_threads, param.b_sliced_threads ? " sliced" : "",
+           config.fps, param.i_keyint_max, param.i_keyint_min, 
            param.b_intra_refresh, param.b_repeat_headers, param.i_scenecut_threshold);
     printf("[X264] FINAL PARAMS after x264_encoder_open: i_keyint_max=%d i_keyint_min=%d b_intra_refresh=%d i_scenecut_threshold=%d b_repeat_headers=%d b_annexb=%d\n",
            param.i_keyint_max, param.i_keyint_min, param.b_intra_refresh, 
@@ -85,70 +128,220 @@ bool X264EncoderImpl::Initialize(const IEncoder::Config& config) {
         return false;
     }
 
-    initialized_ = true;
     return true;
 }
 
-std::vector<uint8_t> X264EncoderImpl::Encode(const uint8_t* bgra_data, int64_t timestamp_ms) {
-    std::vector<uint8_t> output;
+bool X264EncoderImpl::Reconfigure(const IEncoder::Config& config) {
+    // 4:2:0 needs even dimensions
+    if (config.width <= 0 || config.height <= 0 || (config.width | config.height) & 1 ||
+        config.fps <= 0 || config.bitrate <= 0 || config.threads <= 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(reconfig_mutex_);
+    pending_config_ = config;
+    reconfig_pending_.store(true);
+    return true;
+}
+
+// Anything but bitrate is fixed for the lifetime of an x264 instance
+static bool NeedsReopen(const IEncoder::Config& current, const IEncoder::Config& next) {
+    return next.width != current.width || next.height != current.height || next.fps != current.fps ||
+           next.intra_refresh != current.intra_refresh || next.threads != current.threads ||
+           next.sliced_threads != current.sliced_threads || next.preset != current.preset;
+}
+
+// Runs on the encoding thread, so x264 is never touched concurrently
+void X264EncoderImpl::ApplyPendingConfig() {
+    if (!initialized_ || !reconfig_pending_.exchange(false)) {
+        return;
+    }
+
+    IEncoder::Config next;
+    {
+        std::lock_guard<std::mutex> lock(reconfig_mutex_);
+        next = pending_config_;
+    }
+
+    if (!NeedsReopen(config_, next)) {
+        if (next.bitrate == config_.bitrate) {
+            return;
+        }
+        // Rate control only: no new SPS, the GOP carries on
+        x264_param_t param;
+        x264_encoder_parameters(encoder_, &param);
+        IEncoder::Config rate = config_;
+        rate.bitrate = next.bitrate;
+        SetRateControl(rate, &param);
+        if (x264_encoder_reconfig(encoder_, &param) < 0) {
+            printf("[X264] Bitrate change to %d kbps rejected\n", next.bitrate);
+            return;
+        }
+        printf("[X264] Bitrate %d -> %d kbps\n", config_.bitrate, next.bitrate);
+        config_.bitrate = next.bitrate;
+        return;
+    }
+
+    // New SPS: reopen. The first frame out of the new encoder is an IDR.
+    IEncoder::Config previous = config_;
+    Close();
+    if (!Open(next)) {
+        printf("[X264] Reopen at %dx%d@%d failed, keeping %dx%d@%d\n",
+               next.width, next.height, next.fps, previous.width, previous.height, previous.fps);
+        if (!Open(previous)) {
+            initialized_ = false;
+        }
+        return;
+    }
+    printf("[X264] Reconfigured %dx%d@%d %dkbps -> %dx%d@%d %dkbps\n",
+           previous.width, previous.height, previous.fps, previous.bitrate,
+           next.width, next.height, next.fps, next.bitrate);
+}
+
+FrameBufferRef X264EncoderImpl::Encode(const uint8_t* bgra_data, int64_t timestamp_ms) {
+    ApplyPendingConfig();
 
     if (!initialized_ || !bgra_data) {
-        return output;
+        return FrameBufferRef();
+    }
+
+    I420Image target = {
+        { picture_in_.img.plane[0], picture_in_.img.plane[1], picture_in_.img.plane[2] },
+        { picture_in_.img.i_stride[0], picture_in_.img.i_stride[1], picture_in_.img.i_stride[2] },
+        config_.width, config_.height
+    };
+
+    if (input_width_ == config_.width && input_height_ == config_.height) {
+        // Convert BGRA to I420 (YUV420p), SIMD path selected at runtime
+        ConvertBGRAToI420(bgra_data, input_width_ * 4,
+                          target.planes[0], target.strides[0],
+                          target.planes[1], target.strides[1],
+                          target.planes[2], target.strides[2],
+                          input_width_, input_height_);
+        return EncodePicture(&picture_in_, timestamp_ms);
     }
 
-    // Convert BGRA to I420 (YUV420p)
-    BGRAToI420(bgra_data, picture_in_.img.plane[0], picture_in_.img.plane[1], picture_in_.img.plane[2]);
+    // Running below the input resolution: convert at full size, then downscale
+    int chroma_width = (input_width_ + 1) / 2;
+    size_t luma_size = static_cast<size_t>(input_width_) * input_height_;
+    size_t chroma_size = static_cast<size_t>(chroma_width) * ((input_height_ + 1) / 2);
+    input_i420_.resize(luma_size + 2 * chroma_size);
+    I420Image input = {
+        { input_i420_.data(), input_i420_.data() + luma_size, input_i420_.data() + luma_size + chroma_size },
+        { input_width_, chroma_width, chroma_width },
+        input_width_, input_height_
+    };
+    ConvertBGRAToI420(bgra_data, input_width_ * 4,
+                      input.planes[0], input.strides[0],
+                      input.planes[1], input.strides[1],
+                      input.planes[2], input.strides[2],
+                      input_width_, input_height_);
+    scaler_.Scale(input, target);
+
+    return EncodePicture(&picture_in_, timestamp_ms);
+}
 
-    // Set timestamp
-    picture_in_.i_pts = timestamp_ms * config_.fps / 1000;
+FrameBufferRef X264EncoderImpl::EncodeI420(const I420Image& image, int64_t timestamp_ms) {
+    ApplyPendingConfig();
+
+    if (!initialized_) {
+        return FrameBufferRef();
+    }
+
+    if (image.width != config_.width || image.height != config_.height) {
+        // Encoding below the capture resolution (see Reconfigure)
+        I420Image target = {
+            { picture_in_.img.plane[0], picture_in_.img.plane[1], picture_in_.img.plane[2] },
+            { picture_in_.img.i_stride[0], picture_in_.img.i_stride[1], picture_in_.img.i_stride[2] },
+            config_.width, config_.height
+        };
+        scaler_.Scale(image, target);
+        return EncodePicture(&picture_in_, timestamp_ms);
+    }
+
+    // x264 copies the input into its own frame pool, so the caller's planes can be used directly
+    x264_picture_t picture;
+    x264_picture_init(&picture);
+    picture.img.i_csp = X264_CSP_I420;
+    picture.img.i_plane = 3;
+    for (int i = 0; i < 3; i++) {
+        picture.img.plane[i] = image.planes[i];
+        picture.img.i_stride[i] = image.strides[i];
+    }
+
+    return EncodePicture(&picture, timestamp_ms);
+}
+
+FrameBufferRef X264EncoderImpl::EncodePicture(x264_picture_t* picture, int64_t timestamp_ms) {
+    FrameBufferRef output;
+
+    if (picture) {
+        // pts in frame periods of the current rate. x264 needs it strictly increasing,
+        // which capture jitter could break, so it is clamped; a frame rate change reopens
+        // x264 (see ApplyPendingConfig), which starts the count again
+        int64_t pts = timestamp_ms * config_.fps / 1000;
+        picture->i_pts = last_pts_ = std::max(pts, last_pts_ + 1);
+
+        // Honour pending keyframe requests (e.g. the delivery queue dropped a reference frame)
+        picture->i_type = keyframe_requested_.exchange(false) ? X264_TYPE_IDR : X264_TYPE_AUTO;
+    }
 
     // Encode
     x264_picture_t pic_out;
     x264_nal_t* nals;
     int num_nals;
-    int frame_size = x264_encoder_encode(encoder_, &nals, &num_nals, &picture_in_, &pic_out);
+    int frame_size = x264_encoder_encode(encoder_, &nals, &num_nals, picture, &pic_out);
 
     if (frame_size > 0) {
-        // PHASE 3: Count NAL types and detect first SPS/PPS/IDR
-        static std::map<int, int> nal_counts;
-        static std::map<int, bool> nal_seen;
-        static int64_t last_log_ts = 0;
-        
-        for (int i = 0; i < num_nals; i++) {
-            int nal_type = nals[i].i_type;
-            nal_counts[nal_type]++;
-            
-            // First time seeing critical NAL types
-            if ((nal_type == 5 || nal_type == 7 || nal_type == 8) && !nal_seen[nal_type]) {
-                nal_seen[nal_type] = true;
-                printf("[X264] FIRST NAL TYPE %d detected at timestamp %lld ms (size=%d bytes)\\n", 
-                       nal_type, timestamp_ms, nals[i].i_payload);
-            }
-        }
-        
-        // Log NAL counts every second
-        int64_t current_sec = timestamp_ms / 1000;
-        if (current_sec > last_log_ts) {
-            printf("[X264] NAL counts per second: ");
-            for (const auto& pair : nal_counts) {
-                printf("type_%d=%d ", pair.first, pair.second);
-            }
-            printf("\\n");
-            nal_counts.clear();
-            last_log_ts = current_sec;
-        }
-        
-        // Collect all NAL units (Annex B format)
+        // Collect all NAL units (Annex B format). x264 guarantees the payloads are
+        // sequential in memory, so the whole access unit is a single copy into the slab.
+        output = output_pool_->Acquire(frame_size);
+        memcpy(output->Data(), nals[0].p_payload, frame_size);
+        output->SetSize(frame_size);
+
+        bool reference = false;
+        uint32_t nal_types = 0;
         for (int i = 0; i < num_nals; i++) {
-            output.insert(output.end(), nals[i].p_payload, nals[i].p_payload + nals[i].i_payload);
+            reference = reference || nals[i].i_ref_idc != NAL_PRIORITY_DISPOSABLE;
+            nal_types |= 1u << (nals[i].i_type & 31);
         }
+        // b_keyframe also marks intra refresh recovery points, which do not
+        // reset the reference chain; only a real IDR does
+        output->SetFrameType(pic_out.i_type == X264_TYPE_IDR, reference);
+
+        last_frame_.type = pic_out.i_type == X264_TYPE_IDR ? FrameType::kIDR
+                         : IS_X264_TYPE_I(pic_out.i_type) ? FrameType::kI
+                         : IS_X264_TYPE_B(pic_out.i_type) ? FrameType::kB
+                         : FrameType::kP;
+        last_frame_.qp = pic_out.i_qpplus1 - 1;
+        last_frame_.nal_types = nal_types;
     }
 
     return output;
 }
 
+FrameBufferRef X264EncoderImpl::Flush() {
+    FrameBufferRef output;
+    // A drain call can come back empty while frames are still queued
+    while (initialized_ && output.empty() && x264_encoder_delayed_frames(encoder_) > 0) {
+        output = EncodePicture(nullptr, 0);
+    }
+    return output;
+}
+
+void X264EncoderImpl::RequestKeyframe() {
+    keyframe_requested_.store(true);
+}
+
 void X264EncoderImpl::Cleanup() {
     printf("[X264] CLEANUP this=%p\n", this);
+    if (initialized_) {
+        Close();
+        initialized_ = false;
+    }
+}
+
+void X264EncoderImpl::Close() {
     if (encoder_) {
         // Flush delayed frames
         while (x264_encoder_delayed_frames(encoder_)) {
@@ -160,46 +353,29 @@ void X264EncoderImpl::Cleanup() {
 
         x264_encoder_close(encoder_);
         encoder_ = nullptr;
-    }
-
-    if (initialized_) {
         x264_picture_clean(&picture_in_);
-        initialized_ = false;
     }
 }
 
-void X264EncoderImpl::BGRAToI420(const uint8_t* bgra, uint8_t* y, uint8_t* u, uint8_t* v) {
-    int width = config_.width;
-    int height = config_.height;
-
-    // Simple BGRA to I420 conversion
-    for (int row = 0; row < height; row++) {
-        for (int col = 0; col < width; col++) {
-            int bgra_idx = (row * width + col) * 4;
-            int y_idx = row * width + col;
-
-            uint8_t b = bgra[bgra_idx + 0];
-            uint8_t g = bgra[bgra_idx + 1];
-            uint8_t r = bgra[bgra_idx + 2];
-
-            // Y = 0.299*R + 0.587*G + 0.114*B
-            y[y_idx] = static_cast<uint8_t>((77 * r + 150 * g + 29 * b) >> 8);
-
-            // U and V sampled at 2x2
-            if (row % 2 == 0 && col % 2 == 0) {
-                int uv_idx = (row / 2) * (width / 2) + (col / 2);
-                // U = -0.169*R - 0.331*G + 0.500*B + 128
-                u[uv_idx] = static_cast<uint8_t>(((-43 * r - 85 * g + 128 * b) >> 8) + 128);
-                // V = 0.500*R - 0.419*G - 0.081*B + 128
-                v[uv_idx] = static_cast<uint8_t>(((128 * r - 107 * g - 21 * b) >> 8) + 128);
-            }
-        }
+const char* FrameTypeName(IEncoder::FrameType type) {
+    switch (type) {
+        case IEncoder::FrameType::kIDR: return "idr";
+        case IEncoder::FrameType::kI: return "i";
+        case IEncoder::FrameType::kP: return "p";
+        case IEncoder::FrameType::kB: return "b";
+        default: return "unknown";
     }
 }
 
+size_t EncodedFrameSlabSize(const IEncoder::Config& config) {
+    // Average frame size at the target bitrate, x8 for IDR frames
+    size_t average = static_cast<size_t>(config.bitrate) * 1000 / 8 / (config.fps > 0 ? config.fps : 1);
+    return std::max<size_t>(average * 8, 64 * 1024);
+}
+
 // Factory function implementation
-std::unique_ptr<IEncoder> CreateEncoder(bool use_hardware) {
+std::unique_ptr<IEncoder> CreateEncoder(bool use_hardware, std::shared_ptr<FrameBufferPool> output_pool) {
     // For now, always return x264 software encoder
     // Future: Check use_hardware flag and return AMF encoder if available
-    return std::make_unique<X264EncoderImpl>();
+    return std::make_unique<X264EncoderImpl>(std::move(output_pool));
 }
\ No newline at end of file
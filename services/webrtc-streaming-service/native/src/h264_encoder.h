@@ -1,8 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include "color_convert.h"
+#include "frame_buffer_pool.h"
+#include "image_scale.h"
 
 extern "C" {
 #include <x264.h>
@@ -16,32 +22,97 @@ public:
         int height;
         int fps;
         int bitrate;  // kbps
+        // Periodic intra refresh instead of an IDR every second: intra blocks
+        // sweep across the picture once per second, so no single frame
+        // carries the whole intra cost. IDRs then only come from RequestKeyframe.
+        bool intra_refresh = false;
+        int threads = 4;              // x264 threads per encoder
+        bool sliced_threads = true;   // slice threads (no added latency) vs frame threads
+        std::string preset = "ultrafast";
+    };
+
+    enum class FrameType : uint8_t { kIDR, kI, kP, kB };
+
+    // Encoder-side details of the last frame returned by Encode / EncodeI420
+    struct FrameInfo {
+        FrameType type;
+        int qp;               // average QP
+        uint32_t nal_types;   // bit n set if the access unit holds a NAL unit of type n
     };
 
     virtual ~IEncoder() = default;
     virtual bool Initialize(const Config& config) = 0;
-    virtual std::vector<uint8_t> Encode(const uint8_t* rgba_data, int64_t timestamp_ms) = 0;
+    // Returns the encoded access unit in a pooled buffer (empty if the encoder produced nothing)
+    virtual FrameBufferRef Encode(const uint8_t* rgba_data, int64_t timestamp_ms) = 0;
+    // Encodes an already converted frame (lets color conversion run on its own pipeline stage)
+    virtual FrameBufferRef EncodeI420(const I420Image& image, int64_t timestamp_ms) = 0;
+    // Returns the next access unit still held back by lookahead or frame
+    // threads (empty once none are left). Call before Cleanup to account for
+    // every input frame; Cleanup discards them.
+    virtual FrameBufferRef Flush() = 0;
     virtual void Cleanup() = 0;
+    // Only valid on the encoding thread, after an Encode call that returned a frame
+    virtual const FrameInfo& LastFrameInfo() const = 0;
+
+    // Forces the next encoded frame to be an IDR (PLI/FIR, broken reference
+    // chain). Safe to call from any thread.
+    virtual void RequestKeyframe() = 0;
+
+    // Changes bitrate, resolution or frame rate mid-session. Safe to call from
+    // any thread; takes effect on the next encoded frame. Bitrate-only changes
+    // keep the current GOP; resolution or frame rate changes restart the stream
+    // with an IDR. Input frames keep the resolution passed to Initialize and are
+    // rescaled to the encode size. Returns false if the config is invalid.
+    virtual bool Reconfigure(const Config& config) = 0;
 };
 
 // X264 software encoder implementation
 class X264EncoderImpl : public IEncoder {
 public:
-    X264EncoderImpl();
+    explicit X264EncoderImpl(std::shared_ptr<FrameBufferPool> output_pool);
     ~X264EncoderImpl() override;
 
     bool Initialize(const Config& config) override;
-    std::vector<uint8_t> Encode(const uint8_t* bgra_data, int64_t timestamp_ms) override;
+    FrameBufferRef Encode(const uint8_t* bgra_data, int64_t timestamp_ms) override;
+    FrameBufferRef EncodeI420(const I420Image& image, int64_t timestamp_ms) override;
+    FrameBufferRef Flush() override;
     void Cleanup() override;
+    const FrameInfo& LastFrameInfo() const override { return last_frame_; }
+    void RequestKeyframe() override;
+    bool Reconfigure(const Config& config) override;
 
 private:
-    void BGRAToI420(const uint8_t* bgra, uint8_t* y, uint8_t* u, uint8_t* v);
+    bool Open(const Config& config);
+    void Close();
+    void ApplyPendingConfig();
+    FrameBufferRef EncodePicture(x264_picture_t* picture, int64_t timestamp_ms);   // null picture drains
 
     x264_t* encoder_;
-    x264_picture_t picture_in_;
-    Config config_;
+    x264_picture_t picture_in_;   // encode-size staging picture
+    Config config_;               // current encode settings
+    int input_width_;             // resolution frames arrive at (fixed by Initialize)
+    int input_height_;
+    std::vector<uint8_t> input_i420_;   // BGRA input converted before rescaling
+    I420Scaler scaler_;
+    int64_t last_pts_;            // pts of the last frame given to the current x264 instance
+    FrameInfo last_frame_;
     bool initialized_;
+    std::shared_ptr<FrameBufferPool> output_pool_;
+    std::atomic<bool> keyframe_requested_;
+
+    // Written by Reconfigure, applied on the encoding thread
+    std::mutex reconfig_mutex_;
+    Config pending_config_;
+    std::atomic<bool> reconfig_pending_;
 };
 
-// Factory function
-std::unique_ptr<IEncoder> CreateEncoder(bool use_hardware);
\ No newline at end of file
+const char* FrameTypeName(IEncoder::FrameType type);
+
+// Factory function. Encoded frames are written into output_pool; if null the
+// encoder creates its own pool sized for the configured bitrate.
+std::unique_ptr<IEncoder> CreateEncoder(bool use_hardware,
+                                        std::shared_ptr<FrameBufferPool> output_pool = nullptr);
+
+// Slab size for a pool that holds one encoded frame at the given settings,
+// with headroom for keyframes
+size_t EncodedFrameSlabSize(const IEncoder::Config& config);
\ No newline at end of file
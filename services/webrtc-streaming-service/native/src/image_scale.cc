@@ -0,0 +1,66 @@
+// image_scale.cc - I420 resampling for encoder resolution changes
+
+#include "image_scale.h"
+#include <algorithm>
+#include <vector>
+
+// Maps destination coordinates to a 16.16 fixed-point source position,
+// clamped to the plane
+void I420Scaler::Taps::Build(int src, int dst) {
+    if (src == src_size && dst == dst_size) {
+        return;
+    }
+    src_size = src;
+    dst_size = dst;
+    index.resize(dst_size);
+    frac.resize(dst_size);
+    const int64_t step = (static_cast<int64_t>(src_size) << 16) / dst_size;
+    const int64_t last = static_cast<int64_t>(src_size - 1) << 16;
+    for (int i = 0; i < dst_size; i++) {
+        int64_t pos = i * step + step / 2 - 0x8000;
+        pos = std::min<int64_t>(std::max<int64_t>(pos, 0), last);
+        index[i] = static_cast<int>(pos >> 16);
+        frac[i] = static_cast<int>((pos >> 8) & 0xFF);
+    }
+}
+
+static void ScalePlane(const uint8_t* src, int src_stride, int src_width, int src_height,
+                       uint8_t* dst, int dst_stride, int dst_width, int dst_height,
+                       const std::vector<int>& x_index, const std::vector<int>& x_frac,
+                       const std::vector<int>& y_index, const std::vector<int>& y_frac) {
+    for (int y = 0; y < dst_height; y++) {
+        const uint8_t* row0 = src + static_cast<size_t>(y_index[y]) * src_stride;
+        const uint8_t* row1 = row0 + (y_index[y] + 1 < src_height ? src_stride : 0);
+        const int fy = y_frac[y];
+        uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+
+        for (int x = 0; x < dst_width; x++) {
+            const int x0 = x_index[x];
+            const int x1 = x0 + 1 < src_width ? x0 + 1 : x0;
+            const int fx = x_frac[x];
+            const int top = row0[x0] * (256 - fx) + row0[x1] * fx;
+            const int bottom = row1[x0] * (256 - fx) + row1[x1] * fx;
+            out[x] = static_cast<uint8_t>((top * (256 - fy) + bottom * fy + 32768) >> 16);
+        }
+    }
+}
+
+void I420Scaler::Scale(const I420Image& src, const I420Image& dst) {
+    luma_x_.Build(src.width, dst.width);
+    luma_y_.Build(src.height, dst.height);
+    ScalePlane(src.planes[0], src.strides[0], src.width, src.height,
+               dst.planes[0], dst.strides[0], dst.width, dst.height,
+               luma_x_.index, luma_x_.frac, luma_y_.index, luma_y_.frac);
+
+    const int src_chroma_width = (src.width + 1) / 2;
+    const int src_chroma_height = (src.height + 1) / 2;
+    const int dst_chroma_width = (dst.width + 1) / 2;
+    const int dst_chroma_height = (dst.height + 1) / 2;
+    chroma_x_.Build(src_chroma_width, dst_chroma_width);
+    chroma_y_.Build(src_chroma_height, dst_chroma_height);
+    for (int plane = 1; plane < 3; plane++) {
+        ScalePlane(src.planes[plane], src.strides[plane], src_chroma_width, src_chroma_height,
+                   dst.planes[plane], dst.strides[plane], dst_chroma_width, dst_chroma_height,
+                   chroma_x_.index, chroma_x_.frac, chroma_y_.index, chroma_y_.frac);
+    }
+}
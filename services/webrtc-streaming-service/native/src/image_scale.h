@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+#include "color_convert.h"
+
+// Bilinear resample of every I420 plane from src to dst (any size, either
+// direction). Used when the encoder runs below the capture resolution, so the
+// sample grid is centre-aligned to avoid a half-pixel shift between rungs.
+// The filter taps only depend on the plane sizes, so they are built when the
+// sizes change and reused for every frame after that.
+class I420Scaler {
+public:
+    void Scale(const I420Image& src, const I420Image& dst);
+
+private:
+    // Source position of each destination row or column along one axis
+    struct Taps {
+        int src_size = 0;
+        int dst_size = 0;
+        std::vector<int> index;
+        std::vector<int> frac;
+
+        void Build(int src, int dst);
+    };
+
+    Taps luma_x_, luma_y_, chroma_x_, chroma_y_;
+};
@@ -0,0 +1,81 @@
+// latency_histogram.cc - Lock-free log-linear latency histogram
+
+#include "latency_histogram.h"
+
+int LatencyHistogram::BucketFor(int64_t micros) {
+    if (micros < kLinearBuckets) {
+        return micros < 0 ? 0 : static_cast<int>(micros);
+    }
+    int octave = 0;
+    for (uint64_t v = static_cast<uint64_t>(micros); v > 1; v >>= 1) {
+        octave++;
+    }
+    int sub = static_cast<int>((micros >> (octave - 3)) & (kSubBuckets - 1));
+    int bucket = kLinearBuckets + (octave - 4) * kSubBuckets + sub;
+    return bucket < kBuckets ? bucket : kBuckets - 1;
+}
+
+int64_t LatencyHistogram::BucketMidpoint(int bucket) {
+    if (bucket < kLinearBuckets) {
+        return bucket;
+    }
+    int octave = (bucket - kLinearBuckets) / kSubBuckets + 4;
+    int sub = (bucket - kLinearBuckets) % kSubBuckets;
+    int64_t width = int64_t(1) << (octave - 3);
+    return (kSubBuckets + sub) * width + width / 2;
+}
+
+void LatencyHistogram::Record(int64_t micros) {
+    if (micros < 0) {
+        micros = 0;
+    }
+    buckets_[BucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(static_cast<uint64_t>(micros), std::memory_order_relaxed);
+
+    int64_t max = max_us_.load(std::memory_order_relaxed);
+    while (micros > max && !max_us_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Summary LatencyHistogram::Summarize() const {
+    // Snapshot without locking; concurrent Record() calls may be partially
+    // visible, which is fine for monitoring
+    uint64_t counts[kBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; i++) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    Summary summary = {};
+    summary.count = total;
+    summary.max_us = max_us_.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return summary;
+    }
+    summary.mean_us = static_cast<double>(sum_us_.load(std::memory_order_relaxed)) /
+                      static_cast<double>(count_.load(std::memory_order_relaxed));
+
+    const double quantiles[] = { 0.50, 0.90, 0.99 };
+    int64_t* outputs[] = { &summary.p50_us, &summary.p90_us, &summary.p99_us };
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < kBuckets && q < 3; i++) {
+        seen += counts[i];
+        while (q < 3 && static_cast<double>(seen) >= quantiles[q] * static_cast<double>(total)) {
+            int64_t value = BucketMidpoint(i);
+            *outputs[q++] = value < summary.max_us ? value : summary.max_us;
+        }
+    }
+    return summary;
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_us_.store(0, std::memory_order_relaxed);
+    max_us_.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free log-linear latency histogram (microseconds). Values below 16 us
+// get exact buckets; above that each power of two is split into 8 buckets,
+// so percentiles are accurate to ~6%. Record() may be called from any thread.
+// Nothing is time-specific; the pipeline also uses it for frame sizes in bytes.
+class LatencyHistogram {
+public:
+    struct Summary {
+        uint64_t count;
+        double mean_us;
+        int64_t p50_us;
+        int64_t p90_us;
+        int64_t p99_us;
+        int64_t max_us;
+    };
+
+    void Record(int64_t micros);
+    Summary Summarize() const;
+    void Reset();
+
+private:
+    static constexpr int kLinearBuckets = 16;
+    static constexpr int kSubBuckets = 8;
+    static constexpr int kOctaves = 27;   // up to 2^31 us
+    static constexpr int kBuckets = kLinearBuckets + kOctaves * kSubBuckets;
+
+    static int BucketFor(int64_t micros);
+    static int64_t BucketMidpoint(int bucket);
+
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_us_{0};
+    std::atomic<int64_t> max_us_{0};
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Lock-free single-producer / single-consumer ring. Exactly one thread may
+// call TryPush and exactly one (other) thread may call TryPop.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscRing capacity must be a power of two");
+
+public:
+    bool TryPush(const T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots_[tail & (Capacity - 1)] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t SizeApprox() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+private:
+    // Producer and consumer indices on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) T slots_[Capacity];
+};
+
+// Wake-up for a stage thread waiting on one or more rings. Notify is a single
+// atomic increment unless the consumer is actually asleep.
+class StageSignal {
+public:
+    // Read before polling the rings, then pass to Wait so a notify that lands
+    // in between is not lost
+    uint64_t Epoch() const { return epoch_.load(); }
+
+    void Notify() {
+        epoch_.fetch_add(1);
+        if (waiters_.load() > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_all();
+        }
+    }
+
+    void Wait(uint64_t seen_epoch, std::chrono::microseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_.fetch_add(1);
+        cv_.wait_for(lock, timeout, [&]() { return epoch_.load() != seen_epoch; });
+        waiters_.fetch_sub(1);
+    }
+
+private:
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<int> waiters_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
@@ -0,0 +1,136 @@
+// synthetic_source.cc - Deterministic moving test pattern frame source
+
+#include "frame_source.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// 75% color bars, BGRA
+const uint32_t kBarColors[8] = {
+    0xFFBFBFBF, 0xFF00BFBF, 0xFFBFBF00, 0xFF00BF00,
+    0xFFBF00BF, 0xFF0000BF, 0xFFBF0000, 0xFF101010,
+};
+
+const uint32_t kBoxColors[3] = { 0xFFFF4040, 0xFF40FF40, 0xFF4040FF };
+
+inline void StorePixel(uint8_t* p, uint32_t argb) {
+    p[0] = static_cast<uint8_t>(argb);         // B
+    p[1] = static_cast<uint8_t>(argb >> 8);    // G
+    p[2] = static_cast<uint8_t>(argb >> 16);   // R
+    p[3] = static_cast<uint8_t>(argb >> 24);   // A
+}
+
+// Position bouncing between 0 and range
+inline int Triangle(int64_t t, int range) {
+    if (range <= 0) {
+        return 0;
+    }
+    int64_t period = 2 * static_cast<int64_t>(range);
+    int64_t phase = t % period;
+    return static_cast<int>(phase <= range ? phase : period - phase);
+}
+
+inline uint32_t Hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+}  // namespace
+
+SyntheticFrameSource::SyntheticFrameSource(int motion)
+    : motion_(std::max(0, std::min(motion, 3))), config_() {}
+
+bool SyntheticFrameSource::Initialize(const Config& config) {
+    if (config.width <= 0 || config.height <= 0 || config.fps <= 0) {
+        return false;
+    }
+    config_ = config;
+
+    // Two periods of bars so any scroll offset is a contiguous slice
+    row_.resize(static_cast<size_t>(config.width) * 2 * 4);
+    for (int x = 0; x < config.width * 2; x++) {
+        int bar = (x % config.width) * 8 / config.width;
+        StorePixel(&row_[static_cast<size_t>(x) * 4], kBarColors[bar]);
+    }
+
+    printf("[SyntheticSource] %dx%d @ %dfps, motion %d\n",
+           config.width, config.height, config.fps, motion_);
+    return true;
+}
+
+bool SyntheticFrameSource::Capture(uint8_t* frame, int64_t timestamp_ms) {
+    int64_t frame_index = timestamp_ms * config_.fps / 1000;
+
+    DrawBars(frame, motion_ >= 1 ? static_cast<int>((frame_index * 4) % config_.width) : 0);
+    if (motion_ >= 2) {
+        for (int box = 0; box < 3; box++) {
+            DrawBox(frame, frame_index, box, kBoxColors[box]);
+        }
+    }
+    if (motion_ >= 3) {
+        DrawNoise(frame, frame_index);
+    }
+    return true;
+}
+
+void SyntheticFrameSource::Cleanup() {
+    row_.clear();
+    row_.shrink_to_fit();
+}
+
+void SyntheticFrameSource::DrawBars(uint8_t* frame, int offset) {
+    size_t row_bytes = static_cast<size_t>(config_.width) * 4;
+    const uint8_t* src = row_.data() + static_cast<size_t>(offset) * 4;
+    for (int y = 0; y < config_.height; y++) {
+        memcpy(frame + y * row_bytes, src, row_bytes);
+    }
+}
+
+void SyntheticFrameSource::DrawBox(uint8_t* frame, int64_t frame_index, int box, uint32_t color) {
+    int size = std::max(8, config_.height / 8);
+    int w = std::min(size, config_.width);
+    int h = std::min(size, config_.height);
+
+    // Different speeds per box so they cross and occlude each other
+    int x0 = Triangle(frame_index * (5 + box * 3), config_.width - w);
+    int y0 = Triangle(frame_index * (3 + box * 2), config_.height - h);
+
+    for (int y = y0; y < y0 + h; y++) {
+        uint8_t* p = frame + (static_cast<size_t>(y) * config_.width + x0) * 4;
+        for (int x = 0; x < w; x++, p += 4) {
+            StorePixel(p, color);
+        }
+    }
+}
+
+// A quarter of the 16x16 macroblocks, chosen per frame, get fresh noise
+void SyntheticFrameSource::DrawNoise(uint8_t* frame, int64_t frame_index) {
+    int mbs_x = config_.width / 16;
+    int mbs_y = config_.height / 16;
+    uint32_t seed = Hash32(static_cast<uint32_t>(frame_index));
+
+    for (int mby = 0; mby < mbs_y; mby++) {
+        for (int mbx = 0; mbx < mbs_x; mbx++) {
+            uint32_t mb_seed = Hash32(seed ^ static_cast<uint32_t>(mby * mbs_x + mbx));
+            if ((mb_seed & 3) != 0) {
+                continue;
+            }
+            uint32_t state = mb_seed | 1;
+            for (int y = 0; y < 16; y++) {
+                uint8_t* p = frame + (static_cast<size_t>(mby * 16 + y) * config_.width + mbx * 16) * 4;
+                for (int x = 0; x < 16; x++, p += 4) {
+                    // xorshift32
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    StorePixel(p, 0xFF000000u | (state & 0x00FFFFFFu));
+                }
+            }
+        }
+    }
+}
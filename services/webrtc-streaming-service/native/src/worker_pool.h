@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running jobs in FIFO order. Shared by every capture
+// session for encoding, so the number of concurrently encoding threads stays
+// bounded however many sessions are running. Sessions submit one frame per
+// job, which makes the FIFO a round-robin between busy sessions.
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads);
+    ~WorkerPool();   // runs jobs already queued, then joins
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Submit(std::function<void()> job);
+
+    size_t Size() const { return threads_.size(); }
+    size_t Pending() const;
+
+private:
+    void WorkerLoop();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> jobs_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
@@ -18,6 +18,133 @@ export interface CaptureConfig {
     fps: number;
     bitrate?: number;       // kbps, default 5000
     useHardwareEncoder?: boolean; // AMD AMF if available, default true
+    queueSize?: number;     // frames buffered for JS before dropping, default 4
+    dropPolicy?: DropPolicy; // default 'drop-oldest'
+    source?: FrameSourceConfig; // default synthetic, motion 0
+    minBitrate?: number;    // kbps floor for setBandwidthEstimate, default 300
+    adaptiveResolution?: boolean; // let setBandwidthEstimate step resolution / fps down, default false
+    intraRefresh?: boolean; // periodic intra refresh instead of a 1 s IDR cadence; IDRs only via requestKeyframe()
+    encoderThreads?: number; // x264 threads for this session, default 4
+    slicedThreads?: boolean; // slice threads (default) vs frame threads, which add latency
+    preset?: string;        // x264 preset, default 'ultrafast' (see native encoder_bench)
+}
+
+/**
+ * Handle returned by the native start(). Sessions run side by side and share
+ * one pool of encode workers (setEncodeWorkers(n), default one worker per 4
+ * cores). Every per-session call takes the handle as its first argument;
+ * stop() without a handle stops all sessions.
+ */
+export type SessionHandle = number;
+
+/**
+ * Encoder settings in effect. bitrate is the ceiling configured at start;
+ * width / height / fps never exceed the capture format.
+ */
+export interface EncoderSettings {
+    width: number;
+    height: number;
+    fps: number;
+    bitrate: number;        // kbps
+}
+
+/**
+ * Result of setBandwidthEstimate(). Bitrate changes are applied in place;
+ * `restarted` means resolution or fps changed and the stream restarts with an IDR.
+ */
+export interface BandwidthDecision extends EncoderSettings {
+    rung: number;           // 0 = capture format
+    changed: boolean;
+    restarted: boolean;
+}
+
+/**
+ * Where raw frames come from. 'synthetic' draws a deterministic test pattern
+ * (motion 0 = static .. 3 = full-frame noise); 'file' replays a raw .bgra or
+ * .yuv (I420) file at the configured resolution.
+ */
+export type FrameSourceConfig =
+    | { type: 'synthetic'; motion?: 0 | 1 | 2 | 3 }
+    | { type: 'file'; path: string; format?: 'bgra' | 'i420'; loop?: boolean };
+
+/**
+ * Backpressure policy when the JS thread falls behind the encoder.
+ * Any drop that breaks the reference chain makes the encoder emit an IDR.
+ */
+export type DropPolicy = 'drop-oldest' | 'drop-newest' | 'block';
+
+export interface DeliveryStats {
+    queued: number;
+    delivered: number;
+    dropped: number;
+    keyframeRequests: number;
+    depth: number;
+    maxDepth: number;
+    capacity: number;
+    dropPolicy: DropPolicy;
+}
+
+export interface StageLatency {
+    count: number;
+    meanUs: number;
+    p50Us: number;
+    p90Us: number;
+    p99Us: number;
+    maxUs: number;
+}
+
+export interface FrameSizeStats {
+    count: number;
+    meanBytes: number;
+    p50Bytes: number;
+    p90Bytes: number;
+    p99Bytes: number;
+    maxBytes: number;
+}
+
+/**
+ * Native pipeline timings: capture -> convert -> encode -> deliver (JS callback)
+ */
+export interface PipelineStats {
+    framesCaptured: number;
+    framesEncoded: number;
+    captureOverruns: number;    // frames skipped because conversion fell behind
+    lateTicks: number;          // capture deadlines missed entirely
+    sourceEnded: boolean;       // non-looping file source reached end of file
+    frameSizes: {
+        keyframe: FrameSizeStats;   // IDR
+        delta: FrameSizeStats;      // P, including intra refresh frames
+    };
+    stages: {
+        captureQueue: StageLatency;
+        convert: StageLatency;
+        encodeQueue: StageLatency;
+        encode: StageLatency;
+        deliver: StageLatency;
+        total: StageLatency;
+    };
+}
+
+/**
+ * One encoded frame, as drained by getStats(). Durations in microseconds.
+ */
+export interface FrameTelemetry {
+    frame: number;              // encoded frames since start
+    timestamp: number;          // media timestamp, ms
+    captureUs: number;          // native steady clock at capture
+    captureQueueUs: number;
+    convertUs: number;
+    encodeQueueUs: number;
+    encodeUs: number;
+    bytes: number;
+    nalTypes: number;           // bit n set if a NAL unit of type n was emitted
+    qp: number;
+    type: 'idr' | 'i' | 'p' | 'b';
+}
+
+export interface EncodeStats {
+    frames: FrameTelemetry[];   // everything recorded since the previous call
+    overflows: number;          // records lost because getStats() was not called often enough
 }
 
 export interface CaptureProvider {
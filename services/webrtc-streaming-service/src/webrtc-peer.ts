@@ -28,6 +28,8 @@ export class WebRTCPeer extends EventEmitter {
     private rtpSender: RTCRtpSender | null = null;
     private frameCount: number = 0;
     private canSendRtp: boolean = false;
+    // Native capture session of this peer; the addon runs one per peer
+    private captureHandle: number | null = null;
     private _rtpOnce = new Set<string>();
     private _rtpOnceLog(msg: string) { if (this._rtpOnce.has(msg)) return; this._rtpOnce.add(msg); console.log("[RTP-TRACE]", msg); }
     
@@ -148,8 +150,10 @@ export class WebRTCPeer extends EventEmitter {
      * Start Native desktop capture
      */
     private startCapture(): void {
+        // handleAnswer and the 'connected' state both start capture; keep the first session
+        if (this.captureHandle !== null) return;
         console.log(`[WebRTCPeer][${this.sessionId}] Starting native capture`);
-        nativeCapture.start({
+        this.captureHandle = nativeCapture.start({
             width: this.streamConfig.width,
             height: this.streamConfig.height,
             fps: this.streamConfig.fps,
@@ -158,7 +162,7 @@ export class WebRTCPeer extends EventEmitter {
         }, (nalBuffer: Buffer) => {
             this.processH264Data(nalBuffer);
         });
-        console.log(`[WebRTCPeer][${this.sessionId}] Native capture started`);
+        console.log(`[WebRTCPeer][${this.sessionId}] Native capture started (session ${this.captureHandle})`);
     }
 
     /**
@@ -293,7 +297,10 @@ export class WebRTCPeer extends EventEmitter {
      * Stop capture
      */
     private stopCapture(): void {
-        if (nativeCapture?.stop) nativeCapture.stop();
+        if (this.captureHandle === null) return;
+        // Without a handle the addon stops every session in the process, i.e. the other peers too
+        if (nativeCapture?.stop) nativeCapture.stop(this.captureHandle);
+        this.captureHandle = null;
         this.h264Parser.clear();
         console.log(`[WebRTCPeer][${this.sessionId}] Native capture stopped`);
     }